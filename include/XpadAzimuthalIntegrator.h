@@ -0,0 +1,152 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef XPADAZIMUTHALINTEGRATOR_H
+#define XPADAZIMUTHALINTEGRATOR_H
+
+#include "lima/SizeUtils.h"
+#include "lima/ThreadUtils.h"
+#include "lima/Debug.h"
+
+#include "XpadThreadPool.h"
+
+#include <stdint.h>
+#include <vector>
+
+//- number of 1D patterns kept (ring)
+const int AZIMUTHAL_HISTORY = 1024;
+
+namespace lima
+{
+namespace Xpad
+{
+	/*******************************************************************
+	* \class AzimuthalIntegrator
+	* \brief 1D azimuthal integration of the corrected frames
+	*
+	* The pixel -> q bin lookup matrix (CSR, weight 1/nb pixels of the bin,
+	* so that the product gives the mean intensity of each bin) is built
+	* once from the geometry and kept until the geometry or the image size
+	* changes. Geometry is in the corrected image (before flip/rotation):
+	* beam center in pixels, detector tilted by tilt degrees around an
+	* in-plane axis at tilt_rotation degrees from the x axis.
+	*******************************************************************/
+	class AzimuthalIntegrator
+	{
+		DEB_CLASS_NAMESPC(DebModCamera, "AzimuthalIntegrator", "Xpad");
+
+	public:
+		struct Geometry
+		{
+			double	distance;			//- sample to detector (mm)
+			double	center_x;			//- beam center (pixels)
+			double	center_y;
+			double	tilt;				//- degrees
+			double	tilt_rotation;		//- degrees
+			double	wavelength;			//- angstrom
+		};
+
+		AzimuthalIntegrator();
+		~AzimuthalIntegrator();
+
+		void setActive(bool active);
+		bool getActive();
+		//! latched at prepare
+		bool isActive() const {return m_active;}
+		void setNbThreads(int nb_threads);
+		void setGeometry(const Geometry& geometry);
+		void getGeometry(Geometry& geometry);
+		//! q range in 1/angstrom (q_max <= q_min: range of the detector)
+		void setBins(int nb_bins, double q_min, double q_max);
+
+		//! build the lookup matrix if needed (pixel size in mm), clear the patterns
+		void prepare(const Size& image_size, double pixel_size);
+
+		//- frame pass (acquisition task only)
+		void startFrame(int frame_nb);
+		//! integrate the whole (corrected) image, returns when done
+		template<typename T>
+		void process(const T* image);
+		void endFrame();
+
+		//- readers (any thread)
+		//! q of the bin centers (1/angstrom)
+		void getQ(std::vector<float>& q);
+		//! copy the pattern of a frame, false if not available
+		bool getPattern(int frame_nb, std::vector<float>& pattern);
+		int getNbFrames();
+
+	private:
+		enum PixelType {UINT16, UINT32, FLOAT};
+
+		class BinsJob : public ThreadPool::Job
+		{
+		public:
+			BinsJob(AzimuthalIntegrator& integrator, int bin_begin, int bin_end) :
+				m_integrator(integrator), m_bin_begin(bin_begin), m_bin_end(bin_end) {}
+			virtual void run();
+		private:
+			AzimuthalIntegrator&	m_integrator;
+			int						m_bin_begin;
+			int						m_bin_end;
+		};
+		friend class BinsJob;
+
+		void _buildLut(const Size& image_size, double pixel_size);
+		template<typename T>
+		void _integrate(const T* image, int bin_begin, int bin_end);
+
+		//- configuration
+		Mutex					m_lock;		//- protects the configuration and the patterns
+		bool					m_staged_active;
+		Geometry				m_geometry;
+		int						m_nb_bins;
+		double					m_q_min;
+		double					m_q_max;
+		bool					m_lut_valid;
+		ThreadPool				m_pool;
+
+		//- lookup matrix (CSR)
+		Size					m_lut_size;
+		double					m_lut_pixel_size;
+		std::vector<int>		m_row_ptr;
+		std::vector<int>		m_columns;
+		std::vector<float>		m_weights;
+		std::vector<float>		m_q;
+
+		//- used by the frame pass (set in prepare)
+		bool					m_active;
+		std::vector<BinsJob*>	m_jobs;
+		const void*				m_image;
+		PixelType				m_pixel_type;
+		int						m_frame_nb;
+		std::vector<float>		m_pattern;
+
+		//- patterns
+		std::vector<int>		m_frame_nbs;
+		std::vector<float>		m_patterns;
+		int						m_nb_frames;
+	};
+
+} // namespace Xpad
+} // namespace lima
+
+#endif // XPADAZIMUTHALINTEGRATOR_H
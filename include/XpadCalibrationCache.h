@@ -0,0 +1,174 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef XPADCALIBRATIONCACHE_H
+#define XPADCALIBRATIONCACHE_H
+
+#include "lima/ThreadUtils.h"
+#include "lima/Debug.h"
+
+#include <stdint.h>
+#include <time.h>
+#include <map>
+#include <string>
+#include <vector>
+
+//- chip geometry and config G registers (order of xpci_modLoadAllConfigG)
+const int CHIP_NB_ROW       = 120;
+const int CHIP_NB_COLUMN    = 80;
+const int CONFIG_G_NB_REGISTERS = 11;
+//- imXPAD addresses of CMOS_TP, AMP_TP, ITHH, VADJ, VREF, IMFP, IOTA, IPRE, ITHL, ITUNE, IBUFFER
+const unsigned int CONFIG_G_REGISTERS[CONFIG_G_NB_REGISTERS] = {0x01, 0x1F, 0x33, 0x35, 0x36, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F, 0x40};
+const int CONFIG_G_ITHL = 8;
+//- files of the calibrations exported for the cache (name + ".cfl" / ".cfg") in a calibration directory
+const char* const CALIBRATION_EXPORT_NAME = "lima_calibration";
+
+namespace lima
+{
+namespace Xpad
+{
+	/*******************************************************************
+	* \class CalibrationCache
+	* \brief parsed calibrations and what is saved/loaded on the detector
+	*
+	* Only a text layout of its own is parsed, written by write() from the
+	* DACL read back and the config G of the chips: a DACL file
+	* (lima_calibration.cfl, lines "module chip row v0 ... v79") and a config
+	* G file (lima_calibration.cfg, lines "module chip CMOS_TP AMP_TP ITHH
+	* VADJ VREF IMFP IOTA IPRE ITHL ITUNE IBUFFER"), module and chip starting
+	* at 1, row at 0. The files of the xpix calibrations are not read: without
+	* an export, or with an export older than the other files of the
+	* directory, get() throws and the camera falls back to the full xpix
+	* upload. Parsed calibrations are kept by path and reparsed only if a
+	* file changed.
+	* For each detector RAM calibration (calib id) and module, the cache
+	* knows the saved values and from which calibration they come, and
+	* for the chips of each module, which calib id was loaded, the config G
+	* values and a checksum of the DACL (from the saved calibration or a
+	* readback). A calib id can be assigned to a calibration of the
+	* library.
+	*******************************************************************/
+	class CalibrationCache
+	{
+		DEB_CLASS_NAMESPC(DebModCamera, "CalibrationCache", "Xpad");
+
+	public:
+		struct Calibration
+		{
+			std::string				path;
+			time_t					mtime;
+			int						nb_modules;
+			int						nb_chips;
+			std::vector<uint16_t>	dacl;		//- module x chip x row x column
+			std::vector<uint16_t>	config_g;	//- module x chip x register
+			std::vector<uint32_t>	checksums;	//- DACL checksum, module x chip
+
+			Calibration() : mtime(0), nb_modules(0), nb_chips(0) {}
+			const uint16_t* getDaclRow(int module, int chip, int row) const
+			{return &dacl[((long(module) * nb_chips + chip) * CHIP_NB_ROW + row) * CHIP_NB_COLUMN];}
+			uint16_t getConfigG(int module, int chip, int reg) const
+			{return config_g[(module * nb_chips + chip) * CONFIG_G_NB_REGISTERS + reg];}
+		};
+
+		CalibrationCache();
+
+		void setDetector(int nb_modules, int nb_chips);
+
+		//! parsed calibration of a directory (parsed again if a file changed), copied under the lock:
+		//! the cache can be cleared or reparsed by another thread while the caller uses it
+		Calibration get(const std::string& path, int nb_modules, int nb_chips);
+		//! forget the parsed calibrations
+		void clear();
+		//! checksum of the DACL of a chip
+		static uint32_t checksum(const uint16_t* dacl);
+		//! export a calibration (all modules and chips of the detector) in the directory path
+		static void write(const std::string& path, const Calibration& calibration);
+
+		//- detector RAM (module starting at 0)
+		bool isRowSaved(const Calibration& calibration, int calib_id, int module, int chip, int row);
+		bool isRegisterSaved(const Calibration& calibration, int calib_id, int module, int reg);
+		//! the calib id holds this version of the calibration for the module
+		bool isModuleSaved(const Calibration& calibration, int calib_id, int module);
+		void setModuleSaved(const Calibration& calibration, int calib_id, int module);
+		//! unknown content of the calib id for a module (-1: all modules)
+		void invalidateSlot(int calib_id, int module);
+
+		//- detector chips
+		//! calib id loaded on the chips of the module (-1: unknown)
+		int getLoadedSlot(int module);
+		void setModuleLoaded(int calib_id, int module);
+		//! unknown config of the chips of a module (-1: all modules)
+		void invalidateChips(int module);
+		//! config G of a chip, false if unknown
+		bool getConfigG(int module, int chip, long* values);
+		void setConfigG(int module, int chip, const long* values);
+		//! unknown config G of a chip (-1: all chips of the module, all modules)
+		void invalidateConfigG(int module, int chip);
+		//! DACL checksum of a chip (readback)
+		void setDaclChecksum(int module, int chip, uint32_t checksum);
+		//! DACL checksum of a chip, false if unknown
+		bool getDaclChecksum(int module, int chip, uint32_t& checksum);
+		//! unknown DACL of the chips of a module (-1: all modules)
+		void invalidateDacl(int module);
+		//! the chips of the modules hold the calibration (DACL checksums and config G)
+		bool isLoaded(const Calibration& calibration, unsigned int modules_mask);
+		//! unknown RAM and chips
+		void invalidateAll();
+
+		//- library
+		//! assign a calibration directory to a calib id (empty path: free the calib id)
+		void assignSlot(int calib_id, const std::string& path);
+		std::string getAssignedPath(int calib_id);
+		//! calib id assigned to a calibration directory (-1: none)
+		int findSlot(const std::string& path);
+		void getAssignedSlots(std::vector<int>& calib_ids);
+
+	private:
+		struct Slot
+		{
+			std::string					assigned_path;
+			Calibration					content;
+			std::vector<std::string>	module_paths;
+			std::vector<time_t>			module_mtimes;
+			std::vector<char>			module_saved;
+		};
+
+		static void _findFiles(const std::string& path, std::string& dacl_path, std::string& config_g_path);
+		static time_t _mtime(const std::string& path);
+		static void _parse(const std::string& dacl_path, const std::string& config_g_path, Calibration& calibration);
+		bool _isSaved(const Slot& slot, const Calibration& calibration, int module);
+
+		Mutex								m_lock;
+		int									m_nb_modules;
+		int									m_nb_chips;
+		std::map<std::string, Calibration>	m_calibrations;
+		std::map<int, Slot>					m_slots;
+		std::vector<int>					m_loaded_slots;
+		std::vector<long>					m_config_g;			//- module x chip x register
+		std::vector<char>					m_config_g_known;	//- module x chip
+		std::vector<uint32_t>				m_dacl_checksums;	//- module x chip
+		std::vector<char>					m_dacl_known;		//- module x chip
+	};
+
+} // namespace Xpad
+} // namespace lima
+
+#endif // XPADCALIBRATIONCACHE_H
@@ -27,16 +27,17 @@
 #define kLO_WATER_MARK      128
 #define kHI_WATER_MARK      512
 #define kPOST_MSG_TMO       2
-const size_t  XPAD_DLL_START_SYNC_MSG		=	(yat::FIRST_USER_MSG + 100);
-const size_t  XPAD_DLL_START_ASYNC_MSG		=	(yat::FIRST_USER_MSG + 101);
-const size_t  XPAD_DLL_START_LIVE_ACQ_MSG	=	(yat::FIRST_USER_MSG + 102);
-const size_t  XPAD_DLL_GET_ASYNC_IMAGES_MSG	=	(yat::FIRST_USER_MSG + 103);
 const size_t  XPAD_DLL_CALIBRATE_OTN_SLOW   =	(yat::FIRST_USER_MSG + 104);
 const size_t  XPAD_DLL_CALIBRATE_OTN_MEDIUM =	(yat::FIRST_USER_MSG + 105);
 const size_t  XPAD_DLL_CALIBRATE_OTN_FAST   =	(yat::FIRST_USER_MSG + 106);
 const size_t  XPAD_DLL_CALIBRATE_BEAM       =	(yat::FIRST_USER_MSG + 107);
 const size_t  XPAD_DLL_CALIBRATE_OTN        =	(yat::FIRST_USER_MSG + 108);
 const size_t  XPAD_DLL_UPLOAD_CALIBRATION   =	(yat::FIRST_USER_MSG + 109);
+const size_t  XPAD_DLL_SAVE_DACL            =	(yat::FIRST_USER_MSG + 110);
+const size_t  XPAD_DLL_PRELOAD_CALIBRATIONS =	(yat::FIRST_USER_MSG + 111);
+const size_t  XPAD_DLL_SWITCH_CALIBRATION   =	(yat::FIRST_USER_MSG + 112);
+const size_t  XPAD_DLL_CORRECT_DACL         =	(yat::FIRST_USER_MSG + 114);
+const size_t  XPAD_DLL_CHECK_UNIFORMITY     =	(yat::FIRST_USER_MSG + 115);
 
 
 //- Xpix Xpad
@@ -49,12 +50,34 @@ const size_t  XPAD_DLL_UPLOAD_CALIBRATION   =	(yat::FIRST_USER_MSG + 109);
 //- std
 #include <stdlib.h>
 #include <limits>
+#include <deque>
 
 //- Lima
 #include "lima/HwMaxImageSizeCallback.h"
 #include "lima/HwBufferMgr.h"
 #include "lima/Event.h"
 
+//- Xpad
+#include "XpadImageTransform.h"
+#include "XpadPixelCorrection.h"
+#include "XpadFrameStatistics.h"
+#include "XpadRoiCounters.h"
+#include "XpadFrameAccumulator.h"
+#include "XpadFrameCompressor.h"
+#include "XpadSparseFrames.h"
+#include "XpadFrameVeto.h"
+#include "XpadPeakFinder.h"
+#include "XpadAzimuthalIntegrator.h"
+#include "XpadPumpProbe.h"
+#include "XpadHdrMerger.h"
+#include "XpadPixelStatistics.h"
+#include "XpadHotPixelDetector.h"
+#include "XpadCalibrationCache.h"
+#include "XpadThresholdScan.h"
+#include "XpadSCurveFitter.h"
+#include "XpadUniformityCheck.h"
+#include "XpadThreadPool.h"
+
 //- Tools / Defs / Consts
 #define SET(var, bit) ( var|=  (1 << bit)  )       /* positionne le bit numero 'bit' a 1 dans une variable*/
 #define CLR(var, bit) ( var&= ~(1 << bit)  )       /* positionne le bit numero 'bit' a 0 dans une variable*/
@@ -63,9 +86,6 @@ const int FIRST_TIMEOUT = 8000;
 #define XPIX_NOT_USED_YET 0
 #define XPIX_V1_COMPATIBILITY 0
 
-const int CHIP_NB_ROW       = 120;
-const int CHIP_NB_COLUMN    = 80;
-
 //- image sizes used for corrections 
 const int I1_ROW    = 240;
 const int I1_COLUMN = 560;
@@ -146,13 +166,19 @@ namespace Xpad
 		void getExpTime(double& exp_time);
 		void setLatTime(double  lat_time);
 		void getLatTime(double& lat_time);
+
+		//- Flip / Rotation (done while writing the lima buffer)
+		void setFlip(const Flip& flip);
+		void getFlip(Flip& flip);
+		void setRotation(RotationMode rotation);
+		void getRotation(RotationMode& rotation);
 		
 		//- Status
 		void getStatus(Camera::Status& status);
 	
 		//---------------------------------------------------------------
 		//- XPAD Stuff
-		//! Set all the config G
+		//! Set all the config G (module x chip x register, registers in the loadAllConfigG order), only the changed chips are loaded
         void setAllConfigG(const std::vector<long>& allConfigG);
 		//!	Set the Acquisition type between synchrone and asynchrone
 		void setAcquisitionType(short acq_type);
@@ -166,12 +192,22 @@ namespace Xpad
 		void loadAutoTest(unsigned long known_value);
         //! Save the config L (DACL) to XPAD RAM
         void saveConfigL(unsigned long modMask, unsigned long calibId, unsigned long chipId, unsigned long curRow,unsigned long* values);
+        //! Save a whole DACL (module x chip x row x column, modules 1 to the last of the mask) to XPAD RAM, in background
+        void saveDacl(unsigned long calibId, const unsigned short* dacl, long size);
+        //! Get the progress of the last saveDacl: rows saved, rows to save, xpix calls and rows per second
+        void getDaclUploadProgress(int& nb_rows_done, int& nb_rows, int& nb_calls, double& rows_per_sec);
         //! Save the config G to XPAD RAM
         void saveConfigG(unsigned long modMask, unsigned long calibId, unsigned long reg,unsigned long* values);
 	    //! Load the config to detector chips
         void loadConfig(unsigned long modMask, unsigned long calibId);
-        //! Get the modules config (Local aka DACL)
+        //! Get the modules config (Local aka DACL, raw image geometry), read back from the chips
         unsigned short*& getModConfig();
+        //! Get a copy of the modules config read back from the chips
+        void getDacl(std::vector<unsigned short>& dacl);
+        //! the calibration (dacl + config) stored in path is loaded on the chips (known by a readback or a cached upload)
+        bool isCalibrationLoaded(const std::string& path);
+        //! export the calibration of the chips (DACL read back, known config G) in path for the calibration cache
+        void exportCalibration(const std::string& path);
         //! Reset the detector
         void reset();
         //! Set the exposure parameters
@@ -189,11 +225,63 @@ namespace Xpad
 		void calibrateBeam ( const std::string& path, unsigned int texp, unsigned int ithl_max, unsigned int itune,unsigned int imfp);
 		//! Calibrate over the noise and save dacl and configg files in path
 		void calibrateOTN ( const std::string& path, unsigned int itune,unsigned int imfp);
+		//! Set the modules (mask) of the next calibrations, 0: all the modules
+		void setCalibrationModules(unsigned long modules_mask);
+		//! cancel the calibration: the exposures of the running xpix calibration are aborted
+		void cancelCalibration();
+		//! Get the calibration progress: modules done (all at the end, one xpix call), modules to calibrate, elapsed time
+		void getCalibrationProgress(int& nb_modules_done, int& nb_modules, double& elapsed_sec);
 
         //! upload the calibration (dacl + config) that is stored in path
         void uploadCalibration(const std::string& path);
+        //! enable/disable the calibration cache: parsed calibrations are kept and only changed rows/registers are uploaded
+        void setCalibrationCache(bool calibration_cache);
+        //! forget the parsed calibrations and what is loaded on the detector
+        void clearCalibrationCache();
+        //! Get the number of DACL rows and config G registers sent by the last upload, and its duration
+        void getCalibrationUploadStats(int& nb_rows, int& nb_registers, double& elapsed_sec);
+        //! assign a calibration directory to a XPAD RAM calibId (not 0), preloaded in background when idle (empty path: free)
+        void setCalibrationSlot(unsigned long calibId, const std::string& path);
+        //! Get the calibration assigned to a calibId, if it is saved in XPAD RAM and if it is loaded on the chips
+        void getCalibrationSlot(unsigned long calibId, std::string& path, bool& preloaded, bool& loaded);
+        //! load on the chips a calibration of the library (saved first if not preloaded)
+        void switchCalibration(const std::string& path);
+        //! Set the flat field acquisition of the uniformity check: nb frames (>= 2) of exp_time_sec
+        void setUniformityCheckAcquisition(int nb_frames, double exp_time_sec);
+        //! Set the limits of a chip: outliers at k sigma, outlier fraction, rms (above Poisson) / mean and mean deviation from the chips median
+        void setUniformityCheckLimits(double k_sigma, double max_outlier_fraction, double max_rms_ratio, double max_mean_deviation);
+        //! run the uniformity check after each uploadCalibration
+        void setUniformityCheckAfterUpload(bool uniformity_check_after_upload);
+        //! flat field acquisition (not published) and pass/fail of each chip, the report is also a lima event
+        void checkUniformity();
+        //! Get the result of the last uniformity check, false if none
+        bool getUniformityReport(bool& passed, std::string& report);
+        //! Get the statistics of each chip of the last uniformity check
+        void getUniformityChipResults(std::vector<UniformityCheck::ChipResult>& results);
         //! upload the wait times between each images in case of a sequence of images (Twait from setExposureParameters should be 0)
         void uploadExpWaitTimes(unsigned long *pWaitTime, unsigned size);
+        //! enable/disable the threshold scan: frame n is exposed with ITHL = start + n * step (nb frames = nb steps)
+        void setThresholdScan(bool threshold_scan);
+        //! Set the ITHL range of the threshold scan (stop included if on a step)
+        void setThresholdScanRange(int ithl_start, int ithl_stop, int ithl_step);
+        //! Get the number of ITHL steps (frames) of the threshold scan
+        int getThresholdScanNbSteps();
+        //! Get the ITHL of a published frame of the threshold scan, -1 if not available
+        int getThresholdScanIthl(int frame_nb);
+        //! enable/disable the S-curve fit of the threshold scan frames
+        void setSCurveFit(bool scurve_fit);
+        //! Set the threads of the S-curve fit
+        void setSCurveFitNbThreads(int nb_threads);
+        //! Set the DACL correction: DACL step per ITHL of threshold offset (signed) and DACL max
+        void setSCurveDaclCorrection(double dacl_per_ithl, int dacl_max);
+        //! Get the S-curve thresholds (ITHL) of the pixels, raw image geometry, NaN if not fitted
+        void getSCurveThresholds(std::vector<float>& thresholds);
+        //! Get the S-curve noise (ITHL rms) of the pixels, raw image geometry, NaN if not fitted
+        void getSCurveNoise(std::vector<float>& noise);
+        //! correct the DACL of the modules (mask) from the last S-curve fit, saved to calibId 0 and loaded on the chips
+        void correctDacl(unsigned long modules_mask);
+        //! Get the threshold dispersion (ITHL rms around the chip medians) per module before the last DACL correction
+        void getSCurveDispersion(std::vector<double>& dispersion);
         //! increment the ITHL
         void incrementITHL();
         //! decrement the ITHL
@@ -221,6 +309,173 @@ namespace Xpad
 		void setDoublePixelCorrection(bool doublepixel_corr);
 		//! Set Normalization Factor (used in double pixel correction)
 		void setNormalizationFactor(double norm_factor);
+		//! load the flat field map (raw float32 file, size of the corrected image)
+		void loadFlatField(const std::string& path);
+		//! enable/disable flat field correction
+		void setFlatFieldCorrection(bool flat_corr);
+		//! load the pixel mask (raw uint8 file, size of the corrected image, non null = masked pixel)
+		void loadPixelMask(const std::string& path);
+		//! enable/disable pixel mask correction
+		void setPixelMaskCorrection(bool mask_corr);
+		//! Set the value written in the masked pixels
+		void setMaskFillValue(unsigned int fill_value);
+		//! Set the dead time (ns) of each module for the count rate correction
+		void setModuleDeadTimes(const std::vector<double>& dead_times_ns);
+		//! load a per pixel dead time map (raw float32 file in ns, size of the corrected image)
+		void loadDeadTimeMap(const std::string& path);
+		//! enable/disable count rate (dead time) correction
+		void setRateCorrection(bool rate_corr);
+		//! enable/disable the per frame statistics (computed during the frame pass)
+		void setFrameStatistics(bool frame_stats);
+		//! Set the threshold of the saturated pixels count (0: max value of the pixel type)
+		void setStatisticsSaturationThreshold(unsigned int threshold);
+		//! Set the histogram bin width as a power of 2 (bin = value >> shift)
+		void setStatisticsHistogramShift(unsigned int shift);
+		//! Get the statistics of a frame, false if not available (lock free)
+		bool getFrameStatistics(int frame_nb, FrameStatistics::Record& record);
+		//! Get the statistics of the last processed frame, false if none (lock free)
+		bool getLastFrameStatistics(FrameStatistics::Record& record);
+		//! Set the threshold of the pixels counted in nb_above_threshold (1: non null pixels)
+		void setStatisticsCountThreshold(unsigned int threshold);
+		//! Set the rectangular roi counters (list of x, y, width, height in the corrected image)
+		void setRoiCounters(const std::vector<int>& rois);
+		//! load the roi counters mask (raw uint8 file, label k = pixel of the mask roi k)
+		void loadRoiCountersMask(const std::string& path);
+		//! remove all the roi counters
+		void clearRoiCounters();
+		//! Set the number of frames kept in the roi counters time series
+		void setRoiCountersBufferSize(int nb_frames);
+		//! enable/disable the roi counters only mode (images are not given to lima)
+		void setRoiCountersOnly(bool roi_counters_only);
+		//! Get the number of roi counters of the current acquisition
+		int getNbRoiCounters();
+		//! read the roi counters of [first_frame, first_frame + nb_frames[ (frame major), returns the number of frames read
+		int readRoiCounters(int first_frame, int nb_frames, std::vector<double>& counters);
+		//! Set the number of 16 bits hardware frames summed in each 32 bits lima frame (1: no accumulation)
+		void setAccumulationNbFrames(int nb_frames);
+		void getAccumulationNbFrames(int& nb_frames);
+		//! Set the hardware pixel value flagged as saturated in the accumulation
+		void setAccumulationSaturationThreshold(unsigned short threshold);
+		//! Get the number of saturated pixels of the last accumulated frame
+		int getAccumulationNbSaturated();
+		//! Get the saturation map (raw geometry, non null = saturated) of the last accumulated frame
+		void getAccumulationSaturationMap(std::vector<unsigned char>& saturation_map);
+		//! enable/disable the bitshuffle/LZ4 compression of the frames
+		void setCompression(bool compression);
+		//! enable/disable the compression only mode (images are not given to lima)
+		void setCompressionOnly(bool compression_only);
+		//! Set the number of compression threads (0: one per cpu)
+		void setCompressionNbThreads(int nb_threads);
+		//! Set the number of compressed frames kept in memory
+		void setCompressionBufferSize(int nb_frames);
+		//! Get the compressed chunk (HDF5 bitshuffle filter format) of a frame, false if not available
+		bool readCompressedFrame(int frame_nb, std::vector<char>& chunk);
+		//! Get the compression ratio and throughput of the current acquisition
+		void getCompressionReport(FrameCompressor::Report& report);
+		//! enable/disable the sparse (pixel index, count) frames, only the dense images are then given to lima
+		void setSparseFrames(bool sparse_frames);
+		//! Set the fraction of non null pixels above which a frame is kept dense
+		void setSparseOccupancyThreshold(double occupancy);
+		//! Set the number of sparse frames kept in memory
+		void setSparseBufferSize(int nb_frames);
+		//! Get a sparse frame: 0 if sparse, 1 if dense (given to lima as lima_frame_nb, -1 if vetoed), -1 if not available
+		int readSparseFrame(int frame_nb, std::vector<unsigned int>& indexes, std::vector<unsigned int>& values, int& lima_frame_nb);
+		//! Get the number of frames (sparse and dense) and of dense frames of the current acquisition
+		void getNbSparseFrames(int& nb_frames, int& nb_dense_frames);
+		//! enable/disable the veto of the empty frames (kept frames are renumbered)
+		void setFrameVeto(bool frame_veto);
+		//! Set the minimum total counts of a kept frame
+		void setVetoMinSum(unsigned long long min_sum);
+		//! Set the minimum number of pixels above the statistics count threshold of a kept frame
+		void setVetoMinNbPixels(unsigned int min_nb_pixels);
+		//! Get the number of kept and vetoed frames of the current acquisition
+		void getNbVetoFrames(int& nb_kept_frames, int& nb_vetoed_frames);
+		//! Get the acquired frame number of the last kept (lima) frames, from first_kept_frame_nb
+		void getVetoFrameMapping(int& first_kept_frame_nb, std::vector<int>& acq_frame_nbs);
+		//! enable/disable the Bragg peak finder (with the veto, only the frames with enough peaks are kept)
+		void setPeakFinder(bool peak_finder);
+		//! Set the number of peak finder threads (0: one per cpu)
+		void setPeakFinderNbThreads(int nb_threads);
+		//! Set the minimum value of the peak pixels
+		void setPeakFinderThreshold(double threshold);
+		//! Set the minimum signal to noise of the peak pixels above the local background
+		void setPeakFinderSnr(double snr);
+		//! Set the outer radius of the local background annulus
+		void setPeakFinderBackgroundRadius(int radius);
+		//! Set the range of the number of pixels of a peak
+		void setPeakFinderPixelRange(int min_nb_pixels, int max_nb_pixels);
+		//! Set the minimum number of peaks of a hit
+		void setPeakFinderMinNbPeaks(int min_nb_peaks);
+		//! Get the peaks of a frame (acquired frame number), false if not available
+		bool getPeaks(int frame_nb, std::vector<PeakFinder::Peak>& peaks);
+		//! Get the number of frames processed by the peak finder and of hits
+		void getNbPeakFinderFrames(int& nb_frames, int& nb_hits);
+		//! enable/disable the azimuthal integration of the corrected frames
+		void setAzimuthalIntegration(bool azimuthal_integration);
+		//! enable/disable the azimuthal integration only mode (images are not given to lima)
+		void setAzimuthalIntegrationOnly(bool azimuthal_only);
+		//! Set the number of azimuthal integration threads (0: one per cpu)
+		void setAzimuthalNbThreads(int nb_threads);
+		//! Set the detector geometry: distance (mm), beam center (pixels, corrected image), tilt and tilt rotation (degrees)
+		void setAzimuthalGeometry(double distance, double center_x, double center_y, double tilt, double tilt_rotation);
+		//! Set the wavelength (angstrom)
+		void setAzimuthalWavelength(double wavelength);
+		//! Set the number of q bins and the q range (1/angstrom, q_max <= q_min: range of the detector)
+		void setAzimuthalBins(int nb_bins, double q_min, double q_max);
+		//! Get the q of the bin centers
+		void getAzimuthalQ(std::vector<float>& q);
+		//! Get the 1D pattern (mean intensity of each bin) of a frame, false if not available
+		bool getAzimuthalPattern(int frame_nb, std::vector<float>& pattern);
+		//! Get the number of integrated frames of the current acquisition
+		int getNbAzimuthalPatterns();
+		//! enable/disable the pump-probe mode: frame n is added to the sum of the delay n % nb delays, images are then not given to lima
+		void setPumpProbe(bool pump_probe);
+		//! Set the number of delays of the pump-probe sequence
+		void setPumpProbeNbDelays(int nb_delays);
+		//! Set the number of sequences between two publications of the sums (0: at the end of the acquisition only)
+		void setPumpProbePublishPeriod(int nb_cycles);
+		//! Get the last published sum (lima frame geometry) and number of frames of a delay, false if not available
+		bool getPumpProbeSum(int delay, std::vector<unsigned int>& sum, int& nb_frames);
+		//! Get the number of publications of the sums of the current acquisition
+		int getNbPumpProbePublications();
+		//! enable/disable the HDR mode: short/long hardware frame pairs (16 bits) merged in one 32 bits frame
+		void setHdr(bool hdr);
+		//! Set the long / short exposure time ratio: the short exposure is the exposure time / ratio
+		void setHdrExposureRatio(double ratio);
+		//! Set the long exposure pixel value above which the short exposure is taken
+		void setHdrSaturationThreshold(unsigned short threshold);
+		//! Get the merge statistics of a frame, false if not available
+		bool getHdrStats(int frame_nb, HdrMerger::Stats& stats);
+		//! Get the merge map (raw geometry, 0: long, 1: short, 2: both saturated) of the last merged frame
+		void getHdrMergeMap(std::vector<unsigned char>& merge_map);
+		//! enable/disable the per pixel statistics (mean, variance, histogram) over the frames of the acquisition
+		void setPixelStatistics(bool pixel_statistics);
+		//! Set the number of pixel statistics threads (0: one per cpu)
+		void setPixelStatisticsNbThreads(int nb_threads);
+		//! Set the histogram bins: nb_bins bins of bin_width from bin_min
+		void setPixelStatisticsHistogram(int nb_bins, double bin_min, double bin_width);
+		//! Get the number of frames in the pixel statistics
+		int getPixelStatisticsNbFrames();
+		//! Get the mean map (corrected image geometry, row major)
+		void getPixelStatisticsMean(std::vector<float>& mean);
+		//! Get the variance map (corrected image geometry, row major)
+		void getPixelStatisticsVariance(std::vector<float>& variance);
+		//! Get the histograms (nb bins counts per pixel, corrected image geometry)
+		void getPixelStatisticsHistograms(std::vector<unsigned int>& histograms);
+		//! Save the mean, variance and histogram maps in <prefix>_mean.f32, <prefix>_variance.f32, <prefix>_histogram.u32
+		void savePixelStatistics(const std::string& prefix);
+		//! enable/disable the hot pixel detection (and mask update) at the end of each acquisition with pixel statistics
+		void setHotPixelDetection(bool hot_pixel_detection);
+		//! Set the deviation (in sigma) from the chip median of a hot/cold/noisy pixel
+		void setHotPixelKSigma(double k_sigma);
+		//! Detect the hot, cold and noisy pixels on the current pixel statistics
+		void detectHotPixels();
+		//! Get the flags (1: hot, 2: cold, 4: noisy) of each pixel of the last detection
+		void getHotPixelMask(std::vector<unsigned char>& mask);
+		//! Get the number of hot, cold and noisy pixels of the last detection
+		void getNbHotPixels(int& nb_hot, int& nb_cold, int& nb_noisy);
+		//! Add the last detection to the pixel mask and enable the mask correction (from the next acquisition)
+		void applyHotPixelMask();
 		//! Set GeneralPurpose Params
 		void setGeneralPurposeParams( unsigned int GP1, unsigned intGP2, unsigned int GP3, unsigned int GP4);
 
@@ -245,6 +500,7 @@ namespace Xpad
 
 		//- img stuff
 		int 			m_nb_frames;		
+        int             m_nb_hw_frames;
         int 			m_current_nb_frames;
 		Size			m_image_size;
 		IMG_TYPE		m_pixel_depth;
@@ -254,6 +510,50 @@ namespace Xpad
 		int         	m_timeout_ms;
         bool            m_stop_asked;
         Timestamp       m_start_sec,m_end_sec;
+        Flip            m_flip;
+        RotationMode    m_rotation;
+        ImageTransform  m_image_transform;
+        PixelCorrection m_pixel_correction;
+        FrameStatistics m_frame_statistics;
+        RoiCounters     m_roi_counters;
+        bool            m_roi_counters_only;
+        FrameAccumulator m_frame_accumulator;
+        FrameCompressor m_frame_compressor;
+        bool            m_compression_only;
+        SparseFrames    m_sparse_frames;
+        FrameVeto       m_frame_veto;
+        PeakFinder      m_peak_finder;
+        AzimuthalIntegrator m_azimuthal_integrator;
+        bool            m_azimuthal_only;
+        PumpProbe       m_pump_probe;
+        HdrMerger       m_hdr_merger;
+        double          m_hdr_exposure_ratio;		//- requested long / short ratio
+        unsigned int    m_hdr_short_exp_time_usec;	//- programmed at prepare from the exposure time and the ratio
+        PixelStatistics m_pixel_statistics;
+        HotPixelDetector m_hot_pixel_detector;
+        CalibrationCache m_calibration_cache;
+        bool            m_calibration_cache_active;
+        int             m_calibration_upload_nb_rows;
+        int             m_calibration_upload_nb_registers;
+        double          m_calibration_upload_elapsed_sec;
+        std::string     m_switch_calibration_path;
+        ThresholdScan   m_threshold_scan;
+        ThreadPool      m_scan_publish_pool;
+        SCurveFitter    m_scurve_fitter;
+        unsigned long   m_dacl_correction_mask;
+        Mutex           m_scurve_dispersion_lock;
+        std::vector<double> m_scurve_dispersion;
+        UniformityCheck m_uniformity_check;
+        PixelStatistics m_uniformity_statistics;
+        bool            m_uniformity_check_after_upload;
+        std::vector<unsigned short> m_dacl_upload;
+        unsigned long   m_dacl_upload_calib_id;
+        unsigned long   m_dacl_upload_modules_mask;
+        Mutex           m_dacl_upload_lock;
+        int             m_dacl_upload_nb_rows_done;
+        int             m_dacl_upload_nb_rows;
+        int             m_dacl_upload_nb_calls;
+        double          m_dacl_upload_elapsed_sec;
 
 
 		//---------------------------------
@@ -273,8 +573,16 @@ namespace Xpad
 		unsigned int			m_calib_ithl_max;
 		unsigned int			m_calib_itune;
 		unsigned int			m_calib_imfp;
+		unsigned long			m_calibration_modules_mask;
+		volatile bool			m_calibration_cancel;
+		volatile bool			m_calibration_running;
+		Timestamp				m_calibration_start;
+		Mutex					m_calibration_progress_lock;
+		int						m_calibration_nb_modules_done;
+		int						m_calibration_nb_modules;
+		double					m_calibration_elapsed_sec;
 		double					m_norm_factor;
-        //unsigned short*         m_dacl;
+        unsigned short*         m_dacl;
         unsigned int m_time_between_images_usec; //- Temps entre chaque image
         unsigned int m_time_before_start_usec;     //- Temps initial
         unsigned int m_shutter_time_usec;
@@ -288,6 +596,84 @@ namespace Xpad
 	    unsigned int m_specific_param_GP3;
 	    unsigned int m_specific_param_GP4;
 
+		//- Publishing
+		void publishImage(void* image, int hw_frame_nb);
+		template<typename T>
+		void correctImage(T* image, T* lima_img_ptr);
+		template<typename T>
+		void writeImage(T* image, T* lima_img_ptr);
+		void notifyMaxImageSizeChanged();
+		int getNbHwFramesPerFrame();
+		void autoDetectHotPixels();
+		enum CalibrationType {
+					CALIBRATION_OTN_SLOW,
+					CALIBRATION_OTN_MEDIUM,
+					CALIBRATION_OTN_FAST,
+					CALIBRATION_BEAM,
+					CALIBRATION_OTN
+		};
+		void runCalibration(CalibrationType type);
+		int calibrateModule(CalibrationType type, unsigned int module_mask, const std::string& path);
+		void reportCalibrationProgress(const char* name, int nb_modules_done, int nb_modules, double elapsed_sec);
+		void uploadCachedCalibration(const std::string& path, int calib_id);
+		unsigned long verifyLoadedModules(const CalibrationCache::Calibration& calibration, int calib_id, unsigned long load_mask);
+		void diffCalibrationModule(const CalibrationCache::Calibration& calibration, int calib_id, int module,
+								   std::vector<int>& rows, std::vector<int>& registers);
+		void saveCalibrationRows(const CalibrationCache::Calibration& calibration, int calib_id, int module,
+								 const std::vector<int>& rows, const std::vector<int>& registers);
+		bool saveCalibrationModule(const CalibrationCache::Calibration& calibration, int calib_id, int module,
+								   int& nb_rows, int& nb_registers);
+		void preloadCalibrations();
+		bool preloadCalibrationModule();
+		bool getKnownConfigG(std::vector<long>& config_g);
+		//- acquisitions run on their own thread: the task only handles the control messages
+		enum AcqCommand {ACQ_START_SYNC, ACQ_START_ASYNC, ACQ_START_ITHL_SCAN, ACQ_QUIT};
+		class AcqThread : public Thread
+		{
+		public:
+			AcqThread(Camera& camera) : m_camera(camera) {}
+		protected:
+			virtual void threadFunction();
+		private:
+			Camera&		m_camera;
+		};
+		friend class AcqThread;
+		AcqThread*		m_acq_thread;
+		Cond			m_acq_cond;
+		std::deque<AcqCommand> m_acq_commands;
+		bool			m_acq_running;		//- under m_acq_cond: an acquisition command is being run
+		//- one xpix sequence at a time: held by the acquisitions and the control messages
+		Mutex			m_hw_lock;
+
+		void postAcqCommand(AcqCommand command);
+		void runAcqCommands();
+		void acquireSync();
+		void acquireAsync();
+		void acquireThresholdScan();
+		int getHdrImgSeq(int nb_hw_frames);
+		void loadIthl(int ithl);
+		void freeImageArray(int nb_frames);
+
+		//- publishes the frames of a threshold scan step while the next step is acquired
+		class ScanPublishJob : public ThreadPool::Job
+		{
+		public:
+			ScanPublishJob(Camera& camera) : m_camera(camera), m_step(0), m_nb_hw_frames(0) {}
+			void setStep(int step, int nb_hw_frames);
+			//! throw the error of the last run, if any
+			void checkError();
+			virtual void run();
+		private:
+			Camera&		m_camera;
+			int			m_step;
+			int			m_nb_hw_frames;
+			std::string	m_error;
+		};
+		int getNbModuleIds();
+		void saveDaclRows();
+		void correctDaclModules();
+		void runUniformityCheck();
+
 		//- Internal algos
 		template<typename T> 
 		void doublePixelCorrectionForS140(T* image_to_correct,  T corrected_image[][S140_CORRECTED_NB_COLUMN]);
@@ -0,0 +1,55 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef XPADFLIPCTRLOBJ_H
+#define XPADFLIPCTRLOBJ_H
+
+#include "XpadCamera.h"
+#include "lima/HwFlipCtrlObj.h"
+
+namespace lima
+{
+  namespace Xpad
+  {
+    //*******************************************************************
+    // \class FlipCtrlObj
+    // \brief Control object providing Xpad flip interface
+    //*******************************************************************
+    class FlipCtrlObj : public HwFlipCtrlObj
+    {
+      DEB_CLASS_NAMESPC(DebModCamera, "FlipCtrlObj", "Xpad");
+
+    public:
+      FlipCtrlObj(Camera&);
+      virtual ~FlipCtrlObj();
+
+      virtual void setFlip(const Flip& flip);
+      virtual void getFlip(Flip& flip);
+      virtual void checkFlip(Flip& flip);
+
+    private:
+      Camera& 	m_cam;
+
+    };
+  } // namespace Xpad
+} // namespace lima
+
+#endif // XPADFLIPCTRLOBJ_H
@@ -0,0 +1,90 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef XPADFRAMEACCUMULATOR_H
+#define XPADFRAMEACCUMULATOR_H
+
+#include "lima/ThreadUtils.h"
+#include "lima/Debug.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace lima
+{
+namespace Xpad
+{
+	/*******************************************************************
+	* \class FrameAccumulator
+	* \brief sums N 16 bits hardware frames into one 32 bits frame
+	*
+	* A per pixel saturation map tells which pixels reached the saturation
+	* threshold in at least one of the hardware frames of the sum.
+	*******************************************************************/
+	class FrameAccumulator
+	{
+		DEB_CLASS_NAMESPC(DebModCamera, "FrameAccumulator", "Xpad");
+
+	public:
+		FrameAccumulator();
+
+		//! number of hardware frames per accumulated frame (1: no accumulation)
+		void setNbFrames(int nb_frames);
+		int getNbFrames() const {return m_nb_frames;}
+		bool isActive() const {return m_nb_frames > 1;}
+		//! hardware pixels >= threshold are flagged in the saturation map
+		void setSaturationThreshold(uint16_t threshold);
+		uint16_t getSaturationThreshold() const {return m_saturation_threshold;}
+
+		//! allocate the sum for images of nb_pixels
+		void prepare(int nb_pixels);
+
+		//- frame pass (acquisition task only)
+		//! add one hardware frame, true if the accumulated frame is complete
+		bool add(const uint16_t* frame);
+		//! the accumulated frame (valid when add() returned true)
+		uint32_t* getSum() {return &m_sum[0];}
+		//! restart the sum (after the accumulated frame is published)
+		void reset();
+
+		//- readers (any thread)
+		//! number of saturated pixels of the last completed frame
+		int getNbSaturated();
+		//! saturation map (non null = saturated) of the last completed frame
+		void getSaturationMap(std::vector<uint8_t>& saturation_map);
+
+	private:
+		int						m_nb_frames;
+		uint16_t				m_saturation_threshold;
+		int						m_nb_pixels;
+		int						m_nb_added;
+		std::vector<uint32_t>	m_sum;
+		std::vector<uint8_t>	m_saturation;
+
+		Mutex					m_lock;	//- protects the last completed map
+		std::vector<uint8_t>	m_last_saturation;
+		int						m_last_nb_saturated;
+	};
+
+} // namespace Xpad
+} // namespace lima
+
+#endif // XPADFRAMEACCUMULATOR_H
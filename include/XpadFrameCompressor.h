@@ -0,0 +1,150 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef XPADFRAMECOMPRESSOR_H
+#define XPADFRAMECOMPRESSOR_H
+
+#include "lima/SizeUtils.h"
+#include "lima/ThreadUtils.h"
+#include "lima/Timestamp.h"
+#include "lima/Debug.h"
+
+#include "XpadThreadPool.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace lima
+{
+namespace Xpad
+{
+	/*******************************************************************
+	* \class FrameCompressor
+	* \brief bitshuffle/LZ4 compression of the frames on a thread pool
+	*
+	* Each frame is compressed in one chunk in the format of the HDF5
+	* bitshuffle filter (id 32008, LZ4 variant): a chunk can be written as
+	* is with H5DOwrite_chunk for a (1, height, width) chunked dataset.
+	* Chunks are kept in a ring, frame n at [n % buffer size].
+	*******************************************************************/
+	class FrameCompressor
+	{
+		DEB_CLASS_NAMESPC(DebModCamera, "FrameCompressor", "Xpad");
+
+	public:
+		struct Report
+		{
+			int		nb_frames;
+			double	raw_size;			//- bytes
+			double	compressed_size;	//- bytes
+			double	ratio;				//- raw / compressed
+			double	elapsed_sec;		//- first frame in to last chunk out
+			double	throughput_mbs;		//- raw MB/s
+		};
+
+		FrameCompressor();
+		~FrameCompressor();
+
+		void setActive(bool active);
+		bool getActive();
+		//! latched at prepare
+		bool isActive() const {return m_active;}
+		void setNbThreads(int nb_threads);
+		//! number of chunks kept in the ring
+		void setBufferSize(int nb_frames);
+
+		//! allocate the input slots and clear the ring (frame_depth in bytes)
+		void prepare(const Size& frame_size, int frame_depth);
+
+		//- frame pass (acquisition task only)
+		//! a free frame buffer (blocks while all of them are being compressed)
+		void* getInputBuffer();
+		int getFrameMemSize() const {return m_frame_mem_size;}
+		//! compress the input buffer as frame frame_nb
+		void push(int frame_nb);
+		//! give back the input buffer without compressing it
+		void cancel();
+		//! wait for the pending frames (end of acquisition)
+		void flush();
+
+		//- readers (any thread)
+		//! copy the chunk of a frame, false if not available
+		bool readChunk(int frame_nb, std::vector<char>& chunk);
+		//! number of frames compressed by the current acquisition
+		int getNbFrames();
+		void getReport(Report& report);
+
+		//! bitshuffle/LZ4 compression of nb_elements of elem_size bytes, returns the chunk size
+		static int compress(const void* src, int nb_elements, int elem_size, std::vector<char>& dst);
+
+	private:
+		class CompressJob : public ThreadPool::Job
+		{
+		public:
+			CompressJob(FrameCompressor& compressor, int slot) :
+				m_compressor(compressor), m_slot(slot), m_frame_nb(-1) {}
+			void setFrameNb(int frame_nb) {m_frame_nb = frame_nb;}
+			virtual void run();
+
+		private:
+			FrameCompressor&	m_compressor;
+			int					m_slot;
+			int					m_frame_nb;
+			std::vector<char>	m_chunk;
+		};
+		friend class CompressJob;
+
+		void _releaseJobs();
+
+		//- configuration
+		bool						m_staged_active;
+		int							m_buffer_size;
+		ThreadPool					m_pool;
+
+		//- used by the frame pass (set in prepare)
+		bool						m_active;
+		int							m_nb_elements;
+		int							m_elem_size;
+		int							m_frame_mem_size;
+		std::vector<char*>			m_slots;
+		std::vector<CompressJob*>	m_jobs;
+		int							m_current_slot;
+
+		//- shared with the jobs
+		Cond						m_cond;
+		std::vector<int>			m_free_slots;
+		struct Chunk
+		{
+			int					frame_nb;
+			std::vector<char>	data;
+		};
+		std::vector<Chunk>			m_chunks;
+		int							m_nb_frames;
+		double						m_raw_size;
+		double						m_compressed_size;
+		Timestamp					m_start;
+		Timestamp					m_end;
+	};
+
+} // namespace Xpad
+} // namespace lima
+
+#endif // XPADFRAMECOMPRESSOR_H
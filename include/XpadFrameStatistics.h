@@ -0,0 +1,121 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef XPADFRAMESTATISTICS_H
+#define XPADFRAMESTATISTICS_H
+
+#include "lima/Debug.h"
+
+#include <stdint.h>
+#include <vector>
+
+//- number of bins of the per frame histogram (last bin gets the overflow)
+const int FRAME_STATISTICS_NB_BINS = 64;
+//- number of frame records kept (ring)
+const int FRAME_STATISTICS_HISTORY = 1024;
+
+namespace lima
+{
+namespace Xpad
+{
+	/*******************************************************************
+	* \class FrameStatistics
+	* \brief per frame statistics accumulated during the frame pass
+	*
+	* The records are written by the acquisition task only and read from
+	* any thread without lock: each slot of the ring is protected by a
+	* sequence counter (odd while the record is written).
+	*******************************************************************/
+	class FrameStatistics
+	{
+		DEB_CLASS_NAMESPC(DebModCamera, "FrameStatistics", "Xpad");
+
+	public:
+		struct Record
+		{
+			int			frame_nb;
+			uint64_t	sum;
+			uint32_t	max_value;
+			uint32_t	nb_saturated;
+			uint32_t	nb_above_threshold;
+			uint32_t	histogram[FRAME_STATISTICS_NB_BINS];
+		};
+
+		FrameStatistics();
+
+		void setActive(bool active);
+		bool getActive() const {return m_active;}
+		//! true if the statistics are computed for the current acquisition
+		bool isActive() const {return m_on;}
+		//! pixels >= threshold are counted as saturated (0: max value of the pixel type)
+		void setSaturationThreshold(uint32_t threshold);
+		uint32_t getSaturationThreshold() const {return m_saturation_threshold;}
+		//! pixels >= threshold are counted in nb_above_threshold (1: non null pixels)
+		void setCountThreshold(uint32_t threshold);
+		uint32_t getCountThreshold() const {return m_count_threshold;}
+		//! histogram bin of a pixel = value >> shift
+		void setHistogramShift(unsigned int shift);
+		unsigned int getHistogramShift() const {return m_histogram_shift;}
+
+		//! clear the records, width is the width of the processed image
+		//! (forced: computed even if not active, for the frame veto)
+		void prepare(int width, bool forced = false);
+
+		//- frame pass (acquisition task only)
+		void startFrame(int frame_nb);
+		template<typename T>
+		void accumulate(const T* image, int row_begin, int row_end);
+		//! publish the record of the current frame
+		void endFrame();
+		//! record of the frame being processed (not published yet)
+		const Record& currentRecord() const {return m_current;}
+
+		//- readers (any thread)
+		//! false if the record of frame_nb is not available (not yet processed or overwritten)
+		bool getRecord(int frame_nb, Record& record) const;
+		//! false if no frame was processed yet
+		bool getLastRecord(Record& record) const;
+
+	private:
+		struct Slot
+		{
+			volatile uint32_t	seq;
+			Record				record;
+		};
+
+		bool			m_active;
+		bool			m_on;
+		uint32_t		m_saturation_threshold;
+		uint32_t		m_count_threshold;
+		unsigned int	m_histogram_shift;
+		int				m_width;
+		Record			m_current;
+		std::vector<Slot> m_slots;
+		volatile int	m_last_frame_nb;
+	};
+
+	template<>
+	void FrameStatistics::accumulate<float>(const float* image, int row_begin, int row_end);
+
+} // namespace Xpad
+} // namespace lima
+
+#endif // XPADFRAMESTATISTICS_H
@@ -0,0 +1,105 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef XPADFRAMEVETO_H
+#define XPADFRAMEVETO_H
+
+#include "lima/ThreadUtils.h"
+#include "lima/Debug.h"
+
+#include "XpadFrameStatistics.h"
+
+#include <stdint.h>
+#include <vector>
+
+//- number of kept frames of which the acquired frame number is remembered
+const int FRAME_VETO_MAPPING_HISTORY = 65536;
+
+namespace lima
+{
+namespace Xpad
+{
+	/*******************************************************************
+	* \class FrameVeto
+	* \brief drops the empty frames using the frame statistics
+	*
+	* A frame is kept if its total counts and its number of pixels above
+	* the statistics count threshold reach the minimums, and if it is a hit
+	* when the peak finder is used. Kept frames are
+	* renumbered 0, 1, ... and the table kept frame -> acquired frame is
+	* kept for the last FRAME_VETO_MAPPING_HISTORY kept frames (live mode).
+	*******************************************************************/
+	class FrameVeto
+	{
+		DEB_CLASS_NAMESPC(DebModCamera, "FrameVeto", "Xpad");
+
+	public:
+		FrameVeto();
+
+		void setActive(bool active);
+		bool getActive();
+		//! latched at prepare
+		bool isActive() const {return m_active;}
+		//! minimum total counts of a kept frame
+		void setMinSum(uint64_t min_sum);
+		//! minimum number of pixels above the count threshold of a kept frame
+		void setMinNbPixels(uint32_t min_nb_pixels);
+
+		//! clear the mapping table
+		void prepare();
+
+		//- frame pass (acquisition task only)
+		//! number the current frame gets if it is kept
+		int getNextFrameNb() const {return m_nb_kept;}
+		//! true if the frame would be vetoed (no side effect)
+		bool isVetoed(const FrameStatistics::Record& record, bool hit = true) const
+			{return !hit || record.sum < m_min_sum || record.nb_above_threshold < m_min_nb_pixels;}
+		//! the kept frame number, -1 if the frame is vetoed
+		int check(const FrameStatistics::Record& record, bool hit = true);
+
+		//- readers (any thread)
+		int getNbKeptFrames();
+		int getNbVetoedFrames();
+		//! acquired frame number of a kept frame, -1 if unknown (or too old)
+		int getAcqFrameNb(int kept_frame_nb);
+		//! acquired frame numbers of the kept frames [first_kept_frame_nb, nb kept frames[
+		void getFrameMapping(int& first_kept_frame_nb, std::vector<int>& acq_frame_nbs);
+
+	private:
+		//- configuration
+		Mutex				m_lock;		//- protects the configuration and the mapping
+		bool				m_staged_active;
+		uint64_t			m_staged_min_sum;
+		uint32_t			m_staged_min_nb_pixels;
+
+		//- used by the frame pass (set in prepare)
+		bool				m_active;
+		uint64_t			m_min_sum;
+		uint32_t			m_min_nb_pixels;
+		int					m_nb_kept;
+		int					m_nb_vetoed;
+		std::vector<int>	m_acq_frame_nbs;	//- ring, kept frame n at [n % FRAME_VETO_MAPPING_HISTORY]
+	};
+
+} // namespace Xpad
+} // namespace lima
+
+#endif // XPADFRAMEVETO_H
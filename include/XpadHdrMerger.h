@@ -0,0 +1,103 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef XPADHDRMERGER_H
+#define XPADHDRMERGER_H
+
+#include "lima/ThreadUtils.h"
+#include "lima/Debug.h"
+
+#include <stdint.h>
+#include <vector>
+
+//- number of merge statistics kept (ring)
+const int HDR_HISTORY = 1024;
+
+namespace lima
+{
+namespace Xpad
+{
+	/*******************************************************************
+	* \class HdrMerger
+	* \brief merges short/long exposure pairs of 16 bits hardware frames
+	*
+	* Hardware frames 2n (short) and 2n+1 (long) give the 32 bits frame n:
+	* the long exposure where it is below the saturation threshold, the
+	* short exposure times the exposure ratio elsewhere. The merge map of
+	* the last frame tells, for each pixel: 0 long, 1 short, 2 short but
+	* saturated too.
+	*******************************************************************/
+	class HdrMerger
+	{
+		DEB_CLASS_NAMESPC(DebModCamera, "HdrMerger", "Xpad");
+
+	public:
+		struct Stats
+		{
+			int		frame_nb;
+			int		nb_long_pixels;
+			int		nb_short_pixels;
+			int		nb_saturated_pixels;	//- saturated in both exposures
+		};
+
+		HdrMerger();
+
+		void setActive(bool active);
+		bool isActive() const {return m_active;}
+		//! long exposure time / short exposure time
+		void setExposureRatio(double ratio);
+		double getExposureRatio() const {return m_ratio;}
+		//! hardware pixels >= threshold are taken from the short exposure
+		void setSaturationThreshold(uint16_t threshold);
+
+		//! allocate the frames for images of nb_pixels, clear the statistics
+		void prepare(int nb_pixels);
+
+		//- frame pass (acquisition task only)
+		//! add one hardware frame, true if the merged frame is complete
+		bool add(const uint16_t* frame, int hw_frame_nb);
+		//! the merged frame (valid when add() returned true)
+		uint32_t* getMerged() {return &m_merged[0];}
+
+		//- readers (any thread)
+		//! merge statistics of a frame, false if not available
+		bool getStats(int frame_nb, Stats& stats);
+		//! merge map of the last merged frame
+		void getMergeMap(std::vector<uint8_t>& merge_map);
+
+	private:
+		bool					m_active;
+		double					m_ratio;
+		uint16_t				m_saturation_threshold;
+		int						m_nb_pixels;
+		std::vector<uint16_t>	m_short;		//- hardware buffers are reused by the next frame
+		std::vector<uint32_t>	m_merged;
+		std::vector<uint8_t>	m_map;
+
+		Mutex					m_lock;	//- protects the statistics and the last map
+		std::vector<Stats>		m_stats;
+		std::vector<uint8_t>	m_last_map;
+	};
+
+} // namespace Xpad
+} // namespace lima
+
+#endif // XPADHDRMERGER_H
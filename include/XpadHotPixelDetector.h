@@ -0,0 +1,89 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef XPADHOTPIXELDETECTOR_H
+#define XPADHOTPIXELDETECTOR_H
+
+#include "lima/ThreadUtils.h"
+#include "lima/Debug.h"
+
+#include <stdint.h>
+#include <vector>
+
+//- flags of the detected pixels in the mask
+const uint8_t HOT_PIXEL = 0x1;
+const uint8_t COLD_PIXEL = 0x2;
+const uint8_t NOISY_PIXEL = 0x4;
+
+namespace lima
+{
+namespace Xpad
+{
+	/*******************************************************************
+	* \class HotPixelDetector
+	* \brief flags the pixels deviating from their chip on the pixel statistics
+	*
+	* For each chip, the median and the robust sigma (1.4826 * median
+	* absolute deviation, at least the Poisson error of the median) of the
+	* pixel mean counts per frame and of the pixel variances are computed.
+	* Pixels more than k sigma above (below) the median mean are hot (cold),
+	* more than k sigma above the median variance noisy. Chips are the cells
+	* of a nb chip columns x nb chip rows grid over the corrected image.
+	*******************************************************************/
+	class HotPixelDetector
+	{
+		DEB_CLASS_NAMESPC(DebModCamera, "HotPixelDetector", "Xpad");
+
+	public:
+		HotPixelDetector();
+
+		//! run at the end of each acquisition with pixel statistics
+		void setActive(bool active);
+		bool isActive() const {return m_active;}
+		void setKSigma(double k_sigma);
+
+		//! one pass over the maps (row major, nb frames >= 2)
+		void detect(const std::vector<float>& mean, const std::vector<float>& variance, int nb_frames,
+					int width, int height, int nb_chip_columns, int nb_chip_rows);
+
+		//- readers (any thread)
+		//! flags of each pixel of the last detection (0: good pixel)
+		void getMask(std::vector<uint8_t>& mask);
+		void getNbPixels(int& nb_hot, int& nb_cold, int& nb_noisy);
+
+		//! median and robust sigma (1.4826 * median absolute deviation), values are reordered
+		static void robustStats(std::vector<float>& values, double& median, double& sigma);
+
+	private:
+		bool					m_active;
+		double					m_k_sigma;
+
+		Mutex					m_lock;	//- protects the last detection
+		std::vector<uint8_t>	m_mask;
+		int						m_nb_hot;
+		int						m_nb_cold;
+		int						m_nb_noisy;
+	};
+
+} // namespace Xpad
+} // namespace lima
+
+#endif // XPADHOTPIXELDETECTOR_H
@@ -0,0 +1,81 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef XPADIMAGETRANSFORM_H
+#define XPADIMAGETRANSFORM_H
+
+#include "lima/Constants.h"
+#include "lima/SizeUtils.h"
+#include "lima/Debug.h"
+
+namespace lima
+{
+namespace Xpad
+{
+	/*******************************************************************
+	* \class ImageTransform
+	* \brief flip and rotation applied while writing an image into the lima buffer
+	*
+	* The flip is applied first, then the (clockwise) rotation.
+	* Each source pixel (x,y) is written at dst[base + x*dx + y*dy],
+	* so that every flip/rotation combination is a single pass over the image.
+	*******************************************************************/
+	class ImageTransform
+	{
+		DEB_CLASS_NAMESPC(DebModCamera, "ImageTransform", "Xpad");
+
+	public:
+		ImageTransform();
+
+		//! compute the index mapping for a src image of size src_size
+		void setup(const Size& src_size, const Flip& flip, RotationMode rotation);
+		//! size of the image written in the lima buffer
+		void getDstSize(Size& dst_size) const;
+		//! true if the lima buffer is a plain copy of the src image
+		bool isIdentity() const {return m_identity;}
+		//! index in the lima buffer of the src pixel (x,y)
+		long getDstIndex(int x, int y) const {return m_base + x * m_dx + y * m_dy;}
+		//! true if a row major scan of src gives increasing dst indexes
+		bool isScanOrdered() const {return m_dx == 1 && m_dy > 0;}
+
+		//! write the rows [row_begin, row_end[ of src into dst
+		template<typename T>
+		void apply(const T* src, T* dst, int row_begin, int row_end) const;
+		//! write the whole src image into dst
+		template<typename T>
+		void apply(const T* src, T* dst) const {apply<T>(src, dst, 0, m_height);}
+
+	private:
+		int		m_width;
+		int		m_height;
+		bool	m_swap_axes;
+		bool	m_identity;
+		long	m_base;
+		long	m_dx;
+		long	m_dy;
+
+		long	_dstIndex(long x, long y, const Flip& flip, RotationMode rotation) const;
+	};
+
+} // namespace Xpad
+} // namespace lima
+
+#endif // XPADIMAGETRANSFORM_H
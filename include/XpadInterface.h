@@ -29,6 +29,7 @@
 #include "XpadBufferCtrlObj.h"
 #include "XpadSyncCtrlObj.h"
 #include "XpadEventCtrlObj.h"
+#include "XpadFlipCtrlObj.h"
 
 using namespace lima;
 using namespace lima::Xpad;
@@ -70,6 +71,7 @@ class Interface : public HwInterface
 	BufferCtrlObj	m_buffer;
 	SyncCtrlObj		m_sync;
     EventCtrlObj    m_event;
+	FlipCtrlObj		m_flip;
 
 };
 } // namespace xpad
@@ -0,0 +1,167 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef XPADPEAKFINDER_H
+#define XPADPEAKFINDER_H
+
+#include "lima/SizeUtils.h"
+#include "lima/ThreadUtils.h"
+#include "lima/Debug.h"
+
+#include "XpadThreadPool.h"
+
+#include <stdint.h>
+#include <vector>
+
+//- number of frame peak lists kept (ring)
+const int PEAK_FINDER_HISTORY = 1024;
+
+namespace lima
+{
+namespace Xpad
+{
+	/*******************************************************************
+	* \class PeakFinder
+	* \brief Bragg peak finder on the corrected frames (hit finding)
+	*
+	* A seed is a local maximum >= threshold standing snr * sigma above
+	* the local background (mean/sigma of the annulus radius/2 < d <= radius
+	* around it). The peak is the 8-connected component of the pixels above
+	* the same level, kept by the seed holding its maximum only.
+	* The frame is split in bands shared by the threads of a pool; a
+	* component may cross bands as the whole frame is readable.
+	* Coordinates are in the corrected image geometry (before flip/rotation).
+	*******************************************************************/
+	class PeakFinder
+	{
+		DEB_CLASS_NAMESPC(DebModCamera, "PeakFinder", "Xpad");
+
+	public:
+		struct Peak
+		{
+			float	x;				//- centroid (background subtracted intensity weighted)
+			float	y;
+			float	intensity;		//- background subtracted sum
+			float	max_value;		//- background subtracted max
+			float	background;
+			int		nb_pixels;
+		};
+
+		PeakFinder();
+		~PeakFinder();
+
+		void setActive(bool active);
+		bool getActive();
+		//! latched at prepare
+		bool isActive() const {return m_active;}
+		void setNbThreads(int nb_threads);
+		//! minimum value of the peak pixels
+		void setThreshold(double threshold);
+		//! minimum signal to noise of the peak pixels above the local background
+		void setSnr(double snr);
+		//! outer radius of the local background annulus
+		void setBackgroundRadius(int radius);
+		//! number of pixels of a peak
+		void setPixelRange(int min_nb_pixels, int max_nb_pixels);
+		//! a frame is a hit if it has at least min_nb_peaks peaks
+		void setMinNbPeaks(int min_nb_peaks);
+
+		//! clear the peak lists, allocate the threads work maps
+		void prepare(const Size& image_size);
+
+		//- frame pass (acquisition task only)
+		void startFrame(int frame_nb);
+		//! find the peaks of the whole (corrected) image, returns when done
+		template<typename T>
+		void process(const T* image);
+		bool isHit() const {return int(m_peaks.size()) >= m_params.min_nb_peaks;}
+		void endFrame();
+
+		//- readers (any thread)
+		//! copy the peaks of a frame, false if not available
+		bool getPeaks(int frame_nb, std::vector<Peak>& peaks);
+		//! number of frames processed and of hits of the current acquisition
+		void getNbFrames(int& nb_frames, int& nb_hits);
+
+	private:
+		enum PixelType {UINT16, UINT32, FLOAT};
+
+		struct Params
+		{
+			double	threshold;
+			double	snr;
+			int		background_radius;
+			int		min_nb_pixels;
+			int		max_nb_pixels;
+			int		min_nb_peaks;
+		};
+
+		class BandJob : public ThreadPool::Job
+		{
+		public:
+			BandJob(PeakFinder& finder) : m_finder(finder) {}
+			virtual void run();
+
+			std::vector<uint8_t>	m_visited;
+			std::vector<int>		m_pixels;
+			std::vector<Peak>		m_peaks;
+		private:
+			PeakFinder&				m_finder;
+		};
+		friend class BandJob;
+
+		template<typename T>
+		void _findPeaks(const T* image, int row_begin, int row_end, BandJob& job) const;
+
+		//- configuration
+		Mutex					m_lock;		//- protects the configuration and the peak lists
+		bool					m_staged_active;
+		Params					m_staged_params;
+		ThreadPool				m_pool;
+
+		//- used by the frame pass (set in prepare)
+		bool					m_active;
+		Params					m_params;
+		int						m_width;
+		int						m_height;
+		std::vector<BandJob*>	m_jobs;
+		const void*				m_image;
+		PixelType				m_pixel_type;
+		volatile int			m_next_band;
+		int						m_nb_bands;
+		int						m_frame_nb;
+		std::vector<Peak>		m_peaks;
+
+		//- peak lists
+		struct FramePeaks
+		{
+			int					frame_nb;
+			std::vector<Peak>	peaks;
+		};
+		std::vector<FramePeaks>	m_frames;
+		int						m_nb_frames;
+		int						m_nb_hits;
+	};
+
+} // namespace Xpad
+} // namespace lima
+
+#endif // XPADPEAKFINDER_H
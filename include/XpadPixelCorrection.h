@@ -0,0 +1,134 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef XPADPIXELCORRECTION_H
+#define XPADPIXELCORRECTION_H
+
+#include "lima/SizeUtils.h"
+#include "lima/ThreadUtils.h"
+#include "lima/Debug.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+//- flat field factors are stored as unsigned fixed point numbers
+const int FLAT_FIELD_FRACTION_BITS = 16;
+
+namespace lima
+{
+namespace Xpad
+{
+	/*******************************************************************
+	* \class PixelCorrection
+	* \brief per pixel corrections applied on the corrected image rows
+	*
+	* - count rate (dead time, non paralyzable model): pixel = pixel / (1 - pixel * tau / Texp)
+	*   with tau per module (16 bits: lookup table per module) or per pixel
+	* - flat field: pixel = pixel * flat (fixed point factors)
+	* - mask: pixels with a non null mask value (dead, hot, gaps...) are replaced by the fill value
+	*
+	* Maps are loaded (staged) at any time and are committed in prepare(),
+	* so that the frame pass never takes a lock.
+	*******************************************************************/
+	class PixelCorrection
+	{
+		DEB_CLASS_NAMESPC(DebModCamera, "PixelCorrection", "Xpad");
+
+	public:
+		PixelCorrection();
+
+		//! load a flat field map: raw float32 file, one value per pixel of the corrected image
+		void loadFlatField(const std::string& path, const Size& image_size);
+		//! load a pixel mask: raw uint8 file, one value per pixel of the corrected image
+		void loadMask(const std::string& path, const Size& image_size);
+		//! set a pixel mask from memory (non null value = masked pixel)
+		void setMask(const std::vector<uint8_t>& mask, const Size& image_size);
+		//! get the pixel mask used from the next prepare (empty if none)
+		void getMask(std::vector<uint8_t>& mask);
+		//! set the dead time (ns) of each module
+		void setModuleDeadTimes(const std::vector<double>& dead_times_ns);
+		//! load a per pixel dead time map: raw float32 file (ns), one value per pixel of the corrected image
+		void loadDeadTimeMap(const std::string& path, const Size& image_size);
+
+		void setFlatFieldActive(bool active);
+		bool getFlatFieldActive() const {return m_flat_active;}
+		void setMaskActive(bool active);
+		bool getMaskActive() const {return m_mask_active;}
+		void setRateCorrectionActive(bool active);
+		bool getRateCorrectionActive() const {return m_rate_active;}
+		//! value written in the masked pixels
+		void setMaskFillValue(unsigned int fill_value);
+		unsigned int getMaskFillValue() const {return m_fill_value;}
+
+		//! commit the staged maps, check them against the image size and build the rate tables
+		//! module_gap_rows: rows inserted between two modules (double pixel correction), < 0 if the geometry is unknown
+		void prepare(const Size& image_size, unsigned int exp_time_usec, int nb_modules, int module_gap_rows);
+		//! true if at least one correction is applied
+		bool isActive() const {return m_rate_on || m_flat_on || m_mask_on;}
+
+		//! correct in place the rows [row_begin, row_end[ of image
+		template<typename T>
+		void apply(T* image, int row_begin, int row_end) const;
+
+	private:
+		Mutex					m_lock;			//- protects the staged maps
+		std::vector<uint32_t>	m_staged_flat;
+		std::vector<uint8_t>	m_staged_mask;
+		bool					m_flat_staged;
+		bool					m_mask_staged;
+		std::vector<double>		m_staged_module_dead_times;
+		std::vector<float>		m_staged_pixel_dead_times;
+		bool					m_rate_staged;
+		bool					m_flat_active;
+		bool					m_mask_active;
+		bool					m_rate_active;
+		unsigned int			m_fill_value;
+		std::vector<double>		m_module_dead_times;	//- ns
+		std::vector<float>		m_pixel_dead_times;		//- ns, used if not empty
+
+		//- used by the frame pass only (set in prepare)
+		std::vector<uint32_t>	m_flat;
+		std::vector<uint8_t>	m_mask;
+		std::vector<float>		m_rate_k;			//- tau / Texp, per pixel
+		std::vector<float>		m_module_k;			//- tau / Texp, per module
+		std::vector<int>		m_row_module;		//- module of each image row
+		std::vector<std::vector<uint16_t> > m_rate_lut;	//- per module: raw count -> corrected count
+		bool					m_rate_per_pixel;
+		bool					m_flat_on;
+		bool					m_mask_on;
+		bool					m_rate_on;
+		int						m_width;
+
+		void _correctRate(uint16_t* image, int row_begin, int row_end) const;
+		void _correctRate(uint32_t* image, int row_begin, int row_end) const;
+		void _correctRate(float* image, int row_begin, int row_end) const;
+		static void _readFile(const std::string& path, size_t nb_bytes, char* buffer);
+	};
+
+	//- float images (S540 geometrical correction) are corrected in floating point
+	template<>
+	void PixelCorrection::apply<float>(float* image, int row_begin, int row_end) const;
+
+} // namespace Xpad
+} // namespace lima
+
+#endif // XPADPIXELCORRECTION_H
@@ -0,0 +1,134 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef XPADPIXELSTATISTICS_H
+#define XPADPIXELSTATISTICS_H
+
+#include "lima/SizeUtils.h"
+#include "lima/ThreadUtils.h"
+#include "lima/Debug.h"
+
+#include "XpadThreadPool.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace lima
+{
+namespace Xpad
+{
+	/*******************************************************************
+	* \class PixelStatistics
+	* \brief per pixel mean, variance and count histogram over the frames
+	*
+	* Mean and variance are updated with the Welford recurrence, the
+	* histogram has fixed bins (values below the first bin go to the first
+	* one, above the last bin to the last one). The data are stored by
+	* tiles of rows (mean, m2 and histograms of a tile are contiguous)
+	* shared by the threads of a pool. Maps are in the corrected image
+	* geometry (before flip/rotation) and can be read during the acquisition.
+	*******************************************************************/
+	class PixelStatistics
+	{
+		DEB_CLASS_NAMESPC(DebModCamera, "PixelStatistics", "Xpad");
+
+	public:
+		PixelStatistics();
+		~PixelStatistics();
+
+		void setActive(bool active);
+		bool getActive();
+		//! latched at prepare
+		bool isActive() const {return m_active;}
+		void setNbThreads(int nb_threads);
+		//! histogram of nb_bins bins of bin_width from bin_min
+		void setHistogram(int nb_bins, double bin_min, double bin_width);
+
+		//! clear the statistics
+		void prepare(const Size& image_size);
+
+		//- frame pass (acquisition task only)
+		//! add the whole (corrected) image, returns when done
+		template<typename T>
+		void process(const T* image);
+
+		//- readers (any thread), maps are row major
+		int getNbFrames();
+		void getSize(int& width, int& height);
+		int getNbBins();
+		void getMean(std::vector<float>& mean);
+		//! unbiased variance (0 before 2 frames)
+		void getVariance(std::vector<float>& variance);
+		//! nb bins counts per pixel
+		void getHistograms(std::vector<uint32_t>& histograms);
+		//! write <prefix>_mean.f32, <prefix>_variance.f32 and <prefix>_histogram.u32 (raw, host byte order)
+		void save(const std::string& prefix);
+
+	private:
+		enum PixelType {UINT16, UINT32, FLOAT};
+
+		class TileJob : public ThreadPool::Job
+		{
+		public:
+			TileJob(PixelStatistics& statistics) : m_statistics(statistics) {}
+			virtual void run();
+		private:
+			PixelStatistics&		m_statistics;
+		};
+		friend class TileJob;
+
+		template<typename T>
+		void _addTile(const T* image, int tile);
+		void _getMoment(int moment, std::vector<float>& map);
+
+		//- configuration
+		Mutex					m_lock;		//- protects the configuration
+		bool					m_staged_active;
+		int						m_staged_nb_bins;
+		double					m_staged_bin_min;
+		double					m_staged_bin_width;
+		ThreadPool				m_pool;
+
+		//- used by the frame pass (set in prepare)
+		bool					m_active;
+		int						m_nb_bins;
+		double					m_bin_min;
+		double					m_bin_width;
+		int						m_width;
+		int						m_height;
+		int						m_nb_tiles;
+		std::vector<TileJob*>	m_jobs;
+		const void*				m_image;
+		PixelType				m_pixel_type;
+		volatile int			m_next_tile;
+
+		//- statistics (by tiles)
+		Mutex					m_data_lock;	//- held by the frame pass and the readers
+		std::vector<double>		m_moments;		//- mean then m2 of each tile
+		std::vector<uint32_t>	m_histograms;	//- nb bins per pixel
+		int						m_nb_frames;
+	};
+
+} // namespace Xpad
+} // namespace lima
+
+#endif // XPADPIXELSTATISTICS_H
@@ -0,0 +1,112 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef XPADPUMPPROBE_H
+#define XPADPUMPPROBE_H
+
+#include "lima/SizeUtils.h"
+#include "lima/ThreadUtils.h"
+#include "lima/Debug.h"
+
+#include "XpadImageTransform.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace lima
+{
+namespace Xpad
+{
+	/*******************************************************************
+	* \class PumpProbe
+	* \brief per delay accumulation of the frames of a pump-probe sequence
+	*
+	* Frame n belongs to the delay n % nb delays. Its corrected image is
+	* added (32 bits, vectorized) to the sum of its delay during the frame
+	* pass. The sums are published (lima frame geometry, with the number
+	* of frames of each delay) every publish period cycles and at the end
+	* of the acquisition; readers only see published sums.
+	*******************************************************************/
+	class PumpProbe
+	{
+		DEB_CLASS_NAMESPC(DebModCamera, "PumpProbe", "Xpad");
+
+	public:
+		PumpProbe();
+
+		void setActive(bool active);
+		bool getActive();
+		//! latched at prepare
+		bool isActive() const {return m_active;}
+		void setNbDelays(int nb_delays);
+		//! number of cycles (nb delays frames) between publications, 0: at the end only
+		void setPublishPeriod(int nb_cycles);
+
+		//! clear the sums, the transform gives the lima frame geometry
+		void prepare(const Size& image_size, const ImageTransform& transform);
+
+		//- frame pass (acquisition task only)
+		void startFrame(int frame_nb);
+		template<typename T>
+		void accumulate(const T* image, int row_begin, int row_end);
+		void endFrame();
+		//! publish the frames added since the last publication (end of acquisition)
+		void flush();
+
+		//- readers (any thread)
+		int getNbDelays();
+		//! copy the published sum of a delay, false if nothing published yet
+		bool getSum(int delay, std::vector<uint32_t>& sum, int& nb_frames);
+		//! number of publications of the current acquisition
+		int getNbPublications();
+
+	private:
+		void _publish();
+
+		//- configuration
+		Mutex					m_lock;		//- protects the configuration and the published sums
+		bool					m_staged_active;
+		int						m_staged_nb_delays;
+		int						m_staged_publish_period;
+
+		//- used by the frame pass (set in prepare)
+		bool					m_active;
+		int						m_nb_delays;
+		int						m_publish_period;
+		const ImageTransform*	m_transform;
+		int						m_width;
+		long					m_nb_pixels;
+		std::vector<uint32_t>	m_sums;			//- nb delays x corrected image
+		std::vector<int>		m_counts;
+		int						m_frame_nb;
+		uint32_t*				m_sum;			//- sum of the current frame delay
+		int						m_nb_pending;	//- frames added since the last publication
+
+		//- published sums
+		std::vector<uint32_t>	m_published_sums;	//- nb delays x lima frame
+		std::vector<int>		m_published_counts;
+		int						m_nb_publications;
+	};
+
+} // namespace Xpad
+} // namespace lima
+
+#endif // XPADPUMPPROBE_H
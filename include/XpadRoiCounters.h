@@ -0,0 +1,113 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef XPADROICOUNTERS_H
+#define XPADROICOUNTERS_H
+
+#include "lima/SizeUtils.h"
+#include "lima/ThreadUtils.h"
+#include "lima/Debug.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+//- max number of roi counters (rectangles + mask labels)
+const int MAX_NB_ROI_COUNTERS = 32;
+
+namespace lima
+{
+namespace Xpad
+{
+	/*******************************************************************
+	* \class RoiCounters
+	* \brief integrated intensity of rois computed during the frame pass
+	*
+	* Rois are rectangles and/or the labels (1..N) of a uint8 mask, in the
+	* corrected image geometry (before flip/rotation).
+	* The sums of each frame are pushed in a ring (time series), counters of
+	* roi i of frame n are at [n * nb_rois + i].
+	*******************************************************************/
+	class RoiCounters
+	{
+		DEB_CLASS_NAMESPC(DebModCamera, "RoiCounters", "Xpad");
+
+	public:
+		RoiCounters();
+
+		//! rectangles as a list of x, y, width, height
+		void setRois(const std::vector<int>& rois);
+		//! load a mask: raw uint8 file, a pixel with label k (1..N) belongs to the mask roi k
+		void loadMask(const std::string& path, const Size& image_size);
+		//! remove all the rois
+		void clear();
+		//! number of frames kept in the time series
+		void setBufferSize(int nb_frames);
+		//! number of rois of the current acquisition (rectangles first, then mask labels)
+		int getNbRois() const {return m_nb_rois;}
+		bool isActive() const {return m_nb_rois > 0;}
+
+		//! check the rois against the image size and clear the time series
+		void prepare(const Size& image_size);
+
+		//- frame pass (acquisition task only)
+		void startFrame(int frame_nb);
+		template<typename T>
+		void accumulate(const T* image, int row_begin, int row_end);
+		void endFrame();
+
+		//! copy the counters of [first_frame, first_frame + nb_frames[, returns the number of frames copied
+		int read(int first_frame, int nb_frames, std::vector<double>& counters);
+		//! number of frames pushed in the time series
+		int getNbFrames();
+
+	private:
+		struct Rect
+		{
+			int x, y, width, height;
+		};
+
+		//- configuration
+		Mutex					m_lock;		//- protects the configuration and the time series
+		std::vector<Rect>		m_staged_rects;
+		std::vector<uint8_t>	m_staged_mask;
+		int						m_staged_nb_labels;
+		int						m_buffer_size;
+
+		//- used by the frame pass (set in prepare)
+		std::vector<Rect>		m_rects;
+		std::vector<uint8_t>	m_mask;
+		int						m_nb_labels;
+		int						m_nb_rois;
+		int						m_width;
+		int						m_frame_nb;
+		double					m_rect_sums[MAX_NB_ROI_COUNTERS];
+		double					m_label_sums[256];
+
+		//- time series
+		std::vector<double>		m_series;
+		int						m_nb_frames;
+	};
+
+} // namespace Xpad
+} // namespace lima
+
+#endif // XPADROICOUNTERS_H
@@ -0,0 +1,142 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef XPADSCURVEFITTER_H
+#define XPADSCURVEFITTER_H
+
+#include "lima/ThreadUtils.h"
+#include "lima/Debug.h"
+
+#include "XpadThreadPool.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace lima
+{
+namespace Xpad
+{
+	/*******************************************************************
+	* \class SCurveFitter
+	* \brief per pixel S-curve fit of a threshold scan
+	*
+	* The counts of each ITHL step are summed, the absolute difference
+	* with the previous step is the derivative of the S-curve. Its first
+	* moments give the threshold (mean, the inflection point of the
+	* error function) and the noise (rms, the error function sigma)
+	* of each pixel. The maps are in the raw image geometry (modules of
+	* CHIP_NB_ROW rows from top to bottom, chips of CHIP_NB_COLUMN
+	* columns from left to right), the pixels without any count change
+	* are NaN.
+	*
+	* The DACL correction moves the threshold of each pixel towards the
+	* median threshold of its chip.
+	*******************************************************************/
+	class SCurveFitter
+	{
+		DEB_CLASS_NAMESPC(DebModCamera, "SCurveFitter", "Xpad");
+
+	public:
+		SCurveFitter();
+		~SCurveFitter();
+
+		void setActive(bool active);
+		bool getActive();
+		//! latched at prepare
+		bool isActive() const {return m_active;}
+		void setNbThreads(int nb_threads);
+		//! DACL step = round(threshold offset x dacl_per_ithl) (the sign depends on the chips), DACL in [0, dacl_max]
+		void setDaclCorrection(double dacl_per_ithl, int dacl_max);
+		void getDaclCorrection(double& dacl_per_ithl, int& dacl_max);
+
+		//! clear the fit, width x height is the raw image
+		void prepare(int width, int height);
+
+		//- scan (publishing thread only)
+		//! add a hardware frame to the counts of the current step
+		template<typename T>
+		void add(const T* frame);
+		//! the counts of the current step are complete
+		void endStep(int ithl);
+
+		//- readers (any thread)
+		int getNbSteps();
+		void getSize(int& width, int& height);
+		void getThresholds(std::vector<float>& thresholds);
+		void getNoise(std::vector<float>& noise);
+		//! corrected DACL (raw image geometry) of the module indexes in the mask, the others are copied,
+		//! dispersion is the rms of the pixel thresholds around their chip median per module index
+		void correctDacl(const uint16_t* dacl, unsigned int module_index_mask,
+						 uint16_t* corrected_dacl, std::vector<double>& dispersion);
+
+	private:
+		enum Operation {ADD_UINT16, ADD_UINT32, FIRST_STEP, NEXT_STEP};
+
+		class BlockJob : public ThreadPool::Job
+		{
+		public:
+			BlockJob(SCurveFitter& fitter) : m_fitter(fitter) {}
+			virtual void run();
+		private:
+			SCurveFitter&		m_fitter;
+		};
+		friend class BlockJob;
+
+		void _run(Operation operation, const void* frame);
+		template<typename T>
+		void _addBlock(const T* frame, long first, long last);
+		void _stepBlock(long first, long last);
+		void _fit(std::vector<float>& thresholds, std::vector<float>& noise);
+
+		//- configuration
+		Mutex					m_lock;		//- protects the configuration
+		bool					m_staged_active;
+		double					m_dacl_per_ithl;
+		int						m_dacl_max;
+		ThreadPool				m_pool;
+
+		//- used by the scan (set in prepare)
+		bool					m_active;
+		int						m_width;
+		int						m_height;
+		long					m_nb_blocks;
+		std::vector<BlockJob*>	m_jobs;
+		Operation				m_operation;
+		const void*				m_frame;
+		float					m_x;		//- ITHL of the derivative, from the first step
+		volatile int			m_next_block;
+
+		//- fit
+		Mutex					m_data_lock;	//- held by the scan and the readers
+		std::vector<uint32_t>	m_counts;		//- current step
+		std::vector<uint32_t>	m_previous_counts;
+		std::vector<float>		m_sum;			//- derivative moments 0, 1 and 2
+		std::vector<float>		m_sum_x;
+		std::vector<float>		m_sum_x2;
+		int						m_nb_steps;
+		int						m_first_ithl;
+		int						m_previous_ithl;
+	};
+
+} // namespace Xpad
+} // namespace lima
+
+#endif // XPADSCURVEFITTER_H
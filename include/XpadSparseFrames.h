@@ -0,0 +1,128 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef XPADSPARSEFRAMES_H
+#define XPADSPARSEFRAMES_H
+
+#include "lima/SizeUtils.h"
+#include "lima/ThreadUtils.h"
+#include "lima/Debug.h"
+
+#include "XpadImageTransform.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace lima
+{
+namespace Xpad
+{
+	/*******************************************************************
+	* \class SparseFrames
+	* \brief photon event (pixel index, count) encoding of the frames
+	*
+	* Non null pixels are found with a vectorized zero skipping scan during
+	* the frame pass. Indexes are in the lima frame geometry (flipped/rotated),
+	* in increasing order. A frame with more non null pixels than the
+	* occupancy threshold is dense: it is given to lima (dense frames are
+	* numbered one after the other) and the ring only records its lima
+	* frame number. Frames are kept in a ring, frame n at [n % buffer size].
+	*******************************************************************/
+	class SparseFrames
+	{
+		DEB_CLASS_NAMESPC(DebModCamera, "SparseFrames", "Xpad");
+
+	public:
+		SparseFrames();
+
+		void setActive(bool active);
+		bool getActive();
+		//! latched at prepare
+		bool isActive() const {return m_active;}
+		//! fraction of non null pixels above which a frame is kept dense
+		void setOccupancyThreshold(double occupancy);
+		//! number of frames kept in the ring
+		void setBufferSize(int nb_frames);
+
+		//! clear the ring, the transform gives the lima frame geometry
+		void prepare(const Size& image_size, const ImageTransform& transform);
+
+		//- frame pass (acquisition task only)
+		void startFrame(int frame_nb);
+		template<typename T>
+		void accumulate(const T* image, int row_begin, int row_end);
+		//! true if the current frame is dense (given to lima)
+		bool isDenseFrame() const {return m_dense;}
+		//! lima frame number of the current dense frame
+		int getDenseLimaFrameNb() const {return m_nb_published;}
+		//! published: the dense frame has been given to lima
+		void endFrame(bool published);
+
+		//- readers (any thread)
+		//! copy a frame: 0 if sparse, 1 if dense (no event, lima_frame_nb is its lima frame or -1 if vetoed),
+		//! -1 if not available
+		int readFrame(int frame_nb, std::vector<uint32_t>& indexes, std::vector<uint32_t>& values, int& lima_frame_nb);
+		//! number of frames of the current acquisition (sparse and dense)
+		int getNbFrames();
+		int getNbDenseFrames();
+
+	private:
+		struct Event
+		{
+			uint32_t	index;
+			uint32_t	value;
+			bool operator<(const Event& other) const {return index < other.index;}
+		};
+		struct Frame
+		{
+			int						frame_nb;
+			bool					dense;
+			int						lima_frame_nb;
+			std::vector<Event>		events;
+		};
+
+		//- configuration
+		Mutex					m_lock;		//- protects the configuration and the ring
+		bool					m_staged_active;
+		double					m_occupancy;
+		int						m_buffer_size;
+
+		//- used by the frame pass (set in prepare)
+		bool					m_active;
+		const ImageTransform*	m_transform;
+		int						m_width;
+		int						m_nb_pixels;
+		int						m_max_nb_events;
+		int						m_frame_nb;
+		bool					m_dense;
+		Frame					m_frame;
+		int						m_nb_published;
+
+		//- ring
+		std::vector<Frame>		m_frames;
+		int						m_nb_frames;
+		int						m_nb_dense_frames;
+	};
+
+} // namespace Xpad
+} // namespace lima
+
+#endif // XPADSPARSEFRAMES_H
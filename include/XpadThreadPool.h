@@ -0,0 +1,92 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef XPADTHREADPOOL_H
+#define XPADTHREADPOOL_H
+
+#include "lima/ThreadUtils.h"
+#include "lima/Debug.h"
+
+#include <deque>
+#include <vector>
+
+namespace lima
+{
+namespace Xpad
+{
+	/*******************************************************************
+	* \class ThreadPool
+	* \brief fixed set of worker threads running posted jobs
+	*
+	* Jobs are not owned by the pool: they must live until wait() returns.
+	* Threads are started on the first post.
+	*******************************************************************/
+	class ThreadPool
+	{
+		DEB_CLASS_NAMESPC(DebModCamera, "ThreadPool", "Xpad");
+
+	public:
+		class Job
+		{
+		public:
+			virtual ~Job() {}
+			virtual void run() = 0;
+		};
+
+		//! nb_threads = 0: one thread per online cpu
+		ThreadPool(int nb_threads = 0);
+		~ThreadPool();
+
+		//! change the number of threads (waits for the pending jobs)
+		void setNbThreads(int nb_threads);
+		int getNbThreads() const {return m_nb_threads;}
+
+		void post(Job* job);
+		//! wait until all the posted jobs are done
+		void wait();
+
+	private:
+		class WorkerThread : public Thread
+		{
+		public:
+			WorkerThread(ThreadPool& pool) : m_pool(pool) {}
+		protected:
+			virtual void threadFunction();
+		private:
+			ThreadPool& m_pool;
+		};
+
+		void _startThreads();
+		void _stopThreads();
+		void _runJobs();
+
+		Cond						m_cond;
+		int							m_nb_threads;
+		std::vector<WorkerThread*>	m_threads;
+		std::deque<Job*>			m_jobs;
+		int							m_nb_running;
+		bool						m_quit;
+	};
+
+} // namespace Xpad
+} // namespace lima
+
+#endif // XPADTHREADPOOL_H
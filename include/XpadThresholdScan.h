@@ -0,0 +1,87 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef XPADTHRESHOLDSCAN_H
+#define XPADTHRESHOLDSCAN_H
+
+#include "lima/ThreadUtils.h"
+#include "lima/Debug.h"
+
+#include <vector>
+
+namespace lima
+{
+namespace Xpad
+{
+	/*******************************************************************
+	* \class ThresholdScan
+	* \brief ITHL steps of a threshold scan acquisition
+	*
+	* Frame n of the acquisition is exposed with ITHL = start + n * step,
+	* from start to stop (included if on a step). The ITHL of each
+	* published frame is kept until the next prepare.
+	*******************************************************************/
+	class ThresholdScan
+	{
+		DEB_CLASS_NAMESPC(DebModCamera, "ThresholdScan", "Xpad");
+
+	public:
+		ThresholdScan();
+
+		void setActive(bool active);
+		bool isActive() const {return m_active;}
+		void setRange(int ithl_start, int ithl_stop, int ithl_step);
+		void getRange(int& ithl_start, int& ithl_stop, int& ithl_step);
+		//! number of ITHL steps of the staged range
+		int getNbSteps();
+
+		//! latch the range, clear the published ITHL values
+		void prepare();
+
+		//- scan (acquisition task only)
+		int getNbPreparedSteps() const {return m_nb_steps;}
+		int getIthl(int step) const {return m_start + step * m_step;}
+		//! the frame of the step is published
+		void setPublished(int step);
+
+		//- readers (any thread)
+		//! ITHL of a published frame, false if not available
+		bool getFrameIthl(int frame_nb, int& ithl);
+		int getNbPublishedFrames();
+
+	private:
+		static int _nbSteps(int ithl_start, int ithl_stop, int ithl_step);
+
+		bool				m_active;
+		Mutex				m_lock;		//- protects the staged range and the published steps
+		int					m_staged_start;
+		int					m_staged_stop;
+		int					m_staged_step;
+		int					m_start;
+		int					m_step;
+		int					m_nb_steps;
+		int					m_nb_published;
+	};
+
+} // namespace Xpad
+} // namespace lima
+
+#endif // XPADTHRESHOLDSCAN_H
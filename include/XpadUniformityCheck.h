@@ -0,0 +1,97 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef XPADUNIFORMITYCHECK_H
+#define XPADUNIFORMITYCHECK_H
+
+#include "lima/ThreadUtils.h"
+#include "lima/Debug.h"
+
+#include <string>
+#include <vector>
+
+namespace lima
+{
+namespace Xpad
+{
+	/*******************************************************************
+	* \class UniformityCheck
+	* \brief pass/fail of the chips on a short flat field acquisition
+	*
+	* For each chip of the raw image, the pixel mean counts per frame
+	* give the chip mean, the rms and the outliers (more than k robust
+	* sigma from the chip median, the robust sigma being at least the
+	* Poisson error). A chip fails if its outlier fraction, its relative
+	* rms in excess of the Poisson noise or the relative deviation of its
+	* mean from the median of the chips is over the limit.
+	*******************************************************************/
+	class UniformityCheck
+	{
+		DEB_CLASS_NAMESPC(DebModCamera, "UniformityCheck", "Xpad");
+
+	public:
+		struct ChipResult
+		{
+			int		module;		//- module number, from 1
+			int		chip;		//- from 1
+			double	mean;
+			double	rms;
+			int		nb_outliers;
+			bool	passed;
+		};
+
+		UniformityCheck();
+
+		//! flat field acquisition of nb_frames of exp_time_sec
+		void setAcquisition(int nb_frames, double exp_time_sec);
+		void getAcquisition(int& nb_frames, double& exp_time_sec);
+		void setLimits(double k_sigma, double max_outlier_fraction, double max_rms_ratio, double max_mean_deviation);
+
+		//! mean is the pixel mean counts per frame of the raw image, one module id (from 0) per module row
+		void check(const std::vector<float>& mean, int nb_frames, int width, int height, const std::vector<int>& module_ids);
+
+		//- readers (any thread)
+		//! false before the first check
+		bool getPassed(bool& passed);
+		void getChipResults(std::vector<ChipResult>& results);
+		//! one line per failed chip and a summary
+		std::string getReport();
+
+	private:
+		Mutex					m_lock;
+		int						m_nb_frames;
+		double					m_exp_time_sec;
+		double					m_k_sigma;
+		double					m_max_outlier_fraction;
+		double					m_max_rms_ratio;
+		double					m_max_mean_deviation;
+
+		//- last check
+		bool					m_checked;
+		bool					m_passed;
+		std::vector<ChipResult>	m_results;
+		std::string				m_report;
+	};
+
+} // namespace Xpad
+} // namespace lima
+
+#endif // XPADUNIFORMITYCHECK_H
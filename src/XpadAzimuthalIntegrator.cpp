@@ -0,0 +1,398 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "XpadAzimuthalIntegrator.h"
+#include "lima/Exceptions.h"
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace lima;
+using namespace lima::Xpad;
+
+//- the jobs get the image untyped
+static inline int _pixelType(const uint16_t*) {return 0;}
+static inline int _pixelType(const uint32_t*) {return 1;}
+static inline int _pixelType(const float*) {return 2;}
+
+//---------------------------
+//- Ctor
+//---------------------------
+AzimuthalIntegrator::AzimuthalIntegrator() :
+                    m_staged_active(false),
+                    m_nb_bins(1000),
+                    m_q_min(0),
+                    m_q_max(0),
+                    m_lut_valid(false),
+                    m_lut_pixel_size(0),
+                    m_active(false),
+                    m_image(0),
+                    m_pixel_type(UINT16),
+                    m_frame_nb(-1),
+                    m_nb_frames(0)
+{
+    m_geometry.distance = 100;
+    m_geometry.center_x = 0;
+    m_geometry.center_y = 0;
+    m_geometry.tilt = 0;
+    m_geometry.tilt_rotation = 0;
+    m_geometry.wavelength = 1;
+}
+
+//---------------------------
+//- Dtor
+//---------------------------
+AzimuthalIntegrator::~AzimuthalIntegrator()
+{
+    m_pool.wait();
+    for(size_t i = 0; i < m_jobs.size(); i++)
+        delete m_jobs[i];
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void AzimuthalIntegrator::setActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+
+    AutoMutex lock(m_lock);
+    m_staged_active = active;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+bool AzimuthalIntegrator::getActive()
+{
+    AutoMutex lock(m_lock);
+    return m_staged_active;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void AzimuthalIntegrator::setNbThreads(int nb_threads)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_pool.setNbThreads(nb_threads);
+    AutoMutex lock(m_lock);
+    m_lut_valid = false; //- the bins are shared again between the threads
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void AzimuthalIntegrator::setGeometry(const Geometry& geometry)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR4(geometry.distance, geometry.center_x, geometry.center_y, geometry.wavelength);
+
+    if(geometry.distance <= 0 || geometry.wavelength <= 0)
+        throw LIMA_HW_EXC(InvalidValue, "Distance and wavelength should be > 0");
+
+    AutoMutex lock(m_lock);
+    m_geometry = geometry;
+    m_lut_valid = false;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void AzimuthalIntegrator::getGeometry(Geometry& geometry)
+{
+    AutoMutex lock(m_lock);
+    geometry = m_geometry;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void AzimuthalIntegrator::setBins(int nb_bins, double q_min, double q_max)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR3(nb_bins, q_min, q_max);
+
+    if(nb_bins <= 0)
+        throw LIMA_HW_EXC(InvalidValue, "Number of bins should be > 0");
+
+    AutoMutex lock(m_lock);
+    m_nb_bins = nb_bins;
+    m_q_min = q_min;
+    m_q_max = q_max;
+    m_lut_valid = false;
+}
+
+//-----------------------------------------------------
+//		build the lookup matrix if needed
+//-----------------------------------------------------
+void AzimuthalIntegrator::prepare(const Size& image_size, double pixel_size)
+{
+    DEB_MEMBER_FUNCT();
+
+    AutoMutex lock(m_lock);
+    m_active = m_staged_active;
+    m_nb_frames = 0;
+    m_frame_nbs.clear();
+    m_patterns.clear();
+    if(!m_active)
+        return;
+
+    if(!m_lut_valid || image_size.getWidth() != m_lut_size.getWidth() ||
+       image_size.getHeight() != m_lut_size.getHeight() || pixel_size != m_lut_pixel_size)
+        _buildLut(image_size, pixel_size);
+
+    m_pattern.assign(m_nb_bins, 0);
+    m_frame_nbs.assign(AZIMUTHAL_HISTORY, -1);
+    m_patterns.assign((size_t)AZIMUTHAL_HISTORY * m_nb_bins, 0);
+}
+
+//-----------------------------------------------------
+//		pixel -> q bin matrix (CSR) and its split between the threads
+//-----------------------------------------------------
+void AzimuthalIntegrator::_buildLut(const Size& image_size, double pixel_size)
+{
+    DEB_MEMBER_FUNCT();
+
+    int width = image_size.getWidth();
+    int height = image_size.getHeight();
+    int nb_pixels = width * height;
+    const Geometry& g = m_geometry;
+
+    //- q of each pixel center
+    std::vector<double> pixel_q(nb_pixels);
+    double tilt = g.tilt * M_PI / 180.;
+    double ux = cos(g.tilt_rotation * M_PI / 180.);
+    double uy = sin(g.tilt_rotation * M_PI / 180.);
+    double q_factor = 4 * M_PI / g.wavelength;
+    double q_min = 1e300, q_max = 0;
+    for(int y = 0; y < height; y++)
+    {
+        for(int x = 0; x < width; x++)
+        {
+            //- pixel in the detector plane, rotated around the tilt axis (Rodrigues)
+            double px = (x + 0.5 - g.center_x) * pixel_size;
+            double py = (y + 0.5 - g.center_y) * pixel_size;
+            double along = ux * px + uy * py;
+            double X = px * cos(tilt) + ux * along * (1 - cos(tilt));
+            double Y = py * cos(tilt) + uy * along * (1 - cos(tilt));
+            double Z = g.distance + (ux * py - uy * px) * sin(tilt);
+            double two_theta = atan2(sqrt(X * X + Y * Y), Z);
+            double q = q_factor * sin(two_theta / 2);
+            pixel_q[y * width + x] = q;
+            q_min = std::min(q_min, q);
+            q_max = std::max(q_max, q);
+        }
+    }
+    if(m_q_max > m_q_min)
+    {
+        q_min = m_q_min;
+        q_max = m_q_max;
+    }
+
+    //- counting sort of the pixels by bin: columns stay ascending in each row
+    int nb_bins = m_nb_bins;
+    double bin_width = (q_max - q_min) / nb_bins;
+    std::vector<int> pixel_bin(nb_pixels, -1);
+    m_row_ptr.assign(nb_bins + 1, 0);
+    for(int i = 0; i < nb_pixels; i++)
+    {
+        int bin = (bin_width > 0) ? int(floor((pixel_q[i] - q_min) / bin_width)) : 0;
+        if(bin == nb_bins && pixel_q[i] <= q_max) //- q_max is in the last bin
+            bin--;
+        if(bin < 0 || bin >= nb_bins)
+            continue;
+        pixel_bin[i] = bin;
+        m_row_ptr[bin + 1]++;
+    }
+    for(int b = 0; b < nb_bins; b++)
+        m_row_ptr[b + 1] += m_row_ptr[b];
+    int nb_entries = m_row_ptr[nb_bins];
+    m_columns.resize(nb_entries);
+    m_weights.resize(nb_entries);
+    std::vector<int> fill(m_row_ptr.begin(), m_row_ptr.end() - 1);
+    for(int i = 0; i < nb_pixels; i++)
+        if(pixel_bin[i] >= 0)
+            m_columns[fill[pixel_bin[i]]++] = i;
+    for(int b = 0; b < nb_bins; b++)
+    {
+        int nb = m_row_ptr[b + 1] - m_row_ptr[b];
+        for(int k = m_row_ptr[b]; k < m_row_ptr[b + 1]; k++)
+            m_weights[k] = 1.f / nb;
+    }
+
+    m_q.resize(nb_bins);
+    for(int b = 0; b < nb_bins; b++)
+        m_q[b] = float(q_min + (b + 0.5) * bin_width);
+
+    //- same number of entries for each thread
+    for(size_t i = 0; i < m_jobs.size(); i++)
+        delete m_jobs[i];
+    m_jobs.clear();
+    int nb_threads = m_pool.getNbThreads();
+    int bin_begin = 0;
+    for(int t = 1; t <= nb_threads && bin_begin < nb_bins; t++)
+    {
+        long target = (long)nb_entries * t / nb_threads;
+        int bin_end = bin_begin + 1;
+        while(bin_end < nb_bins && m_row_ptr[bin_end] < target)
+            bin_end++;
+        if(t == nb_threads)
+            bin_end = nb_bins;
+        m_jobs.push_back(new BinsJob(*this, bin_begin, bin_end));
+        bin_begin = bin_end;
+    }
+
+    m_lut_size = image_size;
+    m_lut_pixel_size = pixel_size;
+    m_lut_valid = true;
+    DEB_TRACE() << "Azimuthal lookup matrix: " << nb_entries << " pixels in " << nb_bins
+                << " bins, q = [" << q_min << ", " << q_max << "]";
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void AzimuthalIntegrator::startFrame(int frame_nb)
+{
+    m_frame_nb = frame_nb;
+}
+
+//-----------------------------------------------------
+//		pattern = lookup matrix x image, bins shared by the threads
+//-----------------------------------------------------
+template<typename T>
+void AzimuthalIntegrator::process(const T* image)
+{
+    m_image = image;
+    m_pixel_type = PixelType(_pixelType(image));
+    for(size_t i = 0; i < m_jobs.size(); i++)
+        m_pool.post(m_jobs[i]);
+    m_pool.wait();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void AzimuthalIntegrator::BinsJob::run()
+{
+    AzimuthalIntegrator& integrator = m_integrator;
+    switch(integrator.m_pixel_type)
+    {
+        case UINT16:
+            integrator._integrate((const uint16_t*)integrator.m_image, m_bin_begin, m_bin_end);
+            break;
+        case UINT32:
+            integrator._integrate((const uint32_t*)integrator.m_image, m_bin_begin, m_bin_end);
+            break;
+        case FLOAT:
+            integrator._integrate((const float*)integrator.m_image, m_bin_begin, m_bin_end);
+            break;
+    }
+}
+
+//-----------------------------------------------------
+//		sparse matrix x vector on the rows [bin_begin, bin_end[
+//-----------------------------------------------------
+template<typename T>
+void AzimuthalIntegrator::_integrate(const T* image, int bin_begin, int bin_end)
+{
+    const int* row_ptr = &m_row_ptr[0];
+    const int* columns = m_columns.empty() ? 0 : &m_columns[0];
+    const float* weights = m_weights.empty() ? 0 : &m_weights[0];
+
+    for(int b = bin_begin; b < bin_end; b++)
+    {
+        int k = row_ptr[b];
+        int end = row_ptr[b + 1];
+        float sum = 0;
+#ifdef __SSE2__
+        //- gather 4 pixels, multiply-add 4 lanes
+        __m128 acc = _mm_setzero_ps();
+        for(; k + 4 <= end; k += 4)
+        {
+            __m128 pixels = _mm_setr_ps(float(image[columns[k]]), float(image[columns[k + 1]]),
+                                        float(image[columns[k + 2]]), float(image[columns[k + 3]]));
+            acc = _mm_add_ps(acc, _mm_mul_ps(pixels, _mm_loadu_ps(weights + k)));
+        }
+        float lanes[4];
+        _mm_storeu_ps(lanes, acc);
+        sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+        for(; k < end; k++)
+            sum += float(image[columns[k]]) * weights[k];
+        m_pattern[b] = sum;
+    }
+}
+
+//-----------------------------------------------------
+//		keep the pattern of the frame
+//-----------------------------------------------------
+void AzimuthalIntegrator::endFrame()
+{
+    AutoMutex lock(m_lock);
+    int slot = m_frame_nb % AZIMUTHAL_HISTORY;
+    m_frame_nbs[slot] = m_frame_nb;
+    std::copy(m_pattern.begin(), m_pattern.end(), m_patterns.begin() + (size_t)slot * m_pattern.size());
+    m_nb_frames++;
+}
+
+//-----------------------------------------------------
+//		q of the bin centers
+//-----------------------------------------------------
+void AzimuthalIntegrator::getQ(std::vector<float>& q)
+{
+    AutoMutex lock(m_lock);
+    q = m_q;
+}
+
+//-----------------------------------------------------
+//		copy the pattern of a frame
+//-----------------------------------------------------
+bool AzimuthalIntegrator::getPattern(int frame_nb, std::vector<float>& pattern)
+{
+    AutoMutex lock(m_lock);
+    if(frame_nb < 0 || m_frame_nbs.empty())
+        return false;
+    int slot = frame_nb % AZIMUTHAL_HISTORY;
+    if(m_frame_nbs[slot] != frame_nb)
+        return false;
+    size_t nb_bins = m_pattern.size();
+    pattern.assign(m_patterns.begin() + slot * nb_bins, m_patterns.begin() + (slot + 1) * nb_bins);
+    return true;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+int AzimuthalIntegrator::getNbFrames()
+{
+    AutoMutex lock(m_lock);
+    return m_nb_frames;
+}
+
+//- pixel types of the frame pass
+template void AzimuthalIntegrator::process<uint16_t>(const uint16_t*);
+template void AzimuthalIntegrator::process<uint32_t>(const uint32_t*);
+template void AzimuthalIntegrator::process<float>(const float*);
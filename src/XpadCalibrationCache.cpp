@@ -0,0 +1,603 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "XpadCalibrationCache.h"
+#include "lima/Exceptions.h"
+#include <dirent.h>
+#include <sys/stat.h>
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+using namespace lima;
+using namespace lima::Xpad;
+
+//---------------------------
+//- Ctor
+//---------------------------
+CalibrationCache::CalibrationCache()
+{
+    m_nb_modules = 0;
+    m_nb_chips = 0;
+}
+
+//-----------------------------------------------------
+//		size of the chips state
+//-----------------------------------------------------
+void CalibrationCache::setDetector(int nb_modules, int nb_chips)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(nb_modules, nb_chips);
+
+    AutoMutex lock(m_lock);
+    m_nb_modules = nb_modules;
+    m_nb_chips = nb_chips;
+    m_loaded_slots.assign(nb_modules, -1);
+    m_config_g.assign(nb_modules * nb_chips * CONFIG_G_NB_REGISTERS, 0);
+    m_config_g_known.assign(nb_modules * nb_chips, 0);
+    m_dacl_checksums.assign(nb_modules * nb_chips, 0);
+    m_dacl_known.assign(nb_modules * nb_chips, 0);
+}
+
+//-----------------------------------------------------
+//		FNV-1a on the DACL values of a chip
+//-----------------------------------------------------
+uint32_t CalibrationCache::checksum(const uint16_t* dacl)
+{
+    uint32_t hash = 2166136261U;
+    for(int i = 0; i < CHIP_NB_ROW * CHIP_NB_COLUMN; i++)
+    {
+        hash = (hash ^ (dacl[i] & 0xFF)) * 16777619U;
+        hash = (hash ^ (dacl[i] >> 8)) * 16777619U;
+    }
+    return hash;
+}
+
+//-----------------------------------------------------
+//		the exported files of a calibration directory, not older than its other (xpix) files
+//-----------------------------------------------------
+void CalibrationCache::_findFiles(const std::string& path, std::string& dacl_path, std::string& config_g_path)
+{
+    DEB_STATIC_FUNCT();
+
+    std::string dacl_name = std::string(CALIBRATION_EXPORT_NAME) + ".cfl";
+    std::string config_g_name = std::string(CALIBRATION_EXPORT_NAME) + ".cfg";
+    DIR* dir = opendir(path.c_str());
+    if(!dir)
+        THROW_HW_ERROR(Error) << "Unable to open the calibration directory: " << path;
+    dacl_path.clear();
+    config_g_path.clear();
+    time_t other_mtime = 0;
+    struct dirent* entry;
+    while((entry = readdir(dir)) != 0)
+    {
+        std::string name = entry->d_name;
+        struct stat status;
+        if(name == dacl_name)
+            dacl_path = path + "/" + name;
+        else if(name == config_g_name)
+            config_g_path = path + "/" + name;
+        else if(name == dacl_name + ".tmp" || name == config_g_name + ".tmp")
+            continue;
+        else if(stat((path + "/" + name).c_str(), &status) == 0 && S_ISREG(status.st_mode))
+            other_mtime = std::max(other_mtime, status.st_mtime);
+    }
+    closedir(dir);
+    if(dacl_path.empty() || config_g_path.empty())
+        THROW_HW_ERROR(Error) << "No exported calibration (" << CALIBRATION_EXPORT_NAME << ".cfl/.cfg) in the calibration directory: " << path;
+    //- the xpix files were written again (new calibration) after the export
+    if(other_mtime > std::min(_mtime(dacl_path), _mtime(config_g_path)))
+        THROW_HW_ERROR(Error) << "The exported calibration is older than the files of the calibration directory: " << path;
+}
+
+//-----------------------------------------------------
+//		DACL and config G files, the temporary files are renamed once complete
+//-----------------------------------------------------
+void CalibrationCache::write(const std::string& path, const Calibration& calibration)
+{
+    DEB_STATIC_FUNCT();
+    DEB_PARAM() << DEB_VAR1(path);
+
+    std::string dacl_path = path + "/" + CALIBRATION_EXPORT_NAME + ".cfl";
+    std::string config_g_path = path + "/" + CALIBRATION_EXPORT_NAME + ".cfg";
+    {
+        std::ofstream dacl_file((dacl_path + ".tmp").c_str(), std::ios::out | std::ios::trunc);
+        for(int module = 0; module < calibration.nb_modules; module++)
+            for(int chip = 0; chip < calibration.nb_chips; chip++)
+                for(int row = 0; row < CHIP_NB_ROW; row++)
+                {
+                    dacl_file << module + 1 << " " << chip + 1 << " " << row;
+                    const uint16_t* dacl = calibration.getDaclRow(module, chip, row);
+                    for(int column = 0; column < CHIP_NB_COLUMN; column++)
+                        dacl_file << " " << dacl[column];
+                    dacl_file << "\n";
+                }
+        if(!dacl_file)
+            THROW_HW_ERROR(Error) << "Unable to write the file: " << dacl_path << ".tmp";
+    }
+    {
+        std::ofstream config_g_file((config_g_path + ".tmp").c_str(), std::ios::out | std::ios::trunc);
+        for(int module = 0; module < calibration.nb_modules; module++)
+            for(int chip = 0; chip < calibration.nb_chips; chip++)
+            {
+                config_g_file << module + 1 << " " << chip + 1;
+                for(int reg = 0; reg < CONFIG_G_NB_REGISTERS; reg++)
+                    config_g_file << " " << calibration.getConfigG(module, chip, reg);
+                config_g_file << "\n";
+            }
+        if(!config_g_file)
+            THROW_HW_ERROR(Error) << "Unable to write the file: " << config_g_path << ".tmp";
+    }
+    if(rename((dacl_path + ".tmp").c_str(), dacl_path.c_str()) != 0 ||
+       rename((config_g_path + ".tmp").c_str(), config_g_path.c_str()) != 0)
+        THROW_HW_ERROR(Error) << "Unable to rename the exported calibration files in: " << path << ": " << strerror(errno);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+time_t CalibrationCache::_mtime(const std::string& path)
+{
+    DEB_STATIC_FUNCT();
+
+    struct stat status;
+    if(stat(path.c_str(), &status) != 0)
+        THROW_HW_ERROR(Error) << "Unable to stat the file: " << path;
+    return status.st_mtime;
+}
+
+//-----------------------------------------------------
+//		read the DACL and config G files
+//-----------------------------------------------------
+void CalibrationCache::_parse(const std::string& dacl_path, const std::string& config_g_path, Calibration& calibration)
+{
+    DEB_STATIC_FUNCT();
+
+    int nb_modules = calibration.nb_modules;
+    int nb_chips = calibration.nb_chips;
+    calibration.dacl.assign((long)nb_modules * nb_chips * CHIP_NB_ROW * CHIP_NB_COLUMN, 0);
+    calibration.config_g.assign(nb_modules * nb_chips * CONFIG_G_NB_REGISTERS, 0);
+
+    std::ifstream dacl_file(dacl_path.c_str());
+    if(!dacl_file)
+        THROW_HW_ERROR(Error) << "Unable to open the file: " << dacl_path;
+    std::vector<char> rows(nb_modules * nb_chips * CHIP_NB_ROW, 0);
+    std::string line;
+    int line_nb = 0;
+    while(std::getline(dacl_file, line))
+    {
+        line_nb++;
+        std::istringstream values(line);
+        int module, chip, row;
+        if(!(values >> module >> chip >> row))
+            continue; //- empty line
+        if(module < 1 || module > nb_modules || chip < 1 || chip > nb_chips || row < 0 || row >= CHIP_NB_ROW)
+            THROW_HW_ERROR(Error) << dacl_path << ":" << line_nb << ": module/chip/row out of the detector";
+        uint16_t* dacl = const_cast<uint16_t*>(calibration.getDaclRow(module - 1, chip - 1, row));
+        for(int column = 0; column < CHIP_NB_COLUMN; column++)
+        {
+            unsigned int value;
+            if(!(values >> value))
+                THROW_HW_ERROR(Error) << dacl_path << ":" << line_nb << ": expected " << CHIP_NB_COLUMN << " values";
+            dacl[column] = uint16_t(value);
+        }
+        rows[((module - 1) * nb_chips + chip - 1) * CHIP_NB_ROW + row] = 1;
+    }
+    for(size_t i = 0; i < rows.size(); i++)
+        if(!rows[i])
+            THROW_HW_ERROR(Error) << dacl_path << ": missing rows (module " << i / (nb_chips * CHIP_NB_ROW) + 1 << ")";
+
+    std::ifstream config_g_file(config_g_path.c_str());
+    if(!config_g_file)
+        THROW_HW_ERROR(Error) << "Unable to open the file: " << config_g_path;
+    std::vector<char> chips(nb_modules * nb_chips, 0);
+    line_nb = 0;
+    while(std::getline(config_g_file, line))
+    {
+        line_nb++;
+        std::istringstream values(line);
+        int module, chip;
+        if(!(values >> module >> chip))
+            continue;
+        if(module < 1 || module > nb_modules || chip < 1 || chip > nb_chips)
+            THROW_HW_ERROR(Error) << config_g_path << ":" << line_nb << ": module/chip out of the detector";
+        int first = ((module - 1) * nb_chips + chip - 1) * CONFIG_G_NB_REGISTERS;
+        for(int reg = 0; reg < CONFIG_G_NB_REGISTERS; reg++)
+        {
+            unsigned int value;
+            if(!(values >> value))
+                THROW_HW_ERROR(Error) << config_g_path << ":" << line_nb << ": expected " << CONFIG_G_NB_REGISTERS << " values";
+            calibration.config_g[first + reg] = uint16_t(value);
+        }
+        chips[(module - 1) * nb_chips + chip - 1] = 1;
+    }
+    for(size_t i = 0; i < chips.size(); i++)
+        if(!chips[i])
+            THROW_HW_ERROR(Error) << config_g_path << ": missing chips (module " << i / nb_chips + 1 << ")";
+
+    calibration.checksums.resize(nb_modules * nb_chips);
+    for(int module = 0; module < nb_modules; module++)
+        for(int chip = 0; chip < nb_chips; chip++)
+            calibration.checksums[module * nb_chips + chip] = checksum(calibration.getDaclRow(module, chip, 0));
+}
+
+//-----------------------------------------------------
+//		parse the calibration if not cached or changed
+//-----------------------------------------------------
+CalibrationCache::Calibration CalibrationCache::get(const std::string& path, int nb_modules, int nb_chips)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR3(path, nb_modules, nb_chips);
+
+    std::string dacl_path, config_g_path;
+    _findFiles(path, dacl_path, config_g_path);
+    time_t mtime = std::max(_mtime(dacl_path), _mtime(config_g_path));
+
+    AutoMutex lock(m_lock);
+    std::map<std::string, Calibration>::iterator it = m_calibrations.find(path);
+    if(it != m_calibrations.end() && it->second.mtime == mtime &&
+       it->second.nb_modules == nb_modules && it->second.nb_chips == nb_chips)
+    {
+        DEB_TRACE() << "Calibration " << path << " found in the cache";
+        return it->second;
+    }
+
+    Calibration calibration;
+    calibration.path = path;
+    calibration.mtime = mtime;
+    calibration.nb_modules = nb_modules;
+    calibration.nb_chips = nb_chips;
+    _parse(dacl_path, config_g_path, calibration);
+    Calibration& cached = m_calibrations[path];
+    cached.path = path;
+    cached.mtime = mtime;
+    cached.nb_modules = nb_modules;
+    cached.nb_chips = nb_chips;
+    cached.dacl.swap(calibration.dacl);
+    cached.config_g.swap(calibration.config_g);
+    cached.checksums.swap(calibration.checksums);
+    DEB_TRACE() << "Calibration " << path << " parsed";
+    return cached;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void CalibrationCache::clear()
+{
+    AutoMutex lock(m_lock);
+    m_calibrations.clear();
+}
+
+//-----------------------------------------------------
+//		the slot holds known values for the module, in the calibration geometry
+//-----------------------------------------------------
+bool CalibrationCache::_isSaved(const Slot& slot, const Calibration& calibration, int module)
+{
+    return module < int(slot.module_saved.size()) && slot.module_saved[module] &&
+           slot.content.nb_modules == calibration.nb_modules && slot.content.nb_chips == calibration.nb_chips;
+}
+
+//-----------------------------------------------------
+//		same DACL row in the detector RAM
+//-----------------------------------------------------
+bool CalibrationCache::isRowSaved(const Calibration& calibration, int calib_id, int module, int chip, int row)
+{
+    AutoMutex lock(m_lock);
+    std::map<int, Slot>::iterator it = m_slots.find(calib_id);
+    if(it == m_slots.end() || !_isSaved(it->second, calibration, module))
+        return false;
+    return memcmp(it->second.content.getDaclRow(module, chip, row), calibration.getDaclRow(module, chip, row),
+                  CHIP_NB_COLUMN * sizeof(uint16_t)) == 0;
+}
+
+//-----------------------------------------------------
+//		same register value for all the chips of the module
+//-----------------------------------------------------
+bool CalibrationCache::isRegisterSaved(const Calibration& calibration, int calib_id, int module, int reg)
+{
+    AutoMutex lock(m_lock);
+    std::map<int, Slot>::iterator it = m_slots.find(calib_id);
+    if(it == m_slots.end() || !_isSaved(it->second, calibration, module))
+        return false;
+    for(int chip = 0; chip < calibration.nb_chips; chip++)
+        if(it->second.content.getConfigG(module, chip, reg) != calibration.getConfigG(module, chip, reg))
+            return false;
+    return true;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+bool CalibrationCache::isModuleSaved(const Calibration& calibration, int calib_id, int module)
+{
+    AutoMutex lock(m_lock);
+    std::map<int, Slot>::iterator it = m_slots.find(calib_id);
+    if(it == m_slots.end() || !_isSaved(it->second, calibration, module))
+        return false;
+    return it->second.module_paths[module] == calibration.path && it->second.module_mtimes[module] == calibration.mtime;
+}
+
+//-----------------------------------------------------
+//		copy the module part of the calibration in the slot
+//-----------------------------------------------------
+void CalibrationCache::setModuleSaved(const Calibration& calibration, int calib_id, int module)
+{
+    AutoMutex lock(m_lock);
+    Slot& slot = m_slots[calib_id];
+    Calibration& content = slot.content;
+    if(content.nb_modules != calibration.nb_modules || content.nb_chips != calibration.nb_chips)
+    {
+        content.nb_modules = calibration.nb_modules;
+        content.nb_chips = calibration.nb_chips;
+        content.dacl.assign(calibration.dacl.size(), 0);
+        content.config_g.assign(calibration.config_g.size(), 0);
+        content.checksums.assign(calibration.checksums.size(), 0);
+        slot.module_paths.assign(calibration.nb_modules, std::string());
+        slot.module_mtimes.assign(calibration.nb_modules, 0);
+        slot.module_saved.assign(calibration.nb_modules, 0);
+    }
+    long dacl_size = (long)calibration.nb_chips * CHIP_NB_ROW * CHIP_NB_COLUMN;
+    std::copy(calibration.dacl.begin() + module * dacl_size, calibration.dacl.begin() + (module + 1) * dacl_size,
+              content.dacl.begin() + module * dacl_size);
+    int config_g_size = calibration.nb_chips * CONFIG_G_NB_REGISTERS;
+    std::copy(calibration.config_g.begin() + module * config_g_size, calibration.config_g.begin() + (module + 1) * config_g_size,
+              content.config_g.begin() + module * config_g_size);
+    std::copy(calibration.checksums.begin() + module * calibration.nb_chips,
+              calibration.checksums.begin() + (module + 1) * calibration.nb_chips,
+              content.checksums.begin() + module * calibration.nb_chips);
+    slot.module_paths[module] = calibration.path;
+    slot.module_mtimes[module] = calibration.mtime;
+    slot.module_saved[module] = 1;
+}
+
+//-----------------------------------------------------
+//		the chips loaded from this calib id no more hold its content
+//-----------------------------------------------------
+void CalibrationCache::invalidateSlot(int calib_id, int module)
+{
+    AutoMutex lock(m_lock);
+    std::map<int, Slot>::iterator it = m_slots.find(calib_id);
+    if(it != m_slots.end())
+    {
+        std::vector<char>& module_saved = it->second.module_saved;
+        for(int i = 0; i < int(module_saved.size()); i++)
+            if(module < 0 || i == module)
+                module_saved[i] = 0;
+    }
+    for(int i = 0; i < int(m_loaded_slots.size()); i++)
+        if((module < 0 || i == module) && m_loaded_slots[i] == calib_id)
+            m_loaded_slots[i] = -1;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+int CalibrationCache::getLoadedSlot(int module)
+{
+    AutoMutex lock(m_lock);
+    return module < int(m_loaded_slots.size()) ? m_loaded_slots[module] : -1;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void CalibrationCache::setModuleLoaded(int calib_id, int module)
+{
+    AutoMutex lock(m_lock);
+    if(module < 0 || module >= m_nb_modules)
+        return;
+    m_loaded_slots[module] = calib_id;
+
+    //- the DACL and config G of the chips are the saved ones, if known
+    std::map<int, Slot>::iterator it = m_slots.find(calib_id);
+    bool known = it != m_slots.end() && module < int(it->second.module_saved.size()) &&
+                 it->second.module_saved[module] && it->second.content.nb_chips == m_nb_chips;
+    for(int chip = 0; chip < m_nb_chips; chip++)
+    {
+        m_config_g_known[module * m_nb_chips + chip] = known;
+        m_dacl_known[module * m_nb_chips + chip] = known;
+        if(!known)
+            continue;
+        for(int reg = 0; reg < CONFIG_G_NB_REGISTERS; reg++)
+            m_config_g[(module * m_nb_chips + chip) * CONFIG_G_NB_REGISTERS + reg] =
+                it->second.content.getConfigG(module, chip, reg);
+        m_dacl_checksums[module * m_nb_chips + chip] = it->second.content.checksums[module * m_nb_chips + chip];
+    }
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void CalibrationCache::invalidateChips(int module)
+{
+    AutoMutex lock(m_lock);
+    for(int i = 0; i < int(m_loaded_slots.size()); i++)
+        if(module < 0 || i == module)
+            m_loaded_slots[i] = -1;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+bool CalibrationCache::getConfigG(int module, int chip, long* values)
+{
+    AutoMutex lock(m_lock);
+    if(module < 0 || module >= m_nb_modules || chip < 0 || chip >= m_nb_chips ||
+       !m_config_g_known[module * m_nb_chips + chip])
+        return false;
+    const long* config_g = &m_config_g[(module * m_nb_chips + chip) * CONFIG_G_NB_REGISTERS];
+    std::copy(config_g, config_g + CONFIG_G_NB_REGISTERS, values);
+    return true;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void CalibrationCache::setConfigG(int module, int chip, const long* values)
+{
+    AutoMutex lock(m_lock);
+    if(module < 0 || module >= m_nb_modules || chip < 0 || chip >= m_nb_chips)
+        return;
+    std::copy(values, values + CONFIG_G_NB_REGISTERS, &m_config_g[(module * m_nb_chips + chip) * CONFIG_G_NB_REGISTERS]);
+    m_config_g_known[module * m_nb_chips + chip] = 1;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void CalibrationCache::invalidateConfigG(int module, int chip)
+{
+    AutoMutex lock(m_lock);
+    for(int i = 0; i < m_nb_modules; i++)
+        for(int j = 0; j < m_nb_chips; j++)
+            if((module < 0 || i == module) && (chip < 0 || j == chip))
+                m_config_g_known[i * m_nb_chips + j] = 0;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void CalibrationCache::setDaclChecksum(int module, int chip, uint32_t checksum)
+{
+    AutoMutex lock(m_lock);
+    if(module < 0 || module >= m_nb_modules || chip < 0 || chip >= m_nb_chips)
+        return;
+    m_dacl_checksums[module * m_nb_chips + chip] = checksum;
+    m_dacl_known[module * m_nb_chips + chip] = 1;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+bool CalibrationCache::getDaclChecksum(int module, int chip, uint32_t& checksum)
+{
+    AutoMutex lock(m_lock);
+    if(module < 0 || module >= m_nb_modules || chip < 0 || chip >= m_nb_chips ||
+       !m_dacl_known[module * m_nb_chips + chip])
+        return false;
+    checksum = m_dacl_checksums[module * m_nb_chips + chip];
+    return true;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void CalibrationCache::invalidateDacl(int module)
+{
+    AutoMutex lock(m_lock);
+    for(int i = 0; i < m_nb_modules; i++)
+        if(module < 0 || i == module)
+            for(int chip = 0; chip < m_nb_chips; chip++)
+                m_dacl_known[i * m_nb_chips + chip] = 0;
+}
+
+//-----------------------------------------------------
+//		one checksum and 11 registers per chip, whatever the DACL size
+//-----------------------------------------------------
+bool CalibrationCache::isLoaded(const Calibration& calibration, unsigned int modules_mask)
+{
+    AutoMutex lock(m_lock);
+    if(calibration.nb_chips != m_nb_chips || calibration.nb_modules > m_nb_modules)
+        return false;
+    for(int module = 0; module < calibration.nb_modules; module++)
+    {
+        if(!(modules_mask & (1U << module)))
+            continue;
+        for(int chip = 0; chip < m_nb_chips; chip++)
+        {
+            int index = module * m_nb_chips + chip;
+            if(!m_dacl_known[index] || !m_config_g_known[index] ||
+               m_dacl_checksums[index] != calibration.checksums[index])
+                return false;
+            for(int reg = 0; reg < CONFIG_G_NB_REGISTERS; reg++)
+                if(m_config_g[index * CONFIG_G_NB_REGISTERS + reg] != calibration.getConfigG(module, chip, reg))
+                    return false;
+        }
+    }
+    return true;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void CalibrationCache::invalidateAll()
+{
+    AutoMutex lock(m_lock);
+    for(std::map<int, Slot>::iterator it = m_slots.begin(); it != m_slots.end(); ++it)
+        it->second.module_saved.assign(it->second.module_saved.size(), 0);
+    m_loaded_slots.assign(m_loaded_slots.size(), -1);
+    m_config_g_known.assign(m_config_g_known.size(), 0);
+    m_dacl_known.assign(m_dacl_known.size(), 0);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void CalibrationCache::assignSlot(int calib_id, const std::string& path)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(calib_id, path);
+
+    AutoMutex lock(m_lock);
+    if(!path.empty())
+        for(std::map<int, Slot>::iterator it = m_slots.begin(); it != m_slots.end(); ++it)
+            if(it->first != calib_id && it->second.assigned_path == path)
+                THROW_HW_ERROR(InvalidValue) << "Calibration " << path << " already assigned to calib " << it->first;
+    m_slots[calib_id].assigned_path = path;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+std::string CalibrationCache::getAssignedPath(int calib_id)
+{
+    AutoMutex lock(m_lock);
+    std::map<int, Slot>::iterator it = m_slots.find(calib_id);
+    return it != m_slots.end() ? it->second.assigned_path : std::string();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+int CalibrationCache::findSlot(const std::string& path)
+{
+    AutoMutex lock(m_lock);
+    for(std::map<int, Slot>::iterator it = m_slots.begin(); it != m_slots.end(); ++it)
+        if(!path.empty() && it->second.assigned_path == path)
+            return it->first;
+    return -1;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void CalibrationCache::getAssignedSlots(std::vector<int>& calib_ids)
+{
+    AutoMutex lock(m_lock);
+    calib_ids.clear();
+    for(std::map<int, Slot>::iterator it = m_slots.begin(); it != m_slots.end(); ++it)
+        if(!it->second.assigned_path.empty())
+            calib_ids.push_back(it->first);
+}
@@ -24,10 +24,16 @@
 #include <iostream>
 #include <string>
 #include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <exception>
 
 using namespace lima;
 using namespace lima::Xpad;
 
+//- number of rows corrected then written to lima while they are in cache
+static const int PROCESSING_BAND_NB_ROW = 16;
+
 //---------------------------
 //- Ctor
 //---------------------------
@@ -41,9 +47,14 @@ Camera::Camera(std::string xpad_model) :
     //- default values:
     m_modules_mask      = 0x00;
     m_chip_number       = 7;
+    m_scan_publish_pool.setNbThreads(1);
+    m_dacl              = 0;
     m_pixel_depth       = B2; //- 16 bits
     m_imxpad_format     = 0; //- 16 bits
     m_nb_frames         = 1;
+    m_nb_hw_frames      = 1;
+    m_compression_only  = false;
+    m_azimuthal_only    = false;
     m_live_mode			= false;
 
     m_status            = Camera::Ready;
@@ -65,6 +76,30 @@ Camera::Camera(std::string xpad_model) :
 
     m_doublepixel_corr				= false;
     m_norm_factor					= 2.5;
+    m_rotation						= Rotation_0;
+    m_roi_counters_only				= false;
+    m_calibration_cache_active		= false;
+    m_calibration_upload_nb_rows	= 0;
+    m_calibration_upload_nb_registers = 0;
+    m_calibration_upload_elapsed_sec = 0;
+    m_dacl_upload_calib_id			= 0;
+    m_dacl_upload_modules_mask		= 0;
+    m_dacl_correction_mask			= 0;
+    m_calibration_modules_mask		= 0;
+    m_uniformity_check_after_upload	= false;
+    m_calibration_cancel			= false;
+    m_calibration_running			= false;
+    m_calibration_nb_modules_done	= 0;
+    m_calibration_nb_modules		= 0;
+    m_calibration_elapsed_sec		= 0;
+    m_dacl_upload_nb_rows_done		= 0;
+    m_dacl_upload_nb_rows			= 0;
+    m_dacl_upload_nb_calls			= 0;
+    m_dacl_upload_elapsed_sec		= 0;
+    m_acq_thread					= 0;
+    m_acq_running					= false;
+    m_hdr_exposure_ratio			= 1;
+    m_hdr_short_exp_time_usec		= 0;
 
     if		(xpad_model == "BACKPLANE") 	m_xpad_model = BACKPLANE;
     else if	(xpad_model == "HUB")	        m_xpad_model = HUB;
@@ -95,6 +130,7 @@ Camera::Camera(std::string xpad_model) :
             if (m_module_number != 0)
             {
                 DEB_TRACE() << "--> Number of Modules	= " << m_module_number ;
+                m_calibration_cache.setDetector(getNbModuleIds(), m_chip_number);
             }
             else
             {
@@ -129,8 +165,12 @@ Camera::Camera(std::string xpad_model) :
         DEB_TRACE() << "--> Image height	(pixels) = " << std::dec << m_image_size.getHeight() ;
         go(2000);
 
-        //- allocate the dacl array: not used yet
-        //m_dacl = new unsigned short[m_image_size.getWidth() * m_image_size.getHeight()];
+        //- the acquisitions run on their own thread, apart from the control messages of the task
+        m_acq_thread = new AcqThread(*this);
+        m_acq_thread->start();
+
+        //- allocate the dacl array (raw image geometry) for the readback
+        m_dacl = new unsigned short[m_image_size.getWidth() * m_image_size.getHeight()];
     }
 }
 
@@ -141,11 +181,21 @@ Camera::~Camera()
 {
     DEB_DESTRUCTOR();
 
+    if(m_acq_thread)
+    {
+        //- a running (live) acquisition is stopped first, else the join never returns
+        m_stop_asked = true;
+        xpci_modAbortExposure();
+        postAcqCommand(ACQ_QUIT);
+        m_acq_thread->join();
+        delete m_acq_thread;
+    }
+
     //- close the xpix driver
     xpci_close(0);
     DEB_TRACE() << "XPCI Lib closed";
 
-    //delete [] m_dacl;
+    delete [] m_dacl;
 }
 
 //---------------------------
@@ -155,16 +205,108 @@ void Camera::prepare()
 {
     DEB_MEMBER_FUNCT();
 
+    //- a stopped acquisition may still be leaving the acquisition thread with the buffers below
+    AutoMutex hw_lock(m_hw_lock);
+
     m_stop_asked = false;
     m_image_array = 0;
     m_nb_live_frames = 0;
     m_current_nb_frames = -1;
+
+    //- refresh m_image_size (corrected size, before flip/rotation) and the lima buffer mapping
+    Size image_size;
+    getImageSize(image_size);
+    m_image_transform.setup(m_image_size, m_flip, m_rotation);
+
+    //- accumulation (HDR): N (2) hardware frames (16 bits) per lima frame (32 bits)
+    int nb_accumulated = getNbHwFramesPerFrame();
+    m_nb_hw_frames = ((m_nb_frames==0) ? 1 : m_nb_frames) * nb_accumulated;
+    //- threshold scan: one sequence of the accumulated frames per ITHL step
+    int nb_hw_frames_per_sequence = m_nb_hw_frames;
+    if(m_threshold_scan.isActive())
+    {
+        if(m_live_mode)
+            throw LIMA_HW_EXC(Error, "Threshold scan is not available in live mode");
+        if(m_hdr_merger.isActive())
+            throw LIMA_HW_EXC(Error, "Threshold scan is not available with HDR");
+        m_threshold_scan.prepare();
+        if(m_nb_frames != m_threshold_scan.getNbPreparedSteps())
+            THROW_HW_ERROR(InvalidValue) << "Threshold scan: the number of frames should be the number of ITHL steps ("
+                                         << m_threshold_scan.getNbPreparedSteps() << ")";
+        nb_hw_frames_per_sequence = nb_accumulated;
+        //- the fit sees the raw hardware frames
+        m_scurve_fitter.prepare(CHIP_NB_COLUMN * m_chip_number, CHIP_NB_ROW * m_module_number);
+    }
+    if(m_frame_accumulator.isActive() || m_hdr_merger.isActive())
+    {
+        if(m_geom_corr)
+            throw LIMA_HW_EXC(Error, "Accumulation and HDR are not available with the geometrical correction");
+        //- the sum is made on the raw image (before the double pixel correction)
+        int raw_nb_pixels = m_image_size.getWidth() * m_image_size.getHeight();
+        if(m_doublepixel_corr && m_xpad_model == IMXPAD_S140)
+            raw_nb_pixels = (m_image_size.getWidth()-18) * (m_image_size.getHeight()-3);
+        else if(m_doublepixel_corr && m_xpad_model == IMXPAD_S70)
+            raw_nb_pixels = (m_image_size.getWidth()-18) * m_image_size.getHeight();
+        if(m_hdr_merger.isActive())
+        {
+            //- one sequence per hardware frame, alternating the programmed short and long exposures
+            if(m_acquisition_type == Camera::ASYNC && !m_live_mode)
+                throw LIMA_HW_EXC(Error, "HDR is not available in ASYNC mode");
+            m_hdr_short_exp_time_usec = (unsigned int)(m_exp_time_usec / m_hdr_exposure_ratio + 0.5);
+            if(m_hdr_short_exp_time_usec == 0)
+                THROW_HW_ERROR(InvalidValue) << "HDR: the short exposure (" << m_exp_time_usec << " us / " << m_hdr_exposure_ratio
+                                             << ") is below 1 us";
+            //- the merge scales the short exposure by the programmed ratio (rounded to the us)
+            m_hdr_merger.setExposureRatio(double(m_exp_time_usec) / m_hdr_short_exp_time_usec);
+            m_hdr_merger.prepare(raw_nb_pixels);
+        }
+        else
+            m_frame_accumulator.prepare(raw_nb_pixels);
+    }
+
+    //- the rate correction sees the counts of the whole accumulated exposure (HDR: the long exposure)
+    //- rows inserted between the modules by the double pixel correction (S140), unknown with the geometrical correction
+    int module_gap_rows = 0;
+    if(m_geom_corr)
+        module_gap_rows = -1;
+    else if(m_doublepixel_corr && m_xpad_model == IMXPAD_S140)
+        module_gap_rows = S140_CORRECTED_NB_ROW - I1_ROW;
+    m_pixel_correction.prepare(m_image_size, m_exp_time_usec * m_frame_accumulator.getNbFrames(), m_module_number, module_gap_rows);
+    //- the veto decides with the statistics of each frame
+    m_frame_veto.prepare();
+    m_frame_statistics.prepare(m_image_size.getWidth(), m_frame_veto.isActive());
+    m_roi_counters.prepare(m_image_size);
+    if(m_roi_counters_only && !m_roi_counters.isActive())
+        DEB_WARNING() << "Roi counters only mode is set but there is no roi: images are published";
+
+    m_peak_finder.prepare(m_image_size);
+    m_pixel_statistics.prepare(m_image_size);
+    //- the lookup matrix is only rebuilt if the geometry or the image size changed
+    double x_size, y_size;
+    getPixelSize(x_size, y_size);
+    m_azimuthal_integrator.prepare(m_image_size, x_size / 1000.);
+    if(m_azimuthal_only && !m_azimuthal_integrator.isActive())
+        DEB_WARNING() << "Azimuthal integration only mode is set but integration is disabled: images are published";
+    m_sparse_frames.prepare(m_image_size, m_image_transform);
+    if(m_sparse_frames.isActive() && m_geom_corr)
+        throw LIMA_HW_EXC(Error, "Sparse frames are not available with the geometrical correction");
+    m_pump_probe.prepare(m_image_size, m_image_transform);
+    if(m_pump_probe.isActive() && m_geom_corr)
+        throw LIMA_HW_EXC(Error, "Pump-probe mode is not available with the geometrical correction");
+
+    //- the compressed frames are the lima ones (flipped/rotated)
+    ImageType image_type;
+    getPixelDepth(image_type);
+    m_frame_compressor.prepare(image_size, (image_type == Bpp16) ? 2 : 4);
+    if(m_compression_only && !m_frame_compressor.isActive())
+        DEB_WARNING() << "Compression only mode is set but compression is disabled: images are published";
     
     DEB_TRACE() << "m_acquisition_type = " << m_acquisition_type ;
     DEB_TRACE() << "Setting Exposure parameters with values: ";
     DEB_TRACE() << "\tm_exp_time_usec = " << m_exp_time_usec;
     DEB_TRACE() << "\tm_imxpad_trigger_mode = " << m_imxpad_trigger_mode;
     DEB_TRACE() << "\tm_nb_frames	= " << m_nb_frames;
+    DEB_TRACE() << "\tm_nb_hw_frames	= " << m_nb_hw_frames;
     DEB_TRACE() << "\tm_imxpad_format	= " << m_imxpad_format;
 
     //- call the setExposureParameters
@@ -176,7 +318,7 @@ void Camera::prepare()
                           m_imxpad_trigger_mode,
                           m_specific_param_n,
                           m_specific_param_p,
-                          (m_nb_frames==0) ? 1 : m_nb_frames,
+                          nb_hw_frames_per_sequence,
                           m_busy_out_sel,
                           m_imxpad_format,
                           XPIX_NOT_USED_YET, //- postProc
@@ -185,57 +327,20 @@ void Camera::prepare()
                           m_specific_param_GP3,
                           m_specific_param_GP4);
 
-    if(m_live_mode == true)
-    {
-        int one_frame = 1;
-        DEB_TRACE() <<"LIVE mode: pre allocating 1 image array";
-        if(m_imxpad_format == 0) //- aka 16 bits
-        {
-            m_image_array = reinterpret_cast<void**>(new uint16_t* [ one_frame ]);
-            if(m_doublepixel_corr) //- the image returned by xpix is not double pixel corrected !!
-            {
-                //TANGODEVIC-1280, add double pixel correction for S70
-                if(m_xpad_model == IMXPAD_S140)
-				    m_image_array[0] = new uint16_t [ (m_image_size.getWidth()-18) * (m_image_size.getHeight()-3) ];//we allocate a number of pixels
-                if(m_xpad_model == IMXPAD_S70)
-                    m_image_array[0] = new uint16_t [ (m_image_size.getWidth()-18) * (m_image_size.getHeight()) ];//we allocate a number of pixels                    
-            }
-			else
-            {
-				m_image_array[0] = new uint16_t [ m_image_size.getWidth()* m_image_size.getHeight()];
-            }
-        }
-        else //- aka 32 bits
-        {
-            m_image_array = reinterpret_cast<void**>(new uint32_t* [ one_frame ]);
-            if(m_doublepixel_corr) //- the image returned by xpix is not double pixel corrected !!
-            {   
-                //TANGODEVIC-1280, add double pixel correction for S70
-                if(m_xpad_model == IMXPAD_S140)
-				    m_image_array[0] = new uint32_t [ (m_image_size.getWidth()-18) * (m_image_size.getHeight()-3) ];//we allocate a number of pixels
-                if(m_xpad_model == IMXPAD_S70)
-                    m_image_array[0] = new uint32_t [ (m_image_size.getWidth()-18) * (m_image_size.getHeight()) ];//we allocate a number of pixels
-            }
-			else
-            {
-				m_image_array[0] = new uint32_t [ m_image_size.getWidth()* m_image_size.getHeight()];
-            }
-        }
-
-    }
-    else if(m_acquisition_type == Camera::SYNC)
+    if(m_live_mode == true || m_acquisition_type == Camera::SYNC || m_threshold_scan.isActive())
     {
-        //- used only in SYNC acquisition
+        //- used only in SYNC acquisition (live and threshold scan)
+        //- live: one lima frame, i.e. the accumulated (HDR) hardware frames, per sequence
         // allocate multiple buffers
 
-        DEB_TRACE() <<"SYNC mode: pre allocating images array (" << m_nb_frames << " images)";
+        DEB_TRACE() <<"SYNC mode: pre allocating images array (" << m_nb_hw_frames << " images)";
         if(m_imxpad_format == 0) //- aka 16 bits . @@TODO : use enumerate for m_imxpad_format ! 
-            m_image_array = reinterpret_cast<void**>(new uint16_t* [ m_nb_frames ]);
+            m_image_array = reinterpret_cast<void**>(new uint16_t* [ m_nb_hw_frames ]);
         else //- aka 32 bits
-            m_image_array = reinterpret_cast<void**>(new uint32_t* [ m_nb_frames ]);
+            m_image_array = reinterpret_cast<void**>(new uint32_t* [ m_nb_hw_frames ]);
 
         DEB_TRACE() <<"SYNC mode: pre allocating every image pointer of the images array";
-        for( int i = 0 ; i < m_nb_frames ; i++ )
+        for( int i = 0 ; i < m_nb_hw_frames ; i++ )
         {
             if(m_imxpad_format == 0) //- aka 16 bits
             {
@@ -282,21 +387,29 @@ void Camera::start()
 {
     DEB_MEMBER_FUNCT();
 
-    if((m_acquisition_type == Camera::SYNC) || (m_live_mode == true))
-    {
-        //- Post XPAD_DLL_START_SYNC_MSG msg
-        this->post(new yat::Message(XPAD_DLL_START_SYNC_MSG), kPOST_MSG_TMO);
-    }
+    AcqCommand command;
+    if(m_threshold_scan.isActive())
+        command = ACQ_START_ITHL_SCAN;
+    else if((m_acquisition_type == Camera::SYNC) || (m_live_mode == true))
+        command = ACQ_START_SYNC;
     else if (m_acquisition_type == Camera::ASYNC)
-    {
-        //- Post XPAD_DLL_START_ASYNC_MSG msg
-        this->post(new yat::Message(XPAD_DLL_START_ASYNC_MSG), kPOST_MSG_TMO);
-    }
+        command = ACQ_START_ASYNC;
     else
     {
         DEB_ERROR() << "Acquisition type not supported" ;
         throw LIMA_HW_EXC(Error, "Acquisition type not supported: possible values are:\n0->SYNC\n1->ASYNC");
     }
+
+    //- a calibration (control message) or a running acquisition holds the detector
+    if(m_status != Camera::Ready)
+    {
+        DEB_ERROR() << "Camera not ready: " << DEB_VAR1(m_status);
+        throw LIMA_HW_EXC(Error, "Unable to start the acquisition: the camera is not Ready");
+    }
+
+    //- the status is Exposure as soon as the acquisition is queued
+    m_status = Camera::Exposure;
+    postAcqCommand(command);
 }
 
 //---------------------------
@@ -306,11 +419,21 @@ void Camera::stop()
 {
     DEB_MEMBER_FUNCT();
 
+    //- an acquisition which is still queued is not started
+    bool acq_running;
+    {
+        AutoMutex lock(m_acq_cond.mutex());
+        m_acq_commands.clear();
+        acq_running = m_acq_running;
+    }
+
     //- call the abort fct from xpix lib
     xpci_modAbortExposure();
     m_stop_asked = true;
 
-    m_status = Camera::Ready;
+    //- a running acquisition reports Ready itself, once it has left the acquisition thread
+    if(!acq_running && m_status != Camera::Calibrating)
+        m_status = Camera::Ready;
 }
 
 //-----------------------------------------------------
@@ -333,7 +456,11 @@ void Camera::getImageSize(Size& size)
     else
         m_image_size = Size(CHIP_NB_COLUMN * m_chip_number , CHIP_NB_ROW * m_module_number);
 
-    size = m_image_size;
+    //- m_image_size is the corrected image, the lima buffer is rotated
+    if((m_rotation == Rotation_90) || (m_rotation == Rotation_270))
+        size = Size(m_image_size.getHeight(), m_image_size.getWidth());
+    else
+        size = m_image_size;
 }
 
 //-----------------------------------------------------
@@ -352,6 +479,14 @@ void Camera::getPixelSize(double& x_size, double& y_size)
 void Camera::setPixelDepth(ImageType pixel_depth)
 {
     DEB_MEMBER_FUNCT();
+    if(m_frame_accumulator.isActive() || m_hdr_merger.isActive())
+    {
+        //- hardware frames stay 16 bits, the accumulated (merged) frames are 32 bits
+        if(pixel_depth != Bpp32)
+            throw LIMA_HW_EXC(Error, "Pixel Depth is 32 bits in accumulation and HDR modes");
+        return;
+    }
+
     switch( pixel_depth )
     {
         case Bpp16:
@@ -383,6 +518,8 @@ void Camera::getPixelDepth(ImageType& pixel_depth)
             pixel_depth = Bpp16;
             if(m_geom_corr)
                 pixel_depth = Bpp32; //- Force to 32 as it is float
+            if(m_frame_accumulator.isActive() || m_hdr_merger.isActive())
+                pixel_depth = Bpp32; //- sum (merge) of 16 bits hardware frames
             break;
 
         case 1:
@@ -535,6 +672,55 @@ void Camera::getLatTime(double& lat_time_sec)
     DEB_RETURN() << DEB_VAR1(lat_time_sec);
 }
 
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setFlip(const Flip& flip)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(flip);
+
+    m_flip = flip;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getFlip(Flip& flip)
+{
+    DEB_MEMBER_FUNCT();
+
+    flip = m_flip;
+
+    DEB_RETURN() << DEB_VAR1(flip);
+}
+
+//-----------------------------------------------------
+//		Set the rotation (clockwise, applied after the flip)
+//-----------------------------------------------------
+void Camera::setRotation(RotationMode rotation)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(rotation);
+
+    m_rotation = rotation;
+
+    //- 90 and 270 deg swap width and height
+    notifyMaxImageSizeChanged();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getRotation(RotationMode& rotation)
+{
+    DEB_MEMBER_FUNCT();
+
+    rotation = m_rotation;
+
+    DEB_RETURN() << DEB_VAR1(rotation);
+}
+
 //-----------------------------------------------------
 //
 //-----------------------------------------------------
@@ -566,7 +752,12 @@ int Camera::getNbHwAcquiredFrames()
 {
     //return m_current_nb_frames /*+ 1*/; //- because m_current_nb_frames start at 0 
 
-    return(m_current_nb_frames == -1) ? 0 : (m_current_nb_frames + 1);
+    //- with the veto, lima only gets the kept frames
+    if(m_frame_veto.isActive())
+        return m_frame_veto.getNbKeptFrames();
+
+    //- in accumulation and HDR modes, only complete accumulated frames are counted
+    return(m_current_nb_frames == -1) ? 0 : (m_current_nb_frames + 1) / getNbHwFramesPerFrame();
 }
 
 //-----------------------------------------------------
@@ -579,548 +770,693 @@ void Camera::getStatus(Camera::Status& status)
     DEB_RETURN() << DEB_VAR1(DEB_HEX(status));
 }
 
+//-----------------------------------------------------
+//		acquisition thread
+//-----------------------------------------------------
+void Camera::AcqThread::threadFunction()
+{
+    m_camera.runAcqCommands();
+}
+
 //-----------------------------------------------------
 //
 //-----------------------------------------------------
-void Camera::handle_message( yat::Message& msg )  throw( yat::Exception )
+void Camera::postAcqCommand(AcqCommand command)
+{
+    AutoMutex lock(m_acq_cond.mutex());
+    if(command == ACQ_QUIT)
+        m_acq_commands.clear();
+    m_acq_commands.push_back(command);
+    m_acq_cond.broadcast();
+}
+
+//-----------------------------------------------------
+//		runs the queued acquisitions until ACQ_QUIT
+//-----------------------------------------------------
+void Camera::runAcqCommands()
 {
     DEB_MEMBER_FUNCT();
-    try
+
+    AutoMutex lock(m_acq_cond.mutex());
+    while(true)
     {
-        switch ( msg.type() )
+        while(m_acq_commands.empty())
+            m_acq_cond.wait();
+        AcqCommand command = m_acq_commands.front();
+        m_acq_commands.pop_front();
+        if(command == ACQ_QUIT)
+            break;
+
+        m_acq_running = true;
+        lock.unlock();
+        try
         {
-                //-----------------------------------------------------	
-            case yat::TASK_INIT:
+            AutoMutex hw_lock(m_hw_lock);
+            switch(command)
             {
-                DEB_TRACE() <<"Camera::->TASK_INIT";
-            }
+            case ACQ_START_SYNC:
+                acquireSync();
                 break;
-                //-----------------------------------------------------    
-            case yat::TASK_EXIT:
-            {
-                DEB_TRACE() <<"Camera::->TASK_EXIT";
-            }
+            case ACQ_START_ASYNC:
+                acquireAsync();
                 break;
-                //-----------------------------------------------------    
-            case yat::TASK_TIMEOUT:
-            {
-                DEB_TRACE() <<"Camera::->TASK_TIMEOUT";
-            }
+            case ACQ_START_ITHL_SCAN:
+                acquireThresholdScan();
                 break;
-                //-----------------------------------------------------    
-            case XPAD_DLL_START_SYNC_MSG:
+            default:
+                break;
+            }
+        }
+        catch(Exception& e)
+        {
+            DEB_ERROR() << "Acquisition failed: " << e;
+            m_status = Camera::Fault;
+            Event *my_event = new Event(Hardware, Event::Error, Event::Camera, Event::Default, "acquisition thread : the acquisition has failed");
+            reportEvent(my_event);
+        }
+        catch(yat::Exception& ex)
+        {
+            //- a message posted to the task (with a timeout) from the acquisition thread
+            DEB_ERROR() << "Acquisition failed: " << ex.errors[0].desc;
+            m_status = Camera::Fault;
+            Event *my_event = new Event(Hardware, Event::Error, Event::Camera, Event::Default, "acquisition thread : the acquisition has failed");
+            reportEvent(my_event);
+        }
+        catch(std::exception& ex)
+        {
+            //- e.g. bad_alloc: the thread must not die with the exception
+            DEB_ERROR() << "Acquisition failed: " << ex.what();
+            m_status = Camera::Fault;
+            Event *my_event = new Event(Hardware, Event::Error, Event::Camera, Event::Default, "acquisition thread : the acquisition has failed");
+            reportEvent(my_event);
+        }
+        lock.lock();
+        m_acq_running = false;
+    }
+}
+
+//-----------------------------------------------------
+//		SYNC (and live) acquisition (acquisition thread)
+//-----------------------------------------------------
+void Camera::acquireSync()
+{
+    DEB_MEMBER_FUNCT();
+
+    //- if live i.e m_nb_frames==0 => force m_nb_frames =1 (times the accumulated frames)
+    int local_nb_frames = m_nb_hw_frames;
+
+    //- live: the sequence is restarted until stop
+    while(true)
+    {
+        m_status = Camera::Exposure;
+
+        //- Start the img sequence
+        DEB_TRACE() <<"Start acquiring a sequence of image(s)";
+
+        m_start_sec = Timestamp::now();
+
+        int xpix_status;
+        if(m_hdr_merger.isActive())
+            xpix_status = getHdrImgSeq(local_nb_frames);
+        else
+            xpix_status = xpci_getImgSeq(	m_pixel_depth,
+                            m_modules_mask,
+                            m_chip_number,
+                            //- if live i.e m_nb_frames==0 => force m_nb_frames =1
+                            local_nb_frames,
+                            (void**)m_image_array,
+                            // next are ignored in V2:
+                            XPIX_V1_COMPATIBILITY,
+                            XPIX_V1_COMPATIBILITY,
+                            XPIX_V1_COMPATIBILITY,
+                            XPIX_V1_COMPATIBILITY);
+        if (xpix_status == -1)
+        {
+            //- aborted by stop(): the images are freed below and the camera is Ready
+            if(m_stop_asked)
             {
-                DEB_TRACE() << "=========================================";
-                DEB_TRACE() << "Camera::->XPAD_DLL_START_SYNC_MSG";
+                DEB_TRACE() << "xpci_getImgSeq aborted by stop";
+                break;
+            }
+            DEB_ERROR() << "Error: xpci_getImgSeq has returned an error..." ;
 
-                m_status = Camera::Exposure;
+            DEB_TRACE() << "Freeing each image pointer of the image(s) array";
+            for(int i = 0 ; i < local_nb_frames ; i++)
+            {
+                if(m_imxpad_format == 0) //- aka 16 bits
+                    delete[] reinterpret_cast<uint16_t*>(m_image_array[i]);
+                else
+                    delete[] reinterpret_cast<uint32_t*>(m_image_array[i]);
+            }
 
-                //- Start the img sequence
-                DEB_TRACE() <<"Start acquiring a sequence of image(s)";
+            DEB_TRACE() << "Freeing the image(s) array";
+            if(m_imxpad_format == 0) //- aka 16 bits
+                delete[] reinterpret_cast<uint16_t**>(m_image_array);
+            else //- aka 32 bits
+                delete[] reinterpret_cast<uint32_t**>(m_image_array);
 
-                //- if live i.e m_nb_frames==0 => force m_nb_frames =1
-                int local_nb_frames = (m_nb_frames==0) ? 1 : m_nb_frames;
+            m_status = Camera::Fault;
+            throw LIMA_HW_EXC(Error, "xpci_getImgSeq has returned an error ! ");
+        }
 
-                m_start_sec = Timestamp::now();
+        m_end_sec = Timestamp::now() - m_start_sec;
+        DEB_TRACE() << "Time for xpci_getImgSeq (sec) = " << m_end_sec;
 
-                if ( xpci_getImgSeq(	m_pixel_depth,
-                                    m_modules_mask,
-                                    m_chip_number,
-                                    //- if live i.e m_nb_frames==0 => force m_nb_frames =1
-                                    local_nb_frames,
-                                    (void**)m_image_array,
-                                    // next are ignored in V2:
-                                    XPIX_V1_COMPATIBILITY,
-                                    XPIX_V1_COMPATIBILITY,
-                                    XPIX_V1_COMPATIBILITY,
-                                    XPIX_V1_COMPATIBILITY) == -1)
-                {
-                    DEB_ERROR() << "Error: xpci_getImgSeq has returned an error..." ;
+        m_status = Camera::Readout;
 
-                    DEB_TRACE() << "Freeing each image pointer of the image(s) array";
-                    for(int i = 0 ; i < local_nb_frames ; i++)
-                    {
-                        if(m_imxpad_format == 0) //- aka 16 bits
-                            delete[] reinterpret_cast<uint16_t*>(m_image_array[i]);
-                        else
-                            delete[] reinterpret_cast<uint32_t*>(m_image_array[i]);
-                    }
+        DEB_TRACE() 	<< "\n#######################"
+        << "\nall image(s) are acquired"
+        << "\n#######################" ;
 
-                    DEB_TRACE() << "Freeing the image(s) array";
-                    if(m_imxpad_format == 0) //- aka 16 bits
-                        delete[] reinterpret_cast<uint16_t**>(m_image_array);
-                    else //- aka 32 bits
-                        delete[] reinterpret_cast<uint32_t**>(m_image_array);
+        //- Publish each image and call new frame ready for each frame
+        DEB_TRACE() << "Publishing each acquired image through newFrameReady()";
+        m_start_sec = Timestamp::now();
+        for(int i = 0; i<local_nb_frames; i++)
+        {
+            m_current_nb_frames = i;
+            publishImage(m_image_array[i], i);
+        }
 
-                    m_status = Camera::Fault;
-                    throw LIMA_HW_EXC(Error, "xpci_getImgSeq has returned an error ! ");
-                }
+        m_end_sec = Timestamp::now() - m_start_sec;
+        DEB_TRACE() << "Time for publishing image(s)es to Lima (sec) = " << m_end_sec;
 
-                m_end_sec = Timestamp::now() - m_start_sec;
-                DEB_TRACE() << "Time for xpci_getImgSeq (sec) = " << m_end_sec;
+        //- Check if the it is live and if yes: restart
+        if (m_live_mode == true && m_stop_asked == false)
+        {
+            m_current_nb_frames = m_nb_live_frames++;
+            continue;
+        }
+        break;
+    }
 
-                m_status = Camera::Readout;
+    m_start_sec = Timestamp::now();
+    DEB_TRACE() << "Freeing every image pointer of the image(s) array";
+    //- they were allocated by the xpci_getImgSeq function
+    for(int i = 0 ; i < local_nb_frames ; i++)
+        delete[] m_image_array[i];
+    DEB_TRACE() << "Freeing image(s) array";
+    delete[] m_image_array;
+    m_frame_compressor.flush();
+    m_pump_probe.flush();
+    autoDetectHotPixels();
+    m_status = Camera::Ready;
+    preloadCalibrations();
+    m_end_sec = Timestamp::now() - m_start_sec;
+    DEB_TRACE() << "Time for freeing memory: now Ready! (sec) = " << m_end_sec;
+    DEB_TRACE() << "m_status is Ready";
+}
 
-                DEB_TRACE() 	<< "\n#######################"
-                << "\nall image(s) are acquired"
-                << "\n#######################" ;
+//-----------------------------------------------------
+//		HDR: one sequence per hardware frame, short (even) then long (odd) exposure (acquisition thread)
+//-----------------------------------------------------
+int Camera::getHdrImgSeq(int nb_hw_frames)
+{
+    DEB_MEMBER_FUNCT();
 
-                //- Publish each image and call new frame ready for each frame
-                StdBufferCbMgr& buffer_mgr = m_buffer_cb_mgr;
-                DEB_TRACE() << "Publishing each acquired image through newFrameReady()";
-                m_start_sec = Timestamp::now();
-                for(int i = 0; i<local_nb_frames; i++)
-                {
-                    m_current_nb_frames = i;
-                    int buffer_nb, concat_frame_nb;
-                    buffer_mgr.setStartTimestamp(Timestamp::now());
-                    buffer_mgr.acqFrameNb2BufferNb(i, buffer_nb, concat_frame_nb);
-
-                    void* lima_img_ptr;
-                    if(m_imxpad_format == 0) //- aka 16 bits
-                        lima_img_ptr = (uint16_t*)(buffer_mgr.getBufferPtr(buffer_nb, concat_frame_nb));
-                    else //- aka 32 bits
-                        lima_img_ptr = (uint32_t*)(buffer_mgr.getBufferPtr(buffer_nb, concat_frame_nb));
-
-                    //- copy image in the lima buffer
-                    if(m_imxpad_format == 0) //- aka 16 bits
-                    {
-                        if(m_doublepixel_corr) //- Double pixel correction for S140 and S70 only
-                        {
-                            //-
-                            if(m_xpad_model == IMXPAD_S140)
-                            {
-                                uint16_t corrected_image[S140_CORRECTED_NB_ROW][S140_CORRECTED_NB_COLUMN];
-                                doublePixelCorrectionForS140<uint16_t>((uint16_t *)m_image_array[i], corrected_image);
-                                memcpy((uint16_t *)lima_img_ptr, (uint16_t *)corrected_image, m_image_size.getWidth() * m_image_size.getHeight() * sizeof(uint16_t));
-                            }
-                            else if(m_xpad_model == IMXPAD_S70)
-                            {
-                                uint16_t corrected_image[S70_CORRECTED_NB_ROW][S70_CORRECTED_NB_COLUMN];
-                                doublePixelCorrectionForS70<uint16_t>((uint16_t *)m_image_array[i], corrected_image);
-                                memcpy((uint16_t *)lima_img_ptr, (uint16_t *)corrected_image, m_image_size.getWidth() * m_image_size.getHeight() * sizeof(uint16_t));
-                            }
-                        }
-                        else //- no double pix correction
-                        {
-                            memcpy((uint16_t *)lima_img_ptr, (uint16_t *)m_image_array[i], m_image_size.getWidth() * m_image_size.getHeight() * sizeof(uint16_t));
-                        }
-                    }
-                    else //- aka 32 bits
-                    {
-                        if(m_doublepixel_corr) //- Double pixel correction for S140 and S70 only
-                        {
-                            //-
-                            if(m_xpad_model == IMXPAD_S140)
-                            {
-                                uint32_t corrected_image[S140_CORRECTED_NB_ROW][S140_CORRECTED_NB_COLUMN];
-                                doublePixelCorrectionForS140<uint32_t>((uint32_t *)m_image_array[i], corrected_image);
-                                memcpy((uint32_t *)lima_img_ptr, (uint32_t *)corrected_image, m_image_size.getWidth() * m_image_size.getHeight() * sizeof(uint32_t));
-                            }
-                            else if (m_xpad_model == IMXPAD_S70)
-                            {
-                                uint32_t corrected_image[S70_CORRECTED_NB_ROW][S70_CORRECTED_NB_COLUMN];
-                                doublePixelCorrectionForS70<uint32_t>((uint32_t *)m_image_array[i], corrected_image);
-                                memcpy((uint32_t *)lima_img_ptr, (uint32_t *)corrected_image, m_image_size.getWidth() * m_image_size.getHeight() * sizeof(uint32_t));
-                            }
-                        }
-                        else
-                        {
-                            memcpy((uint32_t *)lima_img_ptr, (uint32_t *)m_image_array[i], m_image_size.getWidth() * m_image_size.getHeight() * sizeof(uint32_t));
-                        }
-                    }
+    for(int i = 0; i < nb_hw_frames; i++)
+    {
+        if(m_stop_asked)
+            return -1;
+        try
+        {
+            setExposureParameters(	(i % 2) ? m_exp_time_usec : m_hdr_short_exp_time_usec,
+                                  m_time_between_images_usec,
+                                  m_time_before_start_usec,
+                                  m_shutter_time_usec,
+                                  m_ovf_refresh_time_usec,
+                                  m_imxpad_trigger_mode,
+                                  m_specific_param_n,
+                                  m_specific_param_p,
+                                  1,
+                                  m_busy_out_sel,
+                                  m_imxpad_format,
+                                  XPIX_NOT_USED_YET, //- postProc
+                                  m_specific_param_GP1,
+                                  m_specific_param_GP2,
+                                  m_specific_param_GP3,
+                                  m_specific_param_GP4);
+        }
+        catch(Exception& e)
+        {
+            DEB_ERROR() << "HDR exposure not programmed: " << e;
+            return -1;
+        }
+        if(xpci_getImgSeq(	m_pixel_depth,
+                            m_modules_mask,
+                            m_chip_number,
+                            1,
+                            (void**)m_image_array + i,
+                            XPIX_V1_COMPATIBILITY,
+                            XPIX_V1_COMPATIBILITY,
+                            XPIX_V1_COMPATIBILITY,
+                            XPIX_V1_COMPATIBILITY) == -1)
+            return -1;
+    }
+    return 0;
+}
 
-                    HwFrameInfoType frame_info;
-                    frame_info.acq_frame_nb = i;
-                    //- raise the image to Lima
-                    buffer_mgr.newFrameReady(frame_info);
-                    DEB_TRACE() << "image " << i <<" published with newFrameReady()" ;
-                }
+//-----------------------------------------------------
+//		threshold scan acquisition (acquisition thread)
+//-----------------------------------------------------
+void Camera::acquireThresholdScan()
+{
+    DEB_MEMBER_FUNCT();
 
-                m_end_sec = Timestamp::now() - m_start_sec;
-                DEB_TRACE() << "Time for publishing image(s)es to Lima (sec) = " << m_end_sec;
+    int nb_hw_frames_per_step = getNbHwFramesPerFrame();
+    int nb_steps = m_threshold_scan.getNbPreparedSteps();
+    //- the config G is restored at the end of the scan, if known
+    std::vector<long> config_g;
+    bool config_g_known = getKnownConfigG(config_g);
 
-                //- Check if the it is live and if yes: restart
-                if (m_live_mode == true && m_stop_asked == false)
-                {
-                    //- Post XPAD_DLL_START_LIVE_ACQ_MSG msg
-                    m_current_nb_frames = m_nb_live_frames++;
-                    this->post(new yat::Message(XPAD_DLL_START_SYNC_MSG), kPOST_MSG_TMO);
-                }
-                else
-                {
-                    m_start_sec = Timestamp::now();
-                    DEB_TRACE() << "Freeing every image pointer of the image(s) array";
-                    //- they were allocated by the xpci_getImgSeq function
-                    for(int i = 0 ; i < local_nb_frames ; i++)
-                        delete[] m_image_array[i];
-                    DEB_TRACE() << "Freeing image(s) array";
-                    delete[] m_image_array;
-                    m_status = Camera::Ready;
-                    m_end_sec = Timestamp::now() - m_start_sec;
-                    DEB_TRACE() << "Time for freeing memory: now Ready! (sec) = " << m_end_sec;
-                    DEB_TRACE() << "m_status is Ready";
-                }
+    ScanPublishJob job(*this);
+    bool publishing = false;
+    m_start_sec = Timestamp::now();
+    try
+    {
+        for(int step = 0; step < nb_steps && !m_stop_asked; step++)
+        {
+            //- the ITHL change and the exposure run while the previous step is published
+            loadIthl(m_threshold_scan.getIthl(step));
+            m_status = Camera::Exposure;
+            if(xpci_getImgSeq(	m_pixel_depth,
+                                m_modules_mask,
+                                m_chip_number,
+                                nb_hw_frames_per_step,
+                                (void**)m_image_array + step * nb_hw_frames_per_step,
+                                XPIX_V1_COMPATIBILITY,
+                                XPIX_V1_COMPATIBILITY,
+                                XPIX_V1_COMPATIBILITY,
+                                XPIX_V1_COMPATIBILITY) == -1)
+            {
+                if(m_stop_asked)
+                    break;
+                throw LIMA_HW_EXC(Error, "xpci_getImgSeq has returned an error ! ");
             }
-                break;
 
-                //-----------------------------------------------------    
-            case XPAD_DLL_START_ASYNC_MSG:
+            if(publishing)
             {
-                DEB_TRACE() << "=========================================";
-                DEB_TRACE() << "Camera::->XPAD_DLL_START_ASYNC_MSG";
+                m_scan_publish_pool.wait();
+                job.checkError();
+            }
+            m_status = Camera::Readout;
+            job.setStep(step, nb_hw_frames_per_step);
+            m_scan_publish_pool.post(&job);
+            publishing = true;
+        }
+        m_scan_publish_pool.wait();
+        job.checkError();
+    }
+    catch(Exception& e)
+    {
+        DEB_ERROR() << "Threshold scan failed: " << e;
+        m_scan_publish_pool.wait();
+        freeImageArray(m_nb_hw_frames);
+        m_status = Camera::Fault;
+        throw;
+    }
 
-                m_status = Camera::Exposure;
+    m_end_sec = Timestamp::now() - m_start_sec;
+    DEB_TRACE() << "Time for the threshold scan (sec) = " << m_end_sec;
 
-                //- Start the img sequence
-                DEB_TRACE() <<"Start acquiring asynchronously a sequence of image(s)";
+    freeImageArray(m_nb_hw_frames);
+    if(config_g_known)
+        setAllConfigG(config_g);
+    else
+        DEB_WARNING() << "Config G unknown before the threshold scan: ITHL is left at the last step";
+    m_frame_compressor.flush();
+    m_pump_probe.flush();
+    autoDetectHotPixels();
+    m_status = Camera::Ready;
+    preloadCalibrations();
+    DEB_TRACE() << "m_status is Ready";
+}
 
-                m_start_sec = Timestamp::now();
+//-----------------------------------------------------
+//		ASYNC acquisition: the images are read while acquired (acquisition thread)
+//-----------------------------------------------------
+void Camera::acquireAsync()
+{
+    DEB_MEMBER_FUNCT();
 
-                if ( xpci_getImgSeqAsync(   m_pixel_depth,
-                                         m_modules_mask,
-                                         m_nb_frames
-                                         ) == -1)
-                {
-                    DEB_ERROR() << "Error: xpci_getImgSeqAsync has returned an error..." ;
-                    m_status = Camera::Fault;
-                    throw LIMA_HW_EXC(Error, "xpci_getImgSeqAsync has returned an error ! ");
-                }
+    m_status = Camera::Exposure;
 
-                //- Post XPAD_DLL_GET_ASYNC_IMAGES_MSG msg
-                this->post(new yat::Message(XPAD_DLL_GET_ASYNC_IMAGES_MSG), kPOST_MSG_TMO);
-            }
-                break;
+    //- Start the img sequence
+    DEB_TRACE() <<"Start acquiring asynchronously a sequence of image(s)";
 
-                //-----------------------------------------------------    
-            case XPAD_DLL_GET_ASYNC_IMAGES_MSG:
-            {
-                DEB_TRACE() << "=========================================";
-                DEB_TRACE() <<"Camera::->XPAD_DLL_GET_ASYNC_IMAGES_MSG";
+    m_start_sec = Timestamp::now();
 
-                m_status = Camera::Exposure;
+    if ( xpci_getImgSeqAsync(   m_pixel_depth,
+                             m_modules_mask,
+                             m_nb_hw_frames
+                             ) == -1)
+    {
+        DEB_ERROR() << "Error: xpci_getImgSeqAsync has returned an error..." ;
+        m_status = Camera::Fault;
+        throw LIMA_HW_EXC(Error, "xpci_getImgSeqAsync has returned an error ! ");
+    }
 
-                void	*one_image;
-                float	*one_corrected_image;
+    void	*one_image;
+    float	*one_corrected_image;
 
-                int		image_counter = 0;
-                int		nb_last_acquired_image = 0;
+    int		image_counter = 0;
+    int		nb_last_acquired_image = 0;
 
-                if(m_imxpad_format == 0) //- aka 16 bits
-                {
-                    if(m_doublepixel_corr) //- Double pixel correction for S140 and S70 only
-                    {
-                        //-
-                        if(m_xpad_model == IMXPAD_S140)
+    if(m_imxpad_format == 0) //- aka 16 bits
+    {
+        if(m_doublepixel_corr) //- Double pixel correction for S140 and S70 only
+        {
+            //-
+            if(m_xpad_model == IMXPAD_S140)
 						  one_image = new uint16_t [ (m_image_size.getWidth()-18) * (m_image_size.getHeight()-3) ]; //- TODO const int the 18 and the 3 magics
-                        if(m_xpad_model == IMXPAD_S70)
+            if(m_xpad_model == IMXPAD_S70)
 						  one_image = new uint16_t [ (m_image_size.getWidth()-18) * (m_image_size.getHeight()) ]; //- TODO const int the 18 and the 3 magics
-                    }
+        }
 					else
-                    {
+        {
 						one_image = new uint16_t [ m_image_size.getWidth() * m_image_size.getHeight() ];
-                    }
-                }
-                else //- aka 32 bits
-                {
-                    if(m_doublepixel_corr) //- Double pixel correction for S140 and S70 only
-                    {
-                        //-
-                        if(m_xpad_model == IMXPAD_S140)
-    						one_image = new uint32_t [ (m_image_size.getWidth()-18) * (m_image_size.getHeight()-3) ]; //- TODO const int the 18 and the 3 magics
-                        if(m_xpad_model == IMXPAD_S70)
-    						one_image = new uint32_t [ (m_image_size.getWidth()-18) * (m_image_size.getHeight()) ]; //- TODO const int the 18 and the 3 magics
-                    }
+        }
+    }
+    else //- aka 32 bits
+    {
+        if(m_doublepixel_corr) //- Double pixel correction for S140 and S70 only
+        {
+            //-
+            if(m_xpad_model == IMXPAD_S140)
+						one_image = new uint32_t [ (m_image_size.getWidth()-18) * (m_image_size.getHeight()-3) ]; //- TODO const int the 18 and the 3 magics
+            if(m_xpad_model == IMXPAD_S70)
+						one_image = new uint32_t [ (m_image_size.getWidth()-18) * (m_image_size.getHeight()) ]; //- TODO const int the 18 and the 3 magics
+        }
 					else
-                    {
+        {
 						one_image = new uint32_t [ m_image_size.getWidth() * m_image_size.getHeight() ];
-                    }
-                }
+        }
+    }
 
-                //- the geometric corrected image is returned by the xpix lib
-                if(m_geom_corr) //- only for swing S540 xpad
-                    one_corrected_image = new float [ m_image_size.getWidth() * m_image_size.getHeight() ];
+    //- the geometric corrected image is returned by the xpix lib
+    if(m_geom_corr) //- only for swing S540 xpad
+        one_corrected_image = new float [ m_image_size.getWidth() * m_image_size.getHeight() ];
 
-                //- workaround to a bug in xpci_getNumberLastAcquiredAsyncImage(): have to wait a little before calling it
-                yat::ThreadingUtilities::sleep(1+m_exp_time_usec / 1e6);  //- wait at least exp time in sec + 1 sec
+    //- workaround to a bug in xpci_getNumberLastAcquiredAsyncImage(): have to wait a little before calling it
+    yat::ThreadingUtilities::sleep(1+m_exp_time_usec / 1e6);  //- wait at least exp time in sec + 1 sec
 
-                DEB_TRACE() << "m_nb_frames         = " << m_nb_frames;
+    DEB_TRACE() << "m_nb_hw_frames      = " << m_nb_hw_frames;
 
-                while (image_counter < m_nb_frames)
-                {
-                    nb_last_acquired_image = xpci_getNumberLastAcquiredAsyncImage();
+    while (image_counter < m_nb_hw_frames)
+    {
+        nb_last_acquired_image = xpci_getNumberLastAcquiredAsyncImage();
 
-                    //- FL: hacked from imxpad ... don't know what is it
-                    if(nb_last_acquired_image < 0)
-                        break;
+        //- FL: hacked from imxpad ... don't know what is it
+        if(nb_last_acquired_image < 0)
+            break;
 
-                    if (image_counter < nb_last_acquired_image)
-                    {
-                        DEB_TRACE() << "nb_last_acquired_image = " << nb_last_acquired_image;
-                        DEB_TRACE() << "image_counter         = " << image_counter;
-
-                        if ( xpci_getAsyncImage(    m_pixel_depth,
-                                                m_modules_mask,
-                                                m_chip_number,
-                                                m_nb_frames,
-                                                (void*)one_image, //- base img
-                                                image_counter, //- image index to get
-                                                (void*)one_corrected_image, //- corrected img
-                                                m_geom_corr //- flag for activating correction
-                                                ) == -1)
+        if (image_counter < nb_last_acquired_image)
+        {
+            DEB_TRACE() << "nb_last_acquired_image = " << nb_last_acquired_image;
+            DEB_TRACE() << "image_counter         = " << image_counter;
 
-                        {
-                            DEB_ERROR() << "Error: xpci_getAsyncImage has returned an error..." ;
+            if ( xpci_getAsyncImage(    m_pixel_depth,
+                                    m_modules_mask,
+                                    m_chip_number,
+                                    m_nb_hw_frames,
+                                    (void*)one_image, //- base img
+                                    image_counter, //- image index to get
+                                    (void*)one_corrected_image, //- corrected img
+                                    m_geom_corr //- flag for activating correction
+                                    ) == -1)
 
-                            DEB_TRACE() << "Freeing the image";
-                            delete[] one_image;
-                            if(m_geom_corr)
-                                delete[] one_corrected_image;
+            {
+                DEB_ERROR() << "Error: xpci_getAsyncImage has returned an error..." ;
 
-                            m_status = Camera::Fault;
-                            throw LIMA_HW_EXC(Error, "xpci_getAsyncImage has returned an error ! ");
-                        }
+                DEB_TRACE() << "Freeing the image";
+                delete[] one_image;
+                if(m_geom_corr)
+                    delete[] one_corrected_image;
 
-                        //- Publish each image and call new frame ready for each frame
-                        StdBufferCbMgr& buffer_mgr = m_buffer_cb_mgr;
-                        DEB_TRACE() << "Publishing image : " << image_counter << " through newFrameReady()";
-                        m_start_sec = Timestamp::now();
+                m_status = Camera::Fault;
+                throw LIMA_HW_EXC(Error, "xpci_getAsyncImage has returned an error ! ");
+            }
 
-                        m_current_nb_frames = image_counter;
-                        int buffer_nb, concat_frame_nb;
-                        buffer_mgr.setStartTimestamp(Timestamp::now());
-                        buffer_mgr.acqFrameNb2BufferNb(m_current_nb_frames, buffer_nb, concat_frame_nb);
+            //- Publish each image and call new frame ready for each frame
+            DEB_TRACE() << "Publishing image : " << image_counter << " through newFrameReady()";
+            m_start_sec = Timestamp::now();
 
-                        void* lima_img_ptr;
-                        if(m_geom_corr) //- For S540 only
-                        {
-                            lima_img_ptr = (float*)(buffer_mgr.getBufferPtr(buffer_nb, concat_frame_nb));
-                            memcpy((float*)lima_img_ptr, (float*)one_corrected_image, m_image_size.getWidth() * m_image_size.getHeight() * sizeof(float));
-                        }
-                        else
-                        {
-                            if(m_imxpad_format == 0) //- aka 16 bits
-                                lima_img_ptr = (uint16_t*)(buffer_mgr.getBufferPtr(buffer_nb, concat_frame_nb));
-                            else //- aka 32 bits
-                                lima_img_ptr = (uint32_t*)(buffer_mgr.getBufferPtr(buffer_nb, concat_frame_nb));
-
-                            //- copy image in the lima buffer
-                            if(m_imxpad_format == 0) //- aka 16 bits
-                            {
-                                if(m_doublepixel_corr) //- For S140 only
-                                {
-                                    //TANGODEVIC-1280, add double pixel correction for S70
-                                    if(m_xpad_model == IMXPAD_S140)
-                                    {
-                                        uint16_t corrected_image[S140_CORRECTED_NB_ROW][S140_CORRECTED_NB_COLUMN];
-                                        doublePixelCorrectionForS140<uint16_t>((uint16_t *)one_image, corrected_image);
-                                        memcpy((uint16_t *)lima_img_ptr, (uint16_t *)corrected_image, m_image_size.getWidth() * m_image_size.getHeight() * sizeof(uint16_t));
-                                    }
-                                    else if (m_xpad_model == IMXPAD_S70)
-                                    {
-                                        uint16_t corrected_image[S70_CORRECTED_NB_ROW][S70_CORRECTED_NB_COLUMN];
-                                        doublePixelCorrectionForS70<uint16_t>((uint16_t *)one_image, corrected_image);
-                                        memcpy((uint16_t *)lima_img_ptr, (uint16_t *)corrected_image, m_image_size.getWidth() * m_image_size.getHeight() * sizeof(uint16_t));
-                                    }
-                                }
-                                else //- no double pix correction
-                                {
-                                    memcpy((uint16_t *)lima_img_ptr, (uint16_t *)one_image, m_image_size.getWidth() * m_image_size.getHeight() * sizeof(uint16_t));
-                                }
-                            }
-                            else //- aka 32 bits
-                            {
-                                if(m_doublepixel_corr)
-                                {
-                                    //TANGODEVIC-1280, add double pixel correction for S70
-                                    if(m_xpad_model == IMXPAD_S140)
-                                    {
-                                        uint32_t corrected_image[S140_CORRECTED_NB_ROW][S140_CORRECTED_NB_COLUMN];
-                                        doublePixelCorrectionForS140<uint32_t>((uint32_t *)one_image, corrected_image);
-                                        memcpy((uint32_t *)lima_img_ptr, (uint32_t *)corrected_image, m_image_size.getWidth() * m_image_size.getHeight() * sizeof(uint32_t));
-                                    }
-                                    else if (m_xpad_model == IMXPAD_S70)
-                                    {
-                                        uint32_t corrected_image[S70_CORRECTED_NB_ROW][S70_CORRECTED_NB_COLUMN];
-                                        doublePixelCorrectionForS70<uint32_t>((uint32_t *)one_image, corrected_image);
-                                        memcpy((uint32_t *)lima_img_ptr, (uint32_t *)corrected_image, m_image_size.getWidth() * m_image_size.getHeight() * sizeof(uint32_t));
-                                    }
-                                }
-                                else //- no double pix correction
-                                {
-                                    memcpy((uint32_t *)lima_img_ptr, (uint32_t *)one_image, m_image_size.getWidth() * m_image_size.getHeight() * sizeof(uint32_t));
-                                }
-                            }
-                        }
+            m_current_nb_frames = image_counter;
+            //- the geometric corrected image is returned by the xpix lib (S540 only)
+            publishImage(m_geom_corr ? (void*)one_corrected_image : one_image, image_counter);
+            image_counter++;
+        }
+    }
 
-                        HwFrameInfoType frame_info;
-                        frame_info.acq_frame_nb = image_counter;
-                        //- raise the image to Lima
-                        buffer_mgr.newFrameReady(frame_info);
-                        DEB_TRACE() << "image " << image_counter <<" published with newFrameReady()" ;
-                        image_counter++;
-                    }
-                }
+    DEB_TRACE() << "End: nb_last_acquired_image = " << nb_last_acquired_image;
+    DEB_TRACE() << "End: image_counter         = " << image_counter;
 
-                DEB_TRACE() << "End: nb_last_acquired_image = " << nb_last_acquired_image;
-                DEB_TRACE() << "End: image_counter         = " << image_counter;
+    //- Finished
+    m_start_sec = Timestamp::now();
+    DEB_TRACE() << "Freeing last image pointer";
+    delete[] one_image;
+    if(m_geom_corr)
+        delete[] one_corrected_image;
+    m_frame_compressor.flush();
+    m_pump_probe.flush();
+    autoDetectHotPixels();
 
-                //- Finished
-                m_start_sec = Timestamp::now();
-                DEB_TRACE() << "Freeing last image pointer";
-                delete[] one_image;
-                if(m_geom_corr)
-                    delete[] one_corrected_image;
+    m_status = Camera::Ready;
+    preloadCalibrations();
+    m_end_sec = Timestamp::now() - m_start_sec;
+    DEB_TRACE() << "Time for freeing memory: now Ready! (sec) = " << m_end_sec;
+    DEB_TRACE() << "m_status is Ready";
+}
 
-                m_status = Camera::Ready;
-                m_end_sec = Timestamp::now() - m_start_sec;
-                DEB_TRACE() << "Time for freeing memory: now Ready! (sec) = " << m_end_sec;
-                DEB_TRACE() << "m_status is Ready";
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::handle_message( yat::Message& msg )  throw( yat::Exception )
+{
+    DEB_MEMBER_FUNCT();
+    //- the control messages wait for the running acquisition, not the callers
+    AutoMutex hw_lock(m_hw_lock);
+    try
+    {
+        switch ( msg.type() )
+        {
+                //-----------------------------------------------------	
+            case yat::TASK_INIT:
+            {
+                DEB_TRACE() <<"Camera::->TASK_INIT";
+            }
+                break;
+                //-----------------------------------------------------    
+            case yat::TASK_EXIT:
+            {
+                DEB_TRACE() <<"Camera::->TASK_EXIT";
+            }
+                break;
+                //-----------------------------------------------------    
+            case yat::TASK_TIMEOUT:
+            {
+                DEB_TRACE() <<"Camera::->TASK_TIMEOUT";
             }
                 break;
-
                 //-----------------------------------------------------    
             case XPAD_DLL_CALIBRATE_OTN_SLOW:
             {
                 DEB_TRACE() <<"Camera::->XPAD_DLL_CALIBRATE_OTN_SLOW";
 
-                m_status = Camera::Calibrating;
+                runCalibration(CALIBRATION_OTN_SLOW);
+            }
+                break;
+                //-----------------------------------------------------    
+            case XPAD_DLL_CALIBRATE_OTN_MEDIUM:
+            {
+                DEB_TRACE() <<"Camera::->XPAD_DLL_CALIBRATE_OTN_MEDIUM";
 
+                runCalibration(CALIBRATION_OTN_MEDIUM);
+            }
+                break;
+                //-----------------------------------------------------    
+            case XPAD_DLL_CALIBRATE_OTN_FAST:
+            {
+                DEB_TRACE() <<"Camera::->XPAD_DLL_CALIBRATE_OTN_FAST";
 
-                if(imxpad_calibration_OTN_slow(m_modules_mask, (char*)m_calibration_path.c_str(), m_calibration_adjusting_number) == 0)
-                {
-                    DEB_TRACE() << "imxpad_calibration_OTN_slow -> OK" ;
-                }
-                else
-                {
-                    Event *my_event = new Event(Hardware, Event::Error, Event::Camera, Event::Default, "imxpad_calibration_OTN_slow() : error for path: " + m_calibration_path);
-                    //DEB_EVENT(*my_event) << DEB_VAR1(*my_event);
-                    reportEvent(my_event);
+                runCalibration(CALIBRATION_OTN_FAST);
+            }
+                break;
+                //-----------------------------------------------------    
+            case XPAD_DLL_CALIBRATE_BEAM:
+            {
+                DEB_TRACE() <<"Camera::->XPAD_DLL_CALIBRATE_BEAM";
 
-                    m_status = Camera::Fault;
-                    //- TODO: get the xpix error 
-                    throw LIMA_HW_EXC(Error, "Error in imxpad_calibration_OTN_slow!");
-                }
-                m_status = Camera::Ready;
+                runCalibration(CALIBRATION_BEAM);
             }
                 break;
                 //-----------------------------------------------------    
-            case XPAD_DLL_CALIBRATE_OTN_MEDIUM:
+            case XPAD_DLL_CALIBRATE_OTN:
             {
-                DEB_TRACE() <<"Camera::->XPAD_DLL_CALIBRATE_OTN_MEDIUM";
+                DEB_TRACE() <<"Camera::->XPAD_DLL_CALIBRATE_OTN";
+
+                runCalibration(CALIBRATION_OTN);
+            }
+                break;
+
+                //-----------------------------------------------------	
+            case XPAD_DLL_UPLOAD_CALIBRATION:
+            {
+                DEB_TRACE() <<"Camera::->XPAD_DLL_UPLOAD_CALIBRATION";
 
                 m_status = Camera::Calibrating;
 
+                if(m_calibration_cache_active)
+                {
+                    try
+                    {
+                        if(isCalibrationLoaded(m_calibration_path))
+                        {
+                            DEB_TRACE() << "Calibration " << m_calibration_path << " already loaded";
+                            m_calibration_upload_nb_rows = 0;
+                            m_calibration_upload_nb_registers = 0;
+                            m_calibration_upload_elapsed_sec = 0;
+                            m_status = Camera::Ready;
+                            break;
+                        }
+                        uploadCachedCalibration(m_calibration_path, 0);
+                        m_status = Camera::Ready;
+                        break;
+                    }
+                    catch(Exception& e)
+                    {
+                        //- e.g. a directory written by the xpix calibration: only the cache text layout is parsed
+                        DEB_WARNING() << "Calibration cache not used for " << m_calibration_path << ", full upload: " << e;
+                    }
+                }
 
-                if(imxpad_calibration_OTN_medium(m_modules_mask, (char*)m_calibration_path.c_str(), m_calibration_adjusting_number) == 0)
+                m_calibration_cache.invalidateAll();
+                Timestamp upload_start = Timestamp::now();
+                if(imxpad_uploadCalibration(m_modules_mask, (char*)m_calibration_path.c_str()) == 0)
                 {
-                    DEB_TRACE() << "imxpad_calibration_OTN_medium -> OK" ;
+                    DEB_TRACE() << "imxpad_uploadCalibration -> OK" ;
+                    m_calibration_upload_nb_rows = m_module_number * m_chip_number * CHIP_NB_ROW;
+                    m_calibration_upload_nb_registers = m_module_number * CONFIG_G_NB_REGISTERS;
+                    m_calibration_upload_elapsed_sec = Timestamp::now() - upload_start;
                 }
                 else
                 {
-                    Event *my_event = new Event(Hardware, Event::Error, Event::Camera, Event::Default, "imxpad_calibration_OTN_medium() : error for path: " + m_calibration_path);
-                    //DEB_EVENT(*my_event) << DEB_VAR1(*my_event);
-                    reportEvent(my_event);
-
                     m_status = Camera::Fault;
                     //- TODO: get the xpix error 
-                    throw LIMA_HW_EXC(Error, "Error in imxpad_calibration_OTN_medium!");
+                    throw LIMA_HW_EXC(Error, "Error in imxpad_uploadCalibration!");
                 }
                 m_status = Camera::Ready;
             }
                 break;
 
-                //-----------------------------------------------------    
-            case XPAD_DLL_CALIBRATE_OTN_FAST:
+                //-----------------------------------------------------	
+            case XPAD_DLL_PRELOAD_CALIBRATIONS:
             {
-                DEB_TRACE() <<"Camera::->XPAD_DLL_CALIBRATE_OTN_FAST";
+                DEB_TRACE() <<"Camera::->XPAD_DLL_PRELOAD_CALIBRATIONS";
 
-                m_status = Camera::Calibrating;
+                //- one module per message: a start or a switch waits at most one module save
+                //- the preload is posted again at the end of the acquisition
+                if(m_status == Camera::Ready && preloadCalibrationModule())
+                    this->post(new yat::Message(XPAD_DLL_PRELOAD_CALIBRATIONS), kPOST_MSG_TMO);
+            }
+                break;
+
+                //-----------------------------------------------------	
+            case XPAD_DLL_SWITCH_CALIBRATION:
+            {
+                DEB_TRACE() <<"Camera::->XPAD_DLL_SWITCH_CALIBRATION";
 
+                m_status = Camera::Calibrating;
 
-                if(imxpad_calibration_OTN_fast(m_modules_mask, (char*)m_calibration_path.c_str(), m_calibration_adjusting_number) == 0)
+                try
                 {
-                    DEB_TRACE() << "imxpad_calibration_OTN_fast -> OK" ;
+                    int calib_id = m_calibration_cache.findSlot(m_switch_calibration_path);
+                    if(calib_id < 0)
+                        THROW_HW_ERROR(InvalidValue) << "Calibration " << m_switch_calibration_path << " is not in the calibration library";
+                    uploadCachedCalibration(m_switch_calibration_path, calib_id);
                 }
-                else
+                catch(Exception& e)
                 {
-                    Event *my_event = new Event(Hardware, Event::Error, Event::Camera, Event::Default, "imxpad_calibration_OTN_fast() : error for path: " + m_calibration_path);
-                    //DEB_EVENT(*my_event) << DEB_VAR1(*my_event);
+                    Event *my_event = new Event(Hardware, Event::Error, Event::Camera, Event::Default, "switchCalibration() : error for path: " + m_switch_calibration_path);
                     reportEvent(my_event);
 
                     m_status = Camera::Fault;
-                    //- TODO: get the xpix error 
-                    throw LIMA_HW_EXC(Error, "Error in imxpad_calibration_OTN_fast!");
+                    throw;
                 }
                 m_status = Camera::Ready;
             }
                 break;
 
-                //-----------------------------------------------------    
-            case XPAD_DLL_CALIBRATE_BEAM:
+                //-----------------------------------------------------	
+            case XPAD_DLL_SAVE_DACL:
             {
-                DEB_TRACE() <<"Camera::->XPAD_DLL_CALIBRATE_BEAM";
+                DEB_TRACE() <<"Camera::->XPAD_DLL_SAVE_DACL";
 
                 m_status = Camera::Calibrating;
 
-                if(imxpad_calibration_BEAM(m_modules_mask, (char*)m_calibration_path.c_str(), m_calib_texp, m_calib_ithl_max, m_calib_itune, m_calib_imfp) == 0)
+                try
                 {
-                    DEB_TRACE() << "imxpad_calibration_BEAM -> OK" ;
+                    saveDaclRows();
                 }
-                else
+                catch(Exception& e)
                 {
-                    Event *my_event = new Event(Hardware, Event::Error, Event::Camera, Event::Default, "imxpad_calibration_BEAM() : error for path: " + m_calibration_path);
-                    //DEB_EVENT(*my_event) << DEB_VAR1(*my_event);
+                    Event *my_event = new Event(Hardware, Event::Error, Event::Camera, Event::Default, "saveDacl() : error in xpci_modSaveConfigL");
                     reportEvent(my_event);
 
                     m_status = Camera::Fault;
-                    //- TODO: get the xpix error 
-                    throw LIMA_HW_EXC(Error, "Error in imxpad_calibration_BEAM!");
+                    throw;
                 }
                 m_status = Camera::Ready;
             }
                 break;
-                //-----------------------------------------------------    
-            case XPAD_DLL_CALIBRATE_OTN:
+
+                //-----------------------------------------------------	
+            case XPAD_DLL_CHECK_UNIFORMITY:
             {
-                DEB_TRACE() <<"Camera::->XPAD_DLL_CALIBRATE_OTN";
+                DEB_TRACE() <<"Camera::->XPAD_DLL_CHECK_UNIFORMITY";
 
+                //- after a failed upload
+                if(m_status != Camera::Ready)
+                {
+                    DEB_WARNING() << "Uniformity check skipped: the camera is not Ready";
+                    break;
+                }
                 m_status = Camera::Calibrating;
+                m_stop_asked = false;
 
-                if(imxpad_calibration_OTN(m_modules_mask, (char*)m_calibration_path.c_str(), m_calibration_adjusting_number, m_calib_itune, m_calib_imfp) == 0)
+                try
                 {
-                    DEB_TRACE() << "imxpad_calibration_OTN -> OK" ;
+                    runUniformityCheck();
                 }
-                else
+                catch(Exception& e)
                 {
-                    Event *my_event = new Event(Hardware, Event::Error, Event::Camera, Event::Default, "imxpad_calibration_OTN() : error for path: " + m_calibration_path);
-                    //DEB_EVENT(*my_event) << DEB_VAR1(*my_event);
+                    Event *my_event = new Event(Hardware, Event::Error, Event::Camera, Event::Default, "checkUniformity() : error in the flat field acquisition");
                     reportEvent(my_event);
 
                     m_status = Camera::Fault;
-                    //- TODO: get the xpix error 
-                    throw LIMA_HW_EXC(Error, "Error in imxpad_calibration_OTN!");
+                    throw;
                 }
                 m_status = Camera::Ready;
             }
                 break;
 
                 //-----------------------------------------------------	
-            case XPAD_DLL_UPLOAD_CALIBRATION:
+            case XPAD_DLL_CORRECT_DACL:
             {
-                DEB_TRACE() <<"Camera::->XPAD_DLL_UPLOAD_CALIBRATION";
+                DEB_TRACE() <<"Camera::->XPAD_DLL_CORRECT_DACL";
 
                 m_status = Camera::Calibrating;
 
-                if(imxpad_uploadCalibration(m_modules_mask, (char*)m_calibration_path.c_str()) == 0)
+                try
                 {
-                    DEB_TRACE() << "imxpad_uploadCalibration -> OK" ;
+                    correctDaclModules();
                 }
-                else
+                catch(Exception& e)
                 {
+                    Event *my_event = new Event(Hardware, Event::Error, Event::Camera, Event::Default, "correctDacl() : error in the DACL correction");
+                    reportEvent(my_event);
+
                     m_status = Camera::Fault;
-                    //- TODO: get the xpix error 
-                    throw LIMA_HW_EXC(Error, "Error in imxpad_uploadCalibration!");
+                    throw;
                 }
                 m_status = Camera::Ready;
             }
@@ -1171,19 +1507,93 @@ void Camera::setAcquisitionType(short acq_type)
     {
         m_geom_corr = 0;
 
-        if (m_maximage_size_cb_active)
+        notifyMaxImageSizeChanged();
+    }
+
+    DEB_TRACE() << "m_acquisition_type = " << m_acquisition_type  ;
+}
+
+//-----------------------------------------------------
+//		load the config G of all the chips (module x chip x register), only what changed
+//-----------------------------------------------------
+void Camera::setAllConfigG(const std::vector<long>& allConfigG)
+{
+    DEB_MEMBER_FUNCT();
+
+    int nb_modules = getNbModuleIds();
+    size_t expected_size = nb_modules * m_chip_number * CONFIG_G_NB_REGISTERS;
+    if(allConfigG.size() != expected_size)
+        THROW_HW_ERROR(InvalidValue) << "Config G size " << allConfigG.size() << " instead of " << expected_size
+                                     << " (modules x " << m_chip_number << " chips x " << CONFIG_G_NB_REGISTERS << " registers)";
+    for(size_t i = 0; i < allConfigG.size(); i++)
+        if(allConfigG[i] < 0)
+            THROW_HW_ERROR(InvalidValue) << "Negative config G value " << allConfigG[i] << " at index " << i;
+
+    Timestamp start = Timestamp::now();
+
+    //- chip mask of each module for each set of values, for the chips to change
+    typedef std::map<std::vector<long>, std::vector<unsigned long> > ChipMasks;
+    ChipMasks chip_masks;
+    for(int module = 0; module < nb_modules; module++)
+    {
+        if(!(m_modules_mask & (1U << module)))
+            continue;
+        for(unsigned int chip = 0; chip < m_chip_number; chip++)
         {
-            // only if the callaback is active
-            // inform lima about the size change
-            ImageType pixel_depth;
-            Size image_size;
-            getPixelDepth(pixel_depth); //- ie Bpp16 ...
-            getImageSize(image_size); //- size of image
-            maxImageSizeChanged(image_size, pixel_depth);
+            const long* values = &allConfigG[(module * m_chip_number + chip) * CONFIG_G_NB_REGISTERS];
+            long current[CONFIG_G_NB_REGISTERS];
+            if(m_calibration_cache.getConfigG(module, chip, current) &&
+               std::equal(values, values + CONFIG_G_NB_REGISTERS, current))
+                continue;
+            std::vector<unsigned long>& masks = chip_masks[std::vector<long>(values, values + CONFIG_G_NB_REGISTERS)];
+            masks.resize(nb_modules, 0);
+            SET(masks[module], chip);
         }
     }
 
-    DEB_TRACE() << "m_acquisition_type = " << m_acquisition_type  ;
+    //- one call per set of values and chip mask, for all the modules having this chip mask
+    int nb_calls = 0, nb_chips = 0;
+    for(ChipMasks::iterator it = chip_masks.begin(); it != chip_masks.end(); ++it)
+    {
+        const std::vector<long>& values = it->first;
+        std::vector<unsigned long>& masks = it->second;
+        for(int module = 0; module < nb_modules; module++)
+        {
+            unsigned long chip_mask = masks[module];
+            if(!chip_mask)
+                continue;
+            unsigned long module_mask = 0x00;
+            for(int other = module; other < nb_modules; other++)
+                if(masks[other] == chip_mask)
+                {
+                    SET(module_mask, other);
+                    masks[other] = 0;
+                    m_calibration_cache.invalidateChips(other);
+                    for(unsigned int chip = 0; chip < m_chip_number; chip++)
+                        if(GET(chip_mask, chip))
+                            m_calibration_cache.invalidateConfigG(other, chip);
+                }
+
+            if(xpci_modLoadAllConfigG(module_mask, chip_mask,
+                                      values[0], values[1], values[2], values[3], values[4], values[5],
+                                      values[6], values[7], values[8], values[9], values[10]) != 0)
+                THROW_HW_ERROR(Error) << "Error in xpci_modLoadAllConfigG for modules mask 0x" << std::hex << module_mask
+                                      << " and chips mask 0x" << chip_mask;
+            nb_calls++;
+
+            for(int other = module; other < nb_modules; other++)
+                for(unsigned int chip = 0; GET(module_mask, other) && chip < m_chip_number; chip++)
+                    if(GET(chip_mask, chip))
+                    {
+                        m_calibration_cache.setConfigG(other, chip, &values[0]);
+                        nb_chips++;
+                    }
+        }
+    }
+
+    m_all_config_g = allConfigG;
+    double elapsed_sec = Timestamp::now() - start;
+    DEB_TRACE() << "Config G loaded: " << DEB_VAR3(nb_chips, nb_calls, elapsed_sec);
 }
 
 //-----------------------------------------------------
@@ -1193,7 +1603,9 @@ void Camera::loadFlatConfig(unsigned flat_value)
 {
     DEB_MEMBER_FUNCT();
 
-    unsigned int all_chips_mask = 0x7F;
+    unsigned int all_chips_mask = (1U << m_chip_number) - 1;
+    m_calibration_cache.invalidateChips(-1);
+    m_calibration_cache.invalidateDacl(-1);
     if (xpci_modLoadFlatConfig(m_modules_mask, all_chips_mask, flat_value) == 0)
     {
         DEB_TRACE() << "loadFlatConfig, with value: " <<  flat_value << " -> OK" ;
@@ -1217,6 +1629,8 @@ void Camera::loadAllConfigG(unsigned long modNum, unsigned long chipId , unsigne
     SET(mask_local_module, (modNum-1)); // minus 1 because modNum start at 1
     unsigned long mask_local_chip = 0x00;
     SET(mask_local_chip, (chipId-1)); // minus 1 because chipId start at 1
+    m_calibration_cache.invalidateChips(modNum - 1);
+    m_calibration_cache.invalidateConfigG(modNum - 1, chipId - 1);
 
     if(xpci_modLoadAllConfigG(mask_local_module, mask_local_chip,
                               config_values[0], //- CMOS_TP
@@ -1234,6 +1648,9 @@ void Camera::loadAllConfigG(unsigned long modNum, unsigned long chipId , unsigne
     {
         DEB_TRACE() << "loadAllConfigG for module " << modNum  << ", and chip " << chipId << " -> OK" ;
         DEB_TRACE() << "(loadAllConfigG for mask_local_module " << mask_local_module  << ", and mask_local_chip " << mask_local_chip << " )" ;
+        long values[CONFIG_G_NB_REGISTERS];
+        std::copy(config_values, config_values + CONFIG_G_NB_REGISTERS, values);
+        m_calibration_cache.setConfigG(modNum - 1, chipId - 1, values);
     }
     else
     {
@@ -1254,10 +1671,20 @@ void Camera::loadConfigG(unsigned long modNum, unsigned long chipId , unsigned l
     SET(mask_local_module, (modNum-1)); // -1 because modNum start at 1
     unsigned long mask_local_chip = 0x00;
     SET(mask_local_chip, (chipId-1)); // -1 because chipId start at 1
+    m_calibration_cache.invalidateChips(modNum - 1);
+    long config_g[CONFIG_G_NB_REGISTERS];
+    bool config_g_known = m_calibration_cache.getConfigG(modNum - 1, chipId - 1, config_g);
+    m_calibration_cache.invalidateConfigG(modNum - 1, chipId - 1);
 
     if(xpci_modLoadConfigG(mask_local_module, mask_local_chip, reg_id, reg_value)==0)
     {
         DEB_TRACE() << "loadConfigG: Register 0x" << std::hex << reg_id << ", with value: " << std::dec << reg_value << " -> OK" ;
+        const unsigned int* reg = std::find(CONFIG_G_REGISTERS, CONFIG_G_REGISTERS + CONFIG_G_NB_REGISTERS, reg_id);
+        if(config_g_known && reg != CONFIG_G_REGISTERS + CONFIG_G_NB_REGISTERS)
+        {
+            config_g[reg - CONFIG_G_REGISTERS] = reg_value;
+            m_calibration_cache.setConfigG(modNum - 1, chipId - 1, config_g);
+        }
     }
     else
     {
@@ -1296,6 +1723,7 @@ void Camera::saveConfigL(unsigned long modNum, unsigned long calibId, unsigned l
     SET(mask_local, (modNum-1)); // -1 because modNum start at 1
     //- because start at 1 at high level and 0 at low level
     chipId = chipId - 1;
+    m_calibration_cache.invalidateSlot(calibId, modNum - 1);
 
     //- Call the xpix fonction
     if(xpci_modSaveConfigL(mask_local, calibId, chipId, curRow, (unsigned int*) values) == 0)
@@ -1308,6 +1736,107 @@ void Camera::saveConfigL(unsigned long modNum, unsigned long calibId, unsigned l
     }
 }
 
+//-----------------------------------------------------
+//		Save a whole DACL to XPAD RAM
+//-----------------------------------------------------
+void Camera::saveDacl(unsigned long calibId, const unsigned short* dacl, long size)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(calibId, size);
+
+    if(m_status != Camera::Ready)
+        throw LIMA_HW_EXC(Error, "The DACL can only be saved when the camera is Ready");
+    long expected_size = (long)getNbModuleIds() * m_chip_number * CHIP_NB_ROW * CHIP_NB_COLUMN;
+    if(size != expected_size)
+        THROW_HW_ERROR(InvalidValue) << "DACL size " << size << " instead of " << expected_size
+                                     << " (modules x " << m_chip_number << " chips x " << CHIP_NB_ROW << " rows x " << CHIP_NB_COLUMN << " columns)";
+
+    m_dacl_upload.assign(dacl, dacl + size);
+    m_dacl_upload_calib_id = calibId;
+    m_dacl_upload_modules_mask = m_modules_mask;
+    {
+        AutoMutex lock(m_dacl_upload_lock);
+        m_dacl_upload_nb_rows_done = 0;
+        m_dacl_upload_nb_rows = m_module_number * m_chip_number * CHIP_NB_ROW;
+        m_dacl_upload_nb_calls = 0;
+        m_dacl_upload_elapsed_sec = 0;
+    }
+
+    this->post(new yat::Message(XPAD_DLL_SAVE_DACL), kPOST_MSG_TMO);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getDaclUploadProgress(int& nb_rows_done, int& nb_rows, int& nb_calls, double& rows_per_sec)
+{
+    DEB_MEMBER_FUNCT();
+
+    AutoMutex lock(m_dacl_upload_lock);
+    nb_rows_done = m_dacl_upload_nb_rows_done;
+    nb_rows = m_dacl_upload_nb_rows;
+    nb_calls = m_dacl_upload_nb_calls;
+    rows_per_sec = m_dacl_upload_elapsed_sec > 0 ? nb_rows_done / m_dacl_upload_elapsed_sec : 0;
+    DEB_RETURN() << DEB_VAR4(nb_rows_done, nb_rows, nb_calls, rows_per_sec);
+}
+
+//-----------------------------------------------------
+//		one xpci_modSaveConfigL per chip row for all the modules having the same values
+//-----------------------------------------------------
+void Camera::saveDaclRows()
+{
+    DEB_MEMBER_FUNCT();
+
+    Timestamp upload_start = Timestamp::now();
+    int nb_modules = getNbModuleIds();
+    long chip_size = (long)CHIP_NB_ROW * CHIP_NB_COLUMN;
+    long module_size = m_chip_number * chip_size;
+    const unsigned short* dacl = &m_dacl_upload[0];
+    for(int module = 0; module < nb_modules; module++)
+        if(m_dacl_upload_modules_mask & (1U << module))
+            m_calibration_cache.invalidateSlot(m_dacl_upload_calib_id, module);
+
+    unsigned int values[CHIP_NB_COLUMN];
+    for(unsigned int chip = 0; chip < m_chip_number; chip++)
+        for(int row = 0; row < CHIP_NB_ROW; row++)
+        {
+            long offset = chip * chip_size + row * CHIP_NB_COLUMN;
+            unsigned int saved_modules = 0;
+            for(int module = 0; module < nb_modules; module++)
+            {
+                if(!(m_dacl_upload_modules_mask & (1U << module)) || (saved_modules & (1U << module)))
+                    continue;
+                const unsigned short* module_row = dacl + module * module_size + offset;
+                unsigned long mask_local = 0x00;
+                SET(mask_local, module);
+                int nb_rows = 1;
+                for(int other = module + 1; other < nb_modules; other++)
+                    if((m_dacl_upload_modules_mask & (1U << other)) &&
+                       memcmp(module_row, dacl + other * module_size + offset, CHIP_NB_COLUMN * sizeof(unsigned short)) == 0)
+                    {
+                        SET(mask_local, other);
+                        nb_rows++;
+                    }
+                saved_modules |= mask_local;
+
+                std::copy(module_row, module_row + CHIP_NB_COLUMN, values);
+                if(xpci_modSaveConfigL(mask_local, m_dacl_upload_calib_id, chip, row, values) != 0)
+                    THROW_HW_ERROR(Error) << "Error in xpci_modSaveConfigL for modules mask 0x" << std::hex << mask_local
+                                          << std::dec << " chip " << chip + 1 << " row " << row;
+
+                AutoMutex lock(m_dacl_upload_lock);
+                m_dacl_upload_nb_rows_done += nb_rows;
+                m_dacl_upload_nb_calls++;
+                m_dacl_upload_elapsed_sec = Timestamp::now() - upload_start;
+            }
+        }
+
+    AutoMutex lock(m_dacl_upload_lock);
+    m_dacl_upload_elapsed_sec = Timestamp::now() - upload_start;
+    DEB_TRACE() << "DACL saved to calib " << m_dacl_upload_calib_id << ": "
+                << DEB_VAR3(m_dacl_upload_nb_rows_done, m_dacl_upload_nb_calls, m_dacl_upload_elapsed_sec);
+}
+
 //-----------------------------------------------------
 //		Save the config G to XPAD RAM
 //-----------------------------------------------------
@@ -1319,6 +1848,7 @@ void Camera::saveConfigG(unsigned long modNum, unsigned long calibId, unsigned l
     //- eg: if modNum = 4, mask_local = 8
     unsigned long mask_local = 0x00;
     SET(mask_local, (modNum-1)); // -1 because modNum start at 1
+    m_calibration_cache.invalidateSlot(calibId, modNum - 1);
 
     //- Call the xpix fonction
     if(xpci_modSaveConfigG(mask_local, calibId, reg, (unsigned int*) values) == 0)
@@ -1342,11 +1872,14 @@ void Camera::loadConfig(unsigned long modNum, unsigned long calibId)
     //- eg: if modNum = 4, mask_local = 8
     unsigned long mask_local = 0x00;
     SET(mask_local, (modNum-1)); // -1 because modNum start at 1
+    m_calibration_cache.invalidateChips(modNum - 1);
+    m_calibration_cache.invalidateDacl(modNum - 1);
 
     //- Call the xpix fonction
     if(xpci_modDetLoadConfig(mask_local, calibId) == 0)
     {
         DEB_TRACE() << "loadConfig for module: " << modNum << " | calibID: " << calibId << " -> OK" ;
+        m_calibration_cache.setModuleLoaded(calibId, modNum - 1);
     }
     else
     {
@@ -1361,7 +1894,8 @@ unsigned short*& Camera::getModConfig()
 {
     DEB_MEMBER_FUNCT();
 
-    /*DEB_TRACE() << "Lima::Camera::getModConfig -> xpci_getModConfig -> 1" ;
+    if(!m_dacl)
+        throw LIMA_HW_EXC(Error, "No module found: no DACL to read");
     //- Call the xpix fonction
     if(xpci_getModConfig(m_modules_mask,m_chip_number,m_dacl) == 0)
     {
@@ -1369,11 +1903,56 @@ unsigned short*& Camera::getModConfig()
     }
     else
     {
+        m_calibration_cache.invalidateDacl(-1);
         throw LIMA_HW_EXC(Error, "Error in xpci_getModConfig!");
     }
-    DEB_TRACE() << "Lima::Camera::getModConfig -> xpci_getModConfig -> 2" ;
 
-    return m_dacl;*/
+    //- the DACL is the raw image: modules from top to bottom, chips from left to right
+    int width = CHIP_NB_COLUMN * m_chip_number;
+    std::vector<uint16_t> chip_dacl(CHIP_NB_ROW * CHIP_NB_COLUMN);
+    int module_index = 0;
+    for(int module = 0; module < getNbModuleIds(); module++)
+    {
+        if(!(m_modules_mask & (1U << module)))
+            continue;
+        for(unsigned int chip = 0; chip < m_chip_number; chip++)
+        {
+            for(int row = 0; row < CHIP_NB_ROW; row++)
+            {
+                const unsigned short* dacl = m_dacl + (module_index * CHIP_NB_ROW + row) * width + chip * CHIP_NB_COLUMN;
+                std::copy(dacl, dacl + CHIP_NB_COLUMN, &chip_dacl[row * CHIP_NB_COLUMN]);
+            }
+            m_calibration_cache.setDaclChecksum(module, chip, CalibrationCache::checksum(&chip_dacl[0]));
+        }
+        module_index++;
+    }
+
+    return m_dacl;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getDacl(std::vector<unsigned short>& dacl)
+{
+    DEB_MEMBER_FUNCT();
+
+    unsigned short* mod_config = getModConfig();
+    dacl.assign(mod_config, mod_config + CHIP_NB_COLUMN * m_chip_number * CHIP_NB_ROW * m_module_number);
+}
+
+//-----------------------------------------------------
+//		the chips DACL (readback or cached upload) and config G are the calibration ones
+//-----------------------------------------------------
+bool Camera::isCalibrationLoaded(const std::string& path)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(path);
+
+    const CalibrationCache::Calibration calibration = m_calibration_cache.get(path, getNbModuleIds(), m_chip_number);
+    bool loaded = m_calibration_cache.isLoaded(calibration, m_modules_mask);
+    DEB_RETURN() << DEB_VAR1(loaded);
+    return loaded;
 }
 
 //-----------------------------------------------------
@@ -1383,6 +1962,7 @@ void Camera::reset()
 {
     DEB_MEMBER_FUNCT();
     unsigned int ALL_MODULES = 0xFF;
+    m_calibration_cache.invalidateAll();
     if(xpci_modRebootNIOS(ALL_MODULES) == 0)
     {
         DEB_TRACE() << "reset -> xpci_modRebootNIOS -> OK" ;
@@ -1401,6 +1981,7 @@ void Camera::calibrateOTNSlow ( const std::string& path)
     DEB_MEMBER_FUNCT();
 
     m_calibration_path = path;
+    m_calibration_cancel = false;
 
     this->post(new yat::Message(XPAD_DLL_CALIBRATE_OTN_SLOW), kPOST_MSG_TMO);
 }
@@ -1413,6 +1994,7 @@ void Camera::calibrateOTNMedium ( const std::string& path)
     DEB_MEMBER_FUNCT();
 
     m_calibration_path = path;
+    m_calibration_cancel = false;
 
     this->post(new yat::Message(XPAD_DLL_CALIBRATE_OTN_MEDIUM), kPOST_MSG_TMO);
 }
@@ -1425,6 +2007,7 @@ void Camera::calibrateOTNFast ( const std::string& path)
     DEB_MEMBER_FUNCT();
 
     m_calibration_path = path;
+    m_calibration_cancel = false;
 
     this->post(new yat::Message(XPAD_DLL_CALIBRATE_OTN_FAST), kPOST_MSG_TMO);
 }
@@ -1441,6 +2024,7 @@ void Camera::calibrateBeam ( const std::string& path, unsigned int texp, unsigne
     m_calib_ithl_max	= ithl_max;
     m_calib_itune		= itune;
     m_calib_imfp		= imfp;
+    m_calibration_cancel = false;
 
     this->post(new yat::Message(XPAD_DLL_CALIBRATE_BEAM), kPOST_MSG_TMO);
 }
@@ -1455,208 +2039,2160 @@ void Camera::calibrateOTN ( const std::string& path, unsigned int itune, unsigne
     m_calibration_path	= path;
     m_calib_itune		= itune;
     m_calib_imfp		= imfp;
+    m_calibration_cancel = false;
 
     this->post(new yat::Message(XPAD_DLL_CALIBRATE_OTN), kPOST_MSG_TMO);
 }
 
 //-----------------------------------------------------
-//		upload a calibration
+//		modules of the next calibrations
 //-----------------------------------------------------
-void Camera::uploadCalibration(const std::string& path)
+void Camera::setCalibrationModules(unsigned long modules_mask)
 {
     DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(modules_mask);
 
-    m_calibration_path = path;
-
-    this->post(new yat::Message(XPAD_DLL_UPLOAD_CALIBRATION), kPOST_MSG_TMO);
+    if(modules_mask & ~m_modules_mask)
+        THROW_HW_ERROR(InvalidValue) << "Modules mask 0x" << std::hex << modules_mask
+                                     << " should be a subset of the detector modules mask 0x" << m_modules_mask;
+    m_calibration_modules_mask = modules_mask;
 }
 
 //-----------------------------------------------------
-//		upload the wait times between images
+//		abort the exposures of the running calibration
 //-----------------------------------------------------
-void Camera::uploadExpWaitTimes(unsigned long *pWaitTime, unsigned size)
+void Camera::cancelCalibration()
 {
     DEB_MEMBER_FUNCT();
 
-    //- Check the number of values
-    if (size != m_nb_frames)
-    {
-        throw LIMA_HW_EXC(Error, "Error in uploadExpWaitTimes: number of values does not correspond to number of images");
-    }
-
-    if(imxpad_uploadExpWaitTimes(m_modules_mask, (unsigned int*)pWaitTime, size) == 0)
-    {
-        DEB_TRACE() << "uploadExpWaitTimes -> imxpad_uploadExpWaitTimes -> OK" ;
-    }
-    else
-    {
-        throw LIMA_HW_EXC(Error, "Error in imxpad_uploadExpWaitTimes!");
-    }
+    m_calibration_cancel = true;
+    if(m_calibration_running)
+        xpci_modAbortExposure();
 }
 
 //-----------------------------------------------------
-//		increment the ITHL
+//
 //-----------------------------------------------------
-void Camera::incrementITHL()
+void Camera::getCalibrationProgress(int& nb_modules_done, int& nb_modules, double& elapsed_sec)
 {
     DEB_MEMBER_FUNCT();
 
-    if(imxpad_incrITHL(m_modules_mask) == 0)
-    {
-        DEB_TRACE() << "incrementITHL -> imxpad_incrITHL -> OK" ;
-    }
-    else
-    {
-        throw LIMA_HW_EXC(Error, "Error in imxpad_incrITHL!");
-    }
+    AutoMutex lock(m_calibration_progress_lock);
+    nb_modules_done = m_calibration_nb_modules_done;
+    nb_modules = m_calibration_nb_modules;
+    //- xpix gives no progress during the call: the elapsed time runs while calibrating
+    elapsed_sec = m_calibration_running ? double(Timestamp::now() - m_calibration_start) : m_calibration_elapsed_sec;
+    DEB_RETURN() << DEB_VAR3(nb_modules_done, nb_modules, elapsed_sec);
 }
 
 //-----------------------------------------------------
-//		decrement the ITHL
+//		update the progress and publish it as a lima event
 //-----------------------------------------------------
-void Camera::decrementITHL()
+void Camera::reportCalibrationProgress(const char* name, int nb_modules_done, int nb_modules, double elapsed_sec)
 {
     DEB_MEMBER_FUNCT();
 
-    if(imxpad_decrITHL(m_modules_mask) == 0)
     {
-        DEB_TRACE() << "decrementITHL -> imxpad_decrITHL -> OK" ;
+        AutoMutex lock(m_calibration_progress_lock);
+        m_calibration_nb_modules_done = nb_modules_done;
+        m_calibration_nb_modules = nb_modules;
+        m_calibration_elapsed_sec = elapsed_sec;
     }
-    else
+
+    std::ostringstream message;
+    message << name << "() : " << nb_modules_done << "/" << nb_modules << " modules done, elapsed " << elapsed_sec << " s";
+    DEB_TRACE() << message.str();
+    Event *my_event = new Event(Hardware, Event::Info, Event::Camera, Event::Default, message.str());
+    reportEvent(my_event);
+}
+
+//-----------------------------------------------------
+//		the chips hold the calibration of path (e.g. after a full upload): export it in the cache layout
+//-----------------------------------------------------
+void Camera::exportCalibration(const std::string& path)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(path);
+
+    if(m_status != Camera::Ready)
+        throw LIMA_HW_EXC(Error, "The calibration can only be exported when the camera is Ready");
+    //- the config G can not be read back: it is known once loaded by the plugin
+    std::vector<long> config_g;
+    if(!getKnownConfigG(config_g))
+        throw LIMA_HW_EXC(Error, "Config G of the chips unknown: load it (setAllConfigG, loadAllConfigG) before the export");
+
+    AutoMutex hw_lock(m_hw_lock);
+    const unsigned short* mod_config = getModConfig();
+
+    //- the DACL is the raw image: modules of the mask from top to bottom, chips from left to right
+    CalibrationCache::Calibration calibration;
+    calibration.path = path;
+    calibration.nb_modules = getNbModuleIds();
+    calibration.nb_chips = m_chip_number;
+    calibration.dacl.assign((long)calibration.nb_modules * m_chip_number * CHIP_NB_ROW * CHIP_NB_COLUMN, 0);
+    calibration.config_g.assign(config_g.begin(), config_g.end());
+    int width = CHIP_NB_COLUMN * m_chip_number;
+    int module_index = 0;
+    for(int module = 0; module < calibration.nb_modules; module++)
+    {
+        if(!(m_modules_mask & (1U << module)))
+            continue;
+        for(unsigned int chip = 0; chip < m_chip_number; chip++)
+            for(int row = 0; row < CHIP_NB_ROW; row++)
+            {
+                const unsigned short* dacl = mod_config + (module_index * CHIP_NB_ROW + row) * width + chip * CHIP_NB_COLUMN;
+                std::copy(dacl, dacl + CHIP_NB_COLUMN, const_cast<uint16_t*>(calibration.getDaclRow(module, chip, row)));
+            }
+        module_index++;
+    }
+    CalibrationCache::write(path, calibration);
+    DEB_TRACE() << "Calibration of the chips exported in " << path;
+}
+
+//-----------------------------------------------------
+//		xpix calibration of the modules in the mask, files in path
+//-----------------------------------------------------
+int Camera::calibrateModule(CalibrationType type, unsigned int module_mask, const std::string& path)
+{
+    switch(type)
+    {
+        case CALIBRATION_OTN_SLOW:
+            return imxpad_calibration_OTN_slow(module_mask, (char*)path.c_str(), m_calibration_adjusting_number);
+        case CALIBRATION_OTN_MEDIUM:
+            return imxpad_calibration_OTN_medium(module_mask, (char*)path.c_str(), m_calibration_adjusting_number);
+        case CALIBRATION_OTN_FAST:
+            return imxpad_calibration_OTN_fast(module_mask, (char*)path.c_str(), m_calibration_adjusting_number);
+        case CALIBRATION_BEAM:
+            return imxpad_calibration_BEAM(module_mask, (char*)path.c_str(), m_calib_texp, m_calib_ithl_max, m_calib_itune, m_calib_imfp);
+        case CALIBRATION_OTN:
+            return imxpad_calibration_OTN(module_mask, (char*)path.c_str(), m_calibration_adjusting_number, m_calib_itune, m_calib_imfp);
+    }
+    return -1;
+}
+
+//-----------------------------------------------------
+//		xpix calibration of the requested modules, all together in one call (files written by xpix in path)
+//-----------------------------------------------------
+void Camera::runCalibration(CalibrationType type)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(type);
+
+    static const char* names[] = {"imxpad_calibration_OTN_slow", "imxpad_calibration_OTN_medium", "imxpad_calibration_OTN_fast",
+                                  "imxpad_calibration_BEAM", "imxpad_calibration_OTN"};
+    const char* name = names[type];
+
+    m_status = Camera::Calibrating;
+    m_calibration_cache.invalidateAll();
+
+    unsigned long modules_mask = m_calibration_modules_mask ? m_calibration_modules_mask : m_modules_mask;
+    int nb_modules = 0;
+    for(int module = 0; module < getNbModuleIds(); module++)
+        if(modules_mask & (1U << module))
+            nb_modules++;
+    m_calibration_start = Timestamp::now();
+    if(m_calibration_cancel)
+    {
+        DEB_WARNING() << name << " cancelled before its start";
+        m_status = Camera::Ready;
+        return;
+    }
+    reportCalibrationProgress(name, 0, nb_modules, 0);
+
+    m_calibration_running = true;
+    if(calibrateModule(type, modules_mask, m_calibration_path) != 0 && !m_calibration_cancel)
+    {
+        m_calibration_running = false;
+        Event *my_event = new Event(Hardware, Event::Error, Event::Camera, Event::Default, std::string(name) + "() : error for path: " + m_calibration_path);
+        //DEB_EVENT(*my_event) << DEB_VAR1(*my_event);
+        reportEvent(my_event);
+
+        m_status = Camera::Fault;
+        //- TODO: get the xpix error
+        THROW_HW_ERROR(Error) << "Error in " << name << " for modules mask 0x" << std::hex << modules_mask << "!";
+    }
+    m_calibration_running = false;
+
+    if(m_calibration_cancel)
+    {
+        reportCalibrationProgress(name, 0, nb_modules, Timestamp::now() - m_calibration_start);
+        DEB_WARNING() << name << " cancelled: the content of " << m_calibration_path << " is the one left by xpix";
+    }
+    else
+    {
+        DEB_TRACE() << name << " -> OK for modules mask 0x" << std::hex << modules_mask;
+        reportCalibrationProgress(name, nb_modules, nb_modules, Timestamp::now() - m_calibration_start);
+    }
+    m_status = Camera::Ready;
+}
+
+//-----------------------------------------------------
+//		upload a calibration
+//-----------------------------------------------------
+void Camera::uploadCalibration(const std::string& path)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_calibration_path = path;
+
+    this->post(new yat::Message(XPAD_DLL_UPLOAD_CALIBRATION), kPOST_MSG_TMO);
+    if(m_uniformity_check_after_upload)
+        this->post(new yat::Message(XPAD_DLL_CHECK_UNIFORMITY), kPOST_MSG_TMO);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setUniformityCheckAcquisition(int nb_frames, double exp_time_sec)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_uniformity_check.setAcquisition(nb_frames, exp_time_sec);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setUniformityCheckLimits(double k_sigma, double max_outlier_fraction, double max_rms_ratio, double max_mean_deviation)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_uniformity_check.setLimits(k_sigma, max_outlier_fraction, max_rms_ratio, max_mean_deviation);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setUniformityCheckAfterUpload(bool uniformity_check_after_upload)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(uniformity_check_after_upload);
+
+    m_uniformity_check_after_upload = uniformity_check_after_upload;
+}
+
+//-----------------------------------------------------
+//		flat field acquisition and check of the chips
+//-----------------------------------------------------
+void Camera::checkUniformity()
+{
+    DEB_MEMBER_FUNCT();
+
+    if(m_status != Camera::Ready)
+        throw LIMA_HW_EXC(Error, "The uniformity check can only be run when the camera is Ready");
+
+    this->post(new yat::Message(XPAD_DLL_CHECK_UNIFORMITY), kPOST_MSG_TMO);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+bool Camera::getUniformityReport(bool& passed, std::string& report)
+{
+    DEB_MEMBER_FUNCT();
+
+    bool checked = m_uniformity_check.getPassed(passed);
+    report = m_uniformity_check.getReport();
+    DEB_RETURN() << DEB_VAR2(checked, passed);
+    return checked;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getUniformityChipResults(std::vector<UniformityCheck::ChipResult>& results)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_uniformity_check.getChipResults(results);
+}
+
+//-----------------------------------------------------
+//		short flat field acquisition (16 bits, internal trigger, not published)
+//-----------------------------------------------------
+void Camera::runUniformityCheck()
+{
+    DEB_MEMBER_FUNCT();
+
+    int nb_frames;
+    double exp_time_sec;
+    m_uniformity_check.getAcquisition(nb_frames, exp_time_sec);
+    int width = CHIP_NB_COLUMN * m_chip_number;
+    int height = CHIP_NB_ROW * m_module_number;
+    long nb_pixels = (long)width * height;
+
+    //- the next prepare sets the exposure parameters of the acquisitions again
+    setExposureParameters(	(unsigned)(exp_time_sec * 1e6),
+                          m_time_between_images_usec,
+                          m_time_before_start_usec,
+                          m_shutter_time_usec,
+                          m_ovf_refresh_time_usec,
+                          0, //- internal trigger
+                          m_specific_param_n,
+                          m_specific_param_p,
+                          nb_frames,
+                          m_busy_out_sel,
+                          0, //- 16 bits
+                          XPIX_NOT_USED_YET, //- postProc
+                          m_specific_param_GP1,
+                          m_specific_param_GP2,
+                          m_specific_param_GP3,
+                          m_specific_param_GP4);
+
+    std::vector<uint16_t> frames(nb_frames * nb_pixels);
+    std::vector<void*> frame_array(nb_frames);
+    for(int i = 0; i < nb_frames; i++)
+        frame_array[i] = &frames[i * nb_pixels];
+
+    Timestamp check_start = Timestamp::now();
+    if(xpci_getImgSeq(	B2,
+                        m_modules_mask,
+                        m_chip_number,
+                        nb_frames,
+                        &frame_array[0],
+                        XPIX_V1_COMPATIBILITY,
+                        XPIX_V1_COMPATIBILITY,
+                        XPIX_V1_COMPATIBILITY,
+                        XPIX_V1_COMPATIBILITY) == -1)
+    {
+        if(m_stop_asked)
+        {
+            DEB_WARNING() << "Uniformity check stopped";
+            return;
+        }
+        throw LIMA_HW_EXC(Error, "xpci_getImgSeq has returned an error ! ");
+    }
+
+    //- pixel mean counts per frame with the pixel statistics (SSE2, threads)
+    m_uniformity_statistics.setActive(true);
+    m_uniformity_statistics.prepare(Size(width, height));
+    for(int i = 0; i < nb_frames; i++)
+        m_uniformity_statistics.process(&frames[i * nb_pixels]);
+    std::vector<float> mean;
+    m_uniformity_statistics.getMean(mean);
+
+    std::vector<int> module_ids;
+    for(int module = 0; module < getNbModuleIds(); module++)
+        if(m_modules_mask & (1U << module))
+            module_ids.push_back(module);
+    m_uniformity_check.check(mean, nb_frames, width, height, module_ids);
+    DEB_TRACE() << "Uniformity check done in " << Timestamp::now() - check_start << " sec";
+
+    bool passed;
+    m_uniformity_check.getPassed(passed);
+    Event *my_event = new Event(Hardware, passed ? Event::Info : Event::Warning, Event::Camera, Event::Default,
+                                m_uniformity_check.getReport());
+    reportEvent(my_event);
+}
+
+//-----------------------------------------------------
+//		enable/disable the calibration cache
+//-----------------------------------------------------
+void Camera::setCalibrationCache(bool calibration_cache)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(calibration_cache);
+
+    m_calibration_cache_active = calibration_cache;
+    if(!calibration_cache)
+        m_calibration_cache.clear();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::clearCalibrationCache()
+{
+    DEB_MEMBER_FUNCT();
+
+    m_calibration_cache.clear();
+    m_calibration_cache.invalidateAll();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getCalibrationUploadStats(int& nb_rows, int& nb_registers, double& elapsed_sec)
+{
+    DEB_MEMBER_FUNCT();
+
+    nb_rows = m_calibration_upload_nb_rows;
+    nb_registers = m_calibration_upload_nb_registers;
+    elapsed_sec = m_calibration_upload_elapsed_sec;
+    DEB_RETURN() << DEB_VAR3(nb_rows, nb_registers, elapsed_sec);
+}
+
+//-----------------------------------------------------
+//		modules are numbered up to the last module of the mask
+//-----------------------------------------------------
+int Camera::getNbModuleIds()
+{
+    int nb_modules = 0;
+    while(nb_modules < 32 && (m_modules_mask >> nb_modules) != 0)
+        nb_modules++;
+    return nb_modules;
+}
+
+//-----------------------------------------------------
+//		save to the calib RAM only what differs, then load the modules which changed
+//-----------------------------------------------------
+void Camera::uploadCachedCalibration(const std::string& path, int calib_id)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(path, calib_id);
+
+    Timestamp upload_start = Timestamp::now();
+    int nb_modules = getNbModuleIds();
+    const CalibrationCache::Calibration calibration = m_calibration_cache.get(path, nb_modules, m_chip_number);
+
+    int nb_rows = 0, nb_registers = 0;
+    unsigned long load_mask = 0x00;
+    //- the modules failing the verification are saved completely once more
+    for(int attempt = 0; ; attempt++)
+    {
+        //- the diff of the whole calibration is computed before anything is sent
+        std::vector<std::vector<int> > rows(nb_modules), registers(nb_modules);
+        unsigned long save_mask = 0x00;
+        load_mask = 0x00;
+        for(int module = 0; module < nb_modules; module++)
+        {
+            if(!(m_modules_mask & (1U << module)))
+                continue;
+            if(!m_calibration_cache.isModuleSaved(calibration, calib_id, module))
+            {
+                diffCalibrationModule(calibration, calib_id, module, rows[module], registers[module]);
+                if(!rows[module].empty() || !registers[module].empty())
+                    SET(save_mask, module);
+            }
+            if(GET(save_mask, module) || m_calibration_cache.getLoadedSlot(module) != calib_id)
+                SET(load_mask, module);
+        }
+
+        //- then only the changed rows and registers are saved
+        for(int module = 0; module < nb_modules; module++)
+            if(GET(save_mask, module))
+            {
+                saveCalibrationRows(calibration, calib_id, module, rows[module], registers[module]);
+                nb_rows += rows[module].size();
+                nb_registers += registers[module].size();
+            }
+
+        //- and the modules which changed are loaded
+        if(!load_mask)
+            break;
+        for(int module = 0; module < nb_modules; module++)
+            if(GET(load_mask, module))
+            {
+                m_calibration_cache.invalidateChips(module);
+                m_calibration_cache.invalidateDacl(module);
+            }
+        if(xpci_modDetLoadConfig(load_mask, calib_id) != 0)
+            THROW_HW_ERROR(Error) << "Error in xpci_modDetLoadConfig for modules mask 0x" << std::hex << load_mask;
+        for(int module = 0; module < nb_modules; module++)
+            if(GET(load_mask, module))
+                m_calibration_cache.setModuleLoaded(calib_id, module);
+
+        unsigned long bad_mask = verifyLoadedModules(calibration, calib_id, load_mask);
+        if(!bad_mask)
+            break;
+        if(attempt > 0)
+            THROW_HW_ERROR(Error) << "Calibration " << path << " not loaded from calibId " << calib_id
+                                  << " for modules mask 0x" << std::hex << bad_mask << " (DACL read back differs)";
+        DEB_WARNING() << "Calibration " << path << ": calibId " << calib_id << " saved again for modules mask 0x" << std::hex << bad_mask;
+    }
+
+    m_calibration_upload_nb_rows = nb_rows;
+    m_calibration_upload_nb_registers = nb_registers;
+    m_calibration_upload_elapsed_sec = Timestamp::now() - upload_start;
+    DEB_TRACE() << "Cached calibration uploaded: " << DEB_VAR4(nb_rows, nb_registers, load_mask, m_calibration_upload_elapsed_sec);
+}
+
+//-----------------------------------------------------
+//		DACL read back after a load: the modules whose chips do not hold the calibration, their calib RAM content is unknown
+//-----------------------------------------------------
+unsigned long Camera::verifyLoadedModules(const CalibrationCache::Calibration& calibration, int calib_id, unsigned long load_mask)
+{
+    DEB_MEMBER_FUNCT();
+
+    //- the readback updates the DACL checksums of all the chips
+    getModConfig();
+    unsigned long bad_mask = 0x00;
+    for(int module = 0; module < calibration.nb_modules; module++)
+    {
+        if(!GET(load_mask, module))
+            continue;
+        for(unsigned int chip = 0; chip < m_chip_number; chip++)
+        {
+            uint32_t checksum;
+            if(!m_calibration_cache.getDaclChecksum(module, chip, checksum) ||
+               checksum != calibration.checksums[module * m_chip_number + chip])
+            {
+                SET(bad_mask, module);
+                break;
+            }
+        }
+        if(GET(bad_mask, module))
+        {
+            DEB_WARNING() << "DACL read back of module " << module + 1 << " differs from calibId " << calib_id;
+            m_calibration_cache.invalidateSlot(calib_id, module);
+            m_calibration_cache.invalidateConfigG(module, -1);
+        }
+    }
+    DEB_RETURN() << DEB_VAR1(bad_mask);
+    return bad_mask;
+}
+
+//-----------------------------------------------------
+//		DACL rows (chip x row) and config G registers of a module which differ from the calib RAM
+//-----------------------------------------------------
+void Camera::diffCalibrationModule(const CalibrationCache::Calibration& calibration, int calib_id, int module,
+                                   std::vector<int>& rows, std::vector<int>& registers)
+{
+    rows.clear();
+    registers.clear();
+    for(unsigned int chip = 0; chip < m_chip_number; chip++)
+        for(int row = 0; row < CHIP_NB_ROW; row++)
+            if(!m_calibration_cache.isRowSaved(calibration, calib_id, module, chip, row))
+                rows.push_back(chip * CHIP_NB_ROW + row);
+    for(int reg = 0; reg < CONFIG_G_NB_REGISTERS; reg++)
+        if(!m_calibration_cache.isRegisterSaved(calibration, calib_id, module, reg))
+            registers.push_back(reg);
+}
+
+//-----------------------------------------------------
+//		save the DACL rows and config G registers of a module which differ from the calib RAM
+//-----------------------------------------------------
+bool Camera::saveCalibrationModule(const CalibrationCache::Calibration& calibration, int calib_id, int module,
+                                   int& nb_rows, int& nb_registers)
+{
+    DEB_MEMBER_FUNCT();
+
+    //- the whole module is compared before the RAM content becomes unknown
+    std::vector<int> rows, registers;
+    diffCalibrationModule(calibration, calib_id, module, rows, registers);
+    if(rows.empty() && registers.empty())
+    {
+        m_calibration_cache.setModuleSaved(calibration, calib_id, module);
+        return false;
+    }
+    saveCalibrationRows(calibration, calib_id, module, rows, registers);
+    nb_rows += rows.size();
+    nb_registers += registers.size();
+    return true;
+}
+
+//-----------------------------------------------------
+//		save the given DACL rows (chip x row) and config G registers of a module, then mark it saved
+//-----------------------------------------------------
+void Camera::saveCalibrationRows(const CalibrationCache::Calibration& calibration, int calib_id, int module,
+                                 const std::vector<int>& rows, const std::vector<int>& registers)
+{
+    DEB_MEMBER_FUNCT();
+
+    //- the RAM content is unknown until the end of the module save
+    m_calibration_cache.invalidateSlot(calib_id, module);
+    unsigned long mask_local = 0x00;
+    SET(mask_local, module);
+    unsigned int values[CHIP_NB_COLUMN];
+    for(size_t i = 0; i < rows.size(); i++)
+    {
+        int chip = rows[i] / CHIP_NB_ROW;
+        int row = rows[i] % CHIP_NB_ROW;
+        const uint16_t* dacl = calibration.getDaclRow(module, chip, row);
+        std::copy(dacl, dacl + CHIP_NB_COLUMN, values);
+        if(xpci_modSaveConfigL(mask_local, calib_id, chip, row, values) != 0)
+            THROW_HW_ERROR(Error) << "Error in xpci_modSaveConfigL for module " << module + 1 << " chip " << chip + 1 << " row " << row;
+    }
+    for(size_t i = 0; i < registers.size(); i++)
+    {
+        int reg = registers[i];
+        for(unsigned int chip = 0; chip < m_chip_number; chip++)
+            values[chip] = calibration.getConfigG(module, chip, reg);
+        if(xpci_modSaveConfigG(mask_local, calib_id, CONFIG_G_REGISTERS[reg], values) != 0)
+            THROW_HW_ERROR(Error) << "Error in xpci_modSaveConfigG for module " << module + 1 << " register " << reg;
+    }
+    m_calibration_cache.setModuleSaved(calibration, calib_id, module);
+}
+
+//-----------------------------------------------------
+//		assign a calibration of the library to a calib RAM
+//-----------------------------------------------------
+void Camera::setCalibrationSlot(unsigned long calibId, const std::string& path)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(calibId, path);
+
+    if(calibId == 0)
+        throw LIMA_HW_EXC(InvalidValue, "Calib 0 is used by uploadCalibration");
+    m_calibration_cache.assignSlot(calibId, path);
+    preloadCalibrations();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getCalibrationSlot(unsigned long calibId, std::string& path, bool& preloaded, bool& loaded)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(calibId);
+
+    path = m_calibration_cache.getAssignedPath(calibId);
+    preloaded = !path.empty();
+    loaded = preloaded;
+    if(preloaded)
+    {
+        try
+        {
+            int nb_modules = getNbModuleIds();
+            const CalibrationCache::Calibration calibration = m_calibration_cache.get(path, nb_modules, m_chip_number);
+            for(int module = 0; module < nb_modules; module++)
+            {
+                if(!(m_modules_mask & (1U << module)))
+                    continue;
+                preloaded = preloaded && m_calibration_cache.isModuleSaved(calibration, calibId, module);
+                loaded = loaded && m_calibration_cache.getLoadedSlot(module) == int(calibId);
+            }
+        }
+        catch(Exception& e)
+        {
+            DEB_ERROR() << "Calibration " << path << ": " << e;
+            preloaded = false;
+        }
+        loaded = loaded && preloaded;
+    }
+    DEB_RETURN() << DEB_VAR3(path, preloaded, loaded);
+}
+
+//-----------------------------------------------------
+//		load on the chips a calibration of the library
+//-----------------------------------------------------
+void Camera::switchCalibration(const std::string& path)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(path);
+
+    if(m_calibration_cache.findSlot(path) < 0)
+        THROW_HW_ERROR(InvalidValue) << "Calibration " << path << " is not in the calibration library";
+    m_switch_calibration_path = path;
+
+    this->post(new yat::Message(XPAD_DLL_SWITCH_CALIBRATION), kPOST_MSG_TMO);
+}
+
+//-----------------------------------------------------
+//		preload the library in background (when the camera is idle)
+//-----------------------------------------------------
+void Camera::preloadCalibrations()
+{
+    DEB_MEMBER_FUNCT();
+
+    std::vector<int> calib_ids;
+    m_calibration_cache.getAssignedSlots(calib_ids);
+    if(!calib_ids.empty())
+        this->post(new yat::Message(XPAD_DLL_PRELOAD_CALIBRATIONS), kPOST_MSG_TMO);
+}
+
+//-----------------------------------------------------
+//		save one module of the library, false when all is saved (or on error)
+//-----------------------------------------------------
+bool Camera::preloadCalibrationModule()
+{
+    DEB_MEMBER_FUNCT();
+
+    std::vector<int> calib_ids;
+    m_calibration_cache.getAssignedSlots(calib_ids);
+    int nb_modules = getNbModuleIds();
+    for(size_t i = 0; i < calib_ids.size(); i++)
+    {
+        std::string path = m_calibration_cache.getAssignedPath(calib_ids[i]);
+        try
+        {
+            const CalibrationCache::Calibration calibration = m_calibration_cache.get(path, nb_modules, m_chip_number);
+            for(int module = 0; module < nb_modules; module++)
+            {
+                if(!(m_modules_mask & (1U << module)) ||
+                   m_calibration_cache.isModuleSaved(calibration, calib_ids[i], module))
+                    continue;
+                int nb_rows = 0, nb_registers = 0;
+                saveCalibrationModule(calibration, calib_ids[i], module, nb_rows, nb_registers);
+                DEB_TRACE() << "Calibration " << path << " preloaded in calib " << calib_ids[i]
+                            << " for module " << module + 1 << ": " << DEB_VAR2(nb_rows, nb_registers);
+                return true;
+            }
+        }
+        catch(Exception& e)
+        {
+            DEB_ERROR() << "Calibration " << path << " not preloaded: " << e;
+            return false;
+        }
+    }
+    return false;
+}
+
+//-----------------------------------------------------
+//		upload the wait times between images
+//-----------------------------------------------------
+void Camera::uploadExpWaitTimes(unsigned long *pWaitTime, unsigned size)
+{
+    DEB_MEMBER_FUNCT();
+
+    //- Check the number of values (one per hardware frame)
+    if (size != m_nb_frames * getNbHwFramesPerFrame())
+    {
+        throw LIMA_HW_EXC(Error, "Error in uploadExpWaitTimes: number of values does not correspond to number of images");
+    }
+
+    if(imxpad_uploadExpWaitTimes(m_modules_mask, (unsigned int*)pWaitTime, size) == 0)
+    {
+        DEB_TRACE() << "uploadExpWaitTimes -> imxpad_uploadExpWaitTimes -> OK" ;
+    }
+    else
+    {
+        throw LIMA_HW_EXC(Error, "Error in imxpad_uploadExpWaitTimes!");
+    }
+}
+
+//-----------------------------------------------------
+//		enable/disable the threshold scan
+//-----------------------------------------------------
+void Camera::setThresholdScan(bool threshold_scan)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(threshold_scan);
+
+    m_threshold_scan.setActive(threshold_scan);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setThresholdScanRange(int ithl_start, int ithl_stop, int ithl_step)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_threshold_scan.setRange(ithl_start, ithl_stop, ithl_step);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+int Camera::getThresholdScanNbSteps()
+{
+    DEB_MEMBER_FUNCT();
+
+    return m_threshold_scan.getNbSteps();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+int Camera::getThresholdScanIthl(int frame_nb)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(frame_nb);
+
+    int ithl;
+    if(!m_threshold_scan.getFrameIthl(frame_nb, ithl))
+        ithl = -1;
+    DEB_RETURN() << DEB_VAR1(ithl);
+    return ithl;
+}
+
+//-----------------------------------------------------
+//		enable/disable the S-curve fit
+//-----------------------------------------------------
+void Camera::setSCurveFit(bool scurve_fit)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(scurve_fit);
+
+    m_scurve_fitter.setActive(scurve_fit);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setSCurveFitNbThreads(int nb_threads)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_threads);
+
+    if(m_status != Camera::Ready)
+        throw LIMA_HW_EXC(Error, "S-curve fit threads can only be changed when the camera is Ready");
+    m_scurve_fitter.setNbThreads(nb_threads);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setSCurveDaclCorrection(double dacl_per_ithl, int dacl_max)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_scurve_fitter.setDaclCorrection(dacl_per_ithl, dacl_max);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getSCurveThresholds(std::vector<float>& thresholds)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_scurve_fitter.getThresholds(thresholds);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getSCurveNoise(std::vector<float>& noise)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_scurve_fitter.getNoise(noise);
+}
+
+//-----------------------------------------------------
+//		one iteration of the DACL correction (after a fitted threshold scan)
+//-----------------------------------------------------
+void Camera::correctDacl(unsigned long modules_mask)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(modules_mask);
+
+    if(m_status != Camera::Ready)
+        throw LIMA_HW_EXC(Error, "The DACL can only be corrected when the camera is Ready");
+    if(modules_mask == 0 || (modules_mask & ~m_modules_mask))
+        THROW_HW_ERROR(InvalidValue) << "Modules mask 0x" << std::hex << modules_mask
+                                     << " should be a subset of the detector modules mask 0x" << m_modules_mask;
+    if(m_scurve_fitter.getNbSteps() < 2)
+        throw LIMA_HW_EXC(Error, "No S-curve fit: run a threshold scan with the S-curve fit first");
+
+    m_dacl_correction_mask = modules_mask;
+    this->post(new yat::Message(XPAD_DLL_CORRECT_DACL), kPOST_MSG_TMO);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getSCurveDispersion(std::vector<double>& dispersion)
+{
+    DEB_MEMBER_FUNCT();
+
+    AutoMutex lock(m_scurve_dispersion_lock);
+    dispersion = m_scurve_dispersion;
+}
+
+//-----------------------------------------------------
+//		read the DACL back, correct it, save it to calibId 0 and load it on the chips
+//-----------------------------------------------------
+void Camera::correctDaclModules()
+{
+    DEB_MEMBER_FUNCT();
+
+    int width, height;
+    m_scurve_fitter.getSize(width, height);
+    if(width != int(CHIP_NB_COLUMN * m_chip_number) || height != CHIP_NB_ROW * m_module_number)
+        throw LIMA_HW_EXC(Error, "The S-curve fit does not match the detector geometry");
+
+    //- the config G of the chips is restored after the load, if known
+    std::vector<long> config_g;
+    bool config_g_known = getKnownConfigG(config_g);
+
+    //- the raw image has the modules of the detector mask only
+    int nb_modules = getNbModuleIds();
+    std::vector<int> module_ids;
+    unsigned int module_index_mask = 0;
+    for(int module = 0; module < nb_modules; module++)
+    {
+        if(!(m_modules_mask & (1U << module)))
+            continue;
+        if(m_dacl_correction_mask & (1U << module))
+            module_index_mask |= 1U << module_ids.size();
+        module_ids.push_back(module);
+    }
+
+    const unsigned short* dacl = getModConfig();
+    std::vector<uint16_t> corrected_dacl((long)width * height);
+    std::vector<double> dispersion;
+    m_scurve_fitter.correctDacl(dacl, module_index_mask, &corrected_dacl[0], dispersion);
+    {
+        AutoMutex lock(m_scurve_dispersion_lock);
+        m_scurve_dispersion.assign(nb_modules, 0);
+        for(size_t module_index = 0; module_index < module_ids.size(); module_index++)
+            m_scurve_dispersion[module_ids[module_index]] = dispersion[module_index];
+    }
+
+    //- to the saveDacl layout (module x chip x row x column)
+    long chip_size = (long)CHIP_NB_ROW * CHIP_NB_COLUMN;
+    long module_size = m_chip_number * chip_size;
+    m_dacl_upload.assign(nb_modules * module_size, 0);
+    for(size_t module_index = 0; module_index < module_ids.size(); module_index++)
+        for(unsigned int chip = 0; chip < m_chip_number; chip++)
+            for(int row = 0; row < CHIP_NB_ROW; row++)
+            {
+                const uint16_t* src = &corrected_dacl[(module_index * CHIP_NB_ROW + row) * width + chip * CHIP_NB_COLUMN];
+                std::copy(src, src + CHIP_NB_COLUMN,
+                          &m_dacl_upload[module_ids[module_index] * module_size + chip * chip_size + row * CHIP_NB_COLUMN]);
+            }
+    m_dacl_upload_calib_id = 0;
+    m_dacl_upload_modules_mask = m_dacl_correction_mask;
+    {
+        AutoMutex lock(m_dacl_upload_lock);
+        m_dacl_upload_nb_rows_done = 0;
+        m_dacl_upload_nb_rows = __builtin_popcount(m_dacl_correction_mask) * m_chip_number * CHIP_NB_ROW;
+        m_dacl_upload_nb_calls = 0;
+        m_dacl_upload_elapsed_sec = 0;
+    }
+    saveDaclRows();
+
+    for(int module = 0; module < nb_modules; module++)
+        if(m_dacl_correction_mask & (1U << module))
+        {
+            m_calibration_cache.invalidateChips(module);
+            m_calibration_cache.invalidateDacl(module);
+        }
+    if(xpci_modDetLoadConfig(m_dacl_correction_mask, 0) != 0)
+        THROW_HW_ERROR(Error) << "Error in xpci_modDetLoadConfig for modules mask 0x" << std::hex << m_dacl_correction_mask;
+    for(int module = 0; module < nb_modules; module++)
+        if(m_dacl_correction_mask & (1U << module))
+            m_calibration_cache.setModuleLoaded(0, module);
+
+    if(config_g_known)
+        setAllConfigG(config_g);
+    else
+        DEB_WARNING() << "Config G unknown before the DACL correction: the config G of calibId 0 is loaded";
+    DEB_TRACE() << "DACL corrected for modules mask 0x" << std::hex << m_dacl_correction_mask;
+}
+
+//-----------------------------------------------------
+//		config G of all the chips (module x chip x register), false if one is unknown
+//-----------------------------------------------------
+bool Camera::getKnownConfigG(std::vector<long>& config_g)
+{
+    int nb_modules = getNbModuleIds();
+    config_g.assign(nb_modules * m_chip_number * CONFIG_G_NB_REGISTERS, 0);
+    for(int module = 0; module < nb_modules; module++)
+    {
+        if(!(m_modules_mask & (1U << module)))
+            continue;
+        for(unsigned int chip = 0; chip < m_chip_number; chip++)
+            if(!m_calibration_cache.getConfigG(module, chip, &config_g[(module * m_chip_number + chip) * CONFIG_G_NB_REGISTERS]))
+                return false;
+    }
+    return true;
+}
+
+//-----------------------------------------------------
+//		same ITHL on all the chips
+//-----------------------------------------------------
+void Camera::loadIthl(int ithl)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(ithl);
+
+    //- the other registers of the known chips are unchanged
+    int nb_modules = getNbModuleIds();
+    std::vector<long> config_g(nb_modules * m_chip_number * CONFIG_G_NB_REGISTERS);
+    std::vector<char> known(nb_modules * m_chip_number, 0);
+    for(int module = 0; module < nb_modules; module++)
+        for(unsigned int chip = 0; chip < m_chip_number; chip++)
+            known[module * m_chip_number + chip] =
+                m_calibration_cache.getConfigG(module, chip, &config_g[(module * m_chip_number + chip) * CONFIG_G_NB_REGISTERS]);
+
+    unsigned int all_chips_mask = (1U << m_chip_number) - 1;
+    m_calibration_cache.invalidateChips(-1);
+    m_calibration_cache.invalidateConfigG(-1, -1);
+    if(xpci_modLoadConfigG(m_modules_mask, all_chips_mask, CONFIG_G_REGISTERS[CONFIG_G_ITHL], ithl) != 0)
+        THROW_HW_ERROR(Error) << "Error in xpci_modLoadConfigG for ITHL " << ithl;
+
+    for(int module = 0; module < nb_modules; module++)
+        for(unsigned int chip = 0; chip < m_chip_number; chip++)
+        {
+            if(!known[module * m_chip_number + chip])
+                continue;
+            long* values = &config_g[(module * m_chip_number + chip) * CONFIG_G_NB_REGISTERS];
+            values[CONFIG_G_ITHL] = ithl;
+            m_calibration_cache.setConfigG(module, chip, values);
+        }
+}
+
+//-----------------------------------------------------
+//		free the images allocated by prepare
+//-----------------------------------------------------
+void Camera::freeImageArray(int nb_frames)
+{
+    for(int i = 0 ; i < nb_frames ; i++)
+    {
+        if(m_imxpad_format == 0) //- aka 16 bits
+            delete[] reinterpret_cast<uint16_t*>(m_image_array[i]);
+        else
+            delete[] reinterpret_cast<uint32_t*>(m_image_array[i]);
+    }
+    if(m_imxpad_format == 0) //- aka 16 bits
+        delete[] reinterpret_cast<uint16_t**>(m_image_array);
+    else //- aka 32 bits
+        delete[] reinterpret_cast<uint32_t**>(m_image_array);
+    m_image_array = 0;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::ScanPublishJob::setStep(int step, int nb_hw_frames)
+{
+    m_step = step;
+    m_nb_hw_frames = nb_hw_frames;
+    m_error.clear();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::ScanPublishJob::checkError()
+{
+    if(!m_error.empty())
+        throw LIMA_HW_EXC(Error, m_error);
+}
+
+//-----------------------------------------------------
+//		publish the hardware frames of a step (publishing thread)
+//-----------------------------------------------------
+void Camera::ScanPublishJob::run()
+{
+    try
+    {
+        for(int i = m_step * m_nb_hw_frames; i < (m_step + 1) * m_nb_hw_frames; i++)
+        {
+            m_camera.m_current_nb_frames = i;
+            if(m_camera.m_scurve_fitter.isActive())
+            {
+                if(m_camera.m_imxpad_format == 0) //- aka 16 bits
+                    m_camera.m_scurve_fitter.add((const uint16_t*)m_camera.m_image_array[i]);
+                else
+                    m_camera.m_scurve_fitter.add((const uint32_t*)m_camera.m_image_array[i]);
+            }
+            m_camera.publishImage(m_camera.m_image_array[i], i);
+        }
+        if(m_camera.m_scurve_fitter.isActive())
+            m_camera.m_scurve_fitter.endStep(m_camera.m_threshold_scan.getIthl(m_step));
+        m_camera.m_threshold_scan.setPublished(m_step);
+    }
+    catch(Exception& e)
+    {
+        std::ostringstream error;
+        error << "Threshold scan step " << m_step << " not published: " << e;
+        m_error = error.str();
+    }
+}
+
+//-----------------------------------------------------
+//		increment the ITHL
+//-----------------------------------------------------
+void Camera::incrementITHL()
+{
+    DEB_MEMBER_FUNCT();
+
+    m_calibration_cache.invalidateChips(-1);
+    m_calibration_cache.invalidateConfigG(-1, -1);
+    if(imxpad_incrITHL(m_modules_mask) == 0)
+    {
+        DEB_TRACE() << "incrementITHL -> imxpad_incrITHL -> OK" ;
+    }
+    else
+    {
+        throw LIMA_HW_EXC(Error, "Error in imxpad_incrITHL!");
+    }
+}
+
+//-----------------------------------------------------
+//		decrement the ITHL
+//-----------------------------------------------------
+void Camera::decrementITHL()
+{
+    DEB_MEMBER_FUNCT();
+
+    m_calibration_cache.invalidateChips(-1);
+    m_calibration_cache.invalidateConfigG(-1, -1);
+    if(imxpad_decrITHL(m_modules_mask) == 0)
+    {
+        DEB_TRACE() << "decrementITHL -> imxpad_decrITHL -> OK" ;
+    }
+    else
+    {
+        throw LIMA_HW_EXC(Error, "Error in imxpad_decrITHL!");
+    }
+}
+
+//-----------------------------------------------------
+//		set Calibration Adjusting Number
+//-----------------------------------------------------
+void Camera::setCalibrationAdjustingNumber(unsigned calibration_adjusting_number)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_calibration_adjusting_number = calibration_adjusting_number;
+}
+
+//-----------------------------------------------------
+//		set Min LatencyTime Ms
+//-----------------------------------------------------
+void Camera::setMinLatencyTimeMs(double min_latency_time_ms)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_min_latency_time_ms = min_latency_time_ms;
+}
+
+//-----------------------------------------------------
+//		Set the init time
+//-----------------------------------------------------
+void Camera::setInitTime(unsigned int init_time_ms)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_time_before_start_usec  = init_time_ms * 1000; //- Temps initial
+}
+
+//-----------------------------------------------------
+//		Set the shutter time
+//-----------------------------------------------------
+void Camera::setShutterTime(unsigned int shutter_time_ms)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_shutter_time_usec  = shutter_time_ms * 1000;
+}
+
+//-----------------------------------------------------
+//		Set the overflow time
+//-----------------------------------------------------
+void Camera::setOverflowTime(unsigned int overflow_time)
+{
+    DEB_MEMBER_FUNCT();
+
+    if (overflow_time < 4000)
+        throw LIMA_HW_EXC(Error, "overflow should be at least 4000 usec");
+
+    m_ovf_refresh_time_usec  = overflow_time;
+}
+
+//-----------------------------------------------------
+//		Set the n parameter
+//-----------------------------------------------------
+void Camera::setNParameter(unsigned int n)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_specific_param_n  = n;
+}
+
+//-----------------------------------------------------
+//		Set the p parameter
+//-----------------------------------------------------
+void Camera::setPParameter(unsigned int p)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_specific_param_p  = p;
+}
+
+//-----------------------------------------------------
+//		Set the busy out selection
+//-----------------------------------------------------
+void Camera::setBusyOutSel(unsigned int busy_out_sel)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_busy_out_sel = busy_out_sel;
+}
+
+//-----------------------------------------------------
+//		enable/disable geom correction
+//-----------------------------------------------------
+void Camera::setGeomCorrection(bool geom_corr)
+{
+    DEB_MEMBER_FUNCT();
+
+    if((m_xpad_model != IMXPAD_S540) || (m_acquisition_type != Camera::ASYNC))
+        throw LIMA_HW_EXC(Error, "Geometrical correction is only available for S540 Xpad in Asynchrone mode");
+
+    m_geom_corr  = (unsigned int)geom_corr;
+
+    notifyMaxImageSizeChanged();
+}
+
+//-----------------------------------------------------
+//		enable/disable double pixel correction
+//-----------------------------------------------------
+void Camera::setDoublePixelCorrection(bool doublepixel_corr)
+{
+    DEB_MEMBER_FUNCT();
+
+    //TANGODEVIC-1280, add double pixel correction for S70
+    if(m_xpad_model != IMXPAD_S140 && m_xpad_model != IMXPAD_S70)
+        throw LIMA_HW_EXC(Error, "Double pixel correction is only available for S70/S140 Xpad");
+
+    m_doublepixel_corr  = doublepixel_corr;
+
+    notifyMaxImageSizeChanged();
+}
+
+//-----------------------------------------------------
+//		load the flat field map
+//-----------------------------------------------------
+void Camera::loadFlatField(const std::string& path)
+{
+    DEB_MEMBER_FUNCT();
+
+    Size image_size;
+    getImageSize(image_size); //- refresh m_image_size: maps are in the corrected (not rotated) geometry
+    m_pixel_correction.loadFlatField(path, m_image_size);
+}
+
+//-----------------------------------------------------
+//		enable/disable flat field correction
+//-----------------------------------------------------
+void Camera::setFlatFieldCorrection(bool flat_corr)
+{
+    DEB_MEMBER_FUNCT();
+
+    if(m_geom_corr)
+        DEB_WARNING() << "Flat field is applied on the float image from the geometrical correction";
+    m_pixel_correction.setFlatFieldActive(flat_corr);
+}
+
+//-----------------------------------------------------
+//		load the pixel mask
+//-----------------------------------------------------
+void Camera::loadPixelMask(const std::string& path)
+{
+    DEB_MEMBER_FUNCT();
+
+    Size image_size;
+    getImageSize(image_size); //- refresh m_image_size: maps are in the corrected (not rotated) geometry
+    m_pixel_correction.loadMask(path, m_image_size);
+}
+
+//-----------------------------------------------------
+//		enable/disable pixel mask correction
+//-----------------------------------------------------
+void Camera::setPixelMaskCorrection(bool mask_corr)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_pixel_correction.setMaskActive(mask_corr);
+}
+
+//-----------------------------------------------------
+//		Set the value written in the masked pixels
+//-----------------------------------------------------
+void Camera::setMaskFillValue(unsigned int fill_value)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_pixel_correction.setMaskFillValue(fill_value);
+}
+
+//-----------------------------------------------------
+//		Set the dead time of each module
+//-----------------------------------------------------
+void Camera::setModuleDeadTimes(const std::vector<double>& dead_times_ns)
+{
+    DEB_MEMBER_FUNCT();
+
+    if(dead_times_ns.size() != (size_t)m_module_number)
+        throw LIMA_HW_EXC(Error, "Number of dead times does not correspond to the number of modules");
+
+    m_pixel_correction.setModuleDeadTimes(dead_times_ns);
+}
+
+//-----------------------------------------------------
+//		load the per pixel dead time map
+//-----------------------------------------------------
+void Camera::loadDeadTimeMap(const std::string& path)
+{
+    DEB_MEMBER_FUNCT();
+
+    Size image_size;
+    getImageSize(image_size); //- refresh m_image_size: maps are in the corrected (not rotated) geometry
+    m_pixel_correction.loadDeadTimeMap(path, m_image_size);
+}
+
+//-----------------------------------------------------
+//		enable/disable count rate correction
+//-----------------------------------------------------
+void Camera::setRateCorrection(bool rate_corr)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_pixel_correction.setRateCorrectionActive(rate_corr);
+}
+
+//-----------------------------------------------------
+//		enable/disable the per frame statistics
+//-----------------------------------------------------
+void Camera::setFrameStatistics(bool frame_stats)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_frame_statistics.setActive(frame_stats);
+}
+
+//-----------------------------------------------------
+//		Set the threshold of the saturated pixels count
+//-----------------------------------------------------
+void Camera::setStatisticsSaturationThreshold(unsigned int threshold)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_frame_statistics.setSaturationThreshold(threshold);
+}
+
+//-----------------------------------------------------
+//		Set the histogram bin width (power of 2)
+//-----------------------------------------------------
+void Camera::setStatisticsHistogramShift(unsigned int shift)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_frame_statistics.setHistogramShift(shift);
+}
+
+//-----------------------------------------------------
+//		Get the statistics of a frame
+//-----------------------------------------------------
+bool Camera::getFrameStatistics(int frame_nb, FrameStatistics::Record& record)
+{
+    return m_frame_statistics.getRecord(frame_nb, record);
+}
+
+//-----------------------------------------------------
+//		Get the statistics of the last processed frame
+//-----------------------------------------------------
+bool Camera::getLastFrameStatistics(FrameStatistics::Record& record)
+{
+    return m_frame_statistics.getLastRecord(record);
+}
+
+//-----------------------------------------------------
+//		Set the threshold of the counted pixels
+//-----------------------------------------------------
+void Camera::setStatisticsCountThreshold(unsigned int threshold)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_frame_statistics.setCountThreshold(threshold);
+}
+
+//-----------------------------------------------------
+//		Set the rectangular roi counters
+//-----------------------------------------------------
+void Camera::setRoiCounters(const std::vector<int>& rois)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_roi_counters.setRois(rois);
+}
+
+//-----------------------------------------------------
+//		load the roi counters mask
+//-----------------------------------------------------
+void Camera::loadRoiCountersMask(const std::string& path)
+{
+    DEB_MEMBER_FUNCT();
+
+    Size image_size;
+    getImageSize(image_size); //- refresh m_image_size: rois are in the corrected (not rotated) geometry
+    m_roi_counters.loadMask(path, m_image_size);
+}
+
+//-----------------------------------------------------
+//		remove all the roi counters
+//-----------------------------------------------------
+void Camera::clearRoiCounters()
+{
+    DEB_MEMBER_FUNCT();
+
+    m_roi_counters.clear();
+}
+
+//-----------------------------------------------------
+//		Set the number of frames kept in the roi counters time series
+//-----------------------------------------------------
+void Camera::setRoiCountersBufferSize(int nb_frames)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_roi_counters.setBufferSize(nb_frames);
+}
+
+//-----------------------------------------------------
+//		enable/disable the roi counters only mode
+//-----------------------------------------------------
+void Camera::setRoiCountersOnly(bool roi_counters_only)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(roi_counters_only);
+
+    m_roi_counters_only = roi_counters_only;
+}
+
+//-----------------------------------------------------
+//		Get the number of roi counters of the current acquisition
+//-----------------------------------------------------
+int Camera::getNbRoiCounters()
+{
+    return m_roi_counters.getNbRois();
+}
+
+//-----------------------------------------------------
+//		read the roi counters time series
+//-----------------------------------------------------
+int Camera::readRoiCounters(int first_frame, int nb_frames, std::vector<double>& counters)
+{
+    DEB_MEMBER_FUNCT();
+
+    return m_roi_counters.read(first_frame, nb_frames, counters);
+}
+
+//-----------------------------------------------------
+//		set the number of hardware frames per accumulated frame
+//-----------------------------------------------------
+void Camera::setAccumulationNbFrames(int nb_frames)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_frames);
+
+    //- the number of hardware frames per frame and the pixel depth are the ones of the running acquisition
+    if(m_status != Camera::Ready)
+        throw LIMA_HW_EXC(Error, "The accumulation can only be changed when the camera is Ready");
+    if(nb_frames > 1 && m_geom_corr)
+        throw LIMA_HW_EXC(Error, "Accumulation is not available with the geometrical correction");
+    if(nb_frames > 1 && m_hdr_merger.isActive())
+        throw LIMA_HW_EXC(Error, "Accumulation is not available in HDR mode");
+
+    m_frame_accumulator.setNbFrames(nb_frames);
+    if(m_frame_accumulator.isActive())
+    {
+        //- the hardware frames are summed as 16 bits
+        m_pixel_depth = B2;
+        m_imxpad_format = 0;
+    }
+
+    notifyMaxImageSizeChanged();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getAccumulationNbFrames(int& nb_frames)
+{
+    DEB_MEMBER_FUNCT();
+    nb_frames = m_frame_accumulator.getNbFrames();
+    DEB_RETURN() << DEB_VAR1(nb_frames);
+}
+
+//-----------------------------------------------------
+//		hardware pixel value flagged as saturated
+//-----------------------------------------------------
+void Camera::setAccumulationSaturationThreshold(unsigned short threshold)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_frame_accumulator.setSaturationThreshold(threshold);
+}
+
+//-----------------------------------------------------
+//		saturated pixels of the last accumulated frame
+//-----------------------------------------------------
+int Camera::getAccumulationNbSaturated()
+{
+    DEB_MEMBER_FUNCT();
+
+    return m_frame_accumulator.getNbSaturated();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getAccumulationSaturationMap(std::vector<unsigned char>& saturation_map)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_frame_accumulator.getSaturationMap(saturation_map);
+}
+
+//-----------------------------------------------------
+//		enable/disable frame compression
+//-----------------------------------------------------
+void Camera::setCompression(bool compression)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_frame_compressor.setActive(compression);
+}
+
+//-----------------------------------------------------
+//		enable/disable compression only mode
+//-----------------------------------------------------
+void Camera::setCompressionOnly(bool compression_only)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(compression_only);
+
+    m_compression_only = compression_only;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setCompressionNbThreads(int nb_threads)
+{
+    DEB_MEMBER_FUNCT();
+
+    if(m_status != Camera::Ready)
+        throw LIMA_HW_EXC(Error, "Compression threads can only be changed when the camera is Ready");
+    m_frame_compressor.setNbThreads(nb_threads);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setCompressionBufferSize(int nb_frames)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_frame_compressor.setBufferSize(nb_frames);
+}
+
+//-----------------------------------------------------
+//		compressed chunk of a frame
+//-----------------------------------------------------
+bool Camera::readCompressedFrame(int frame_nb, std::vector<char>& chunk)
+{
+    DEB_MEMBER_FUNCT();
+
+    return m_frame_compressor.readChunk(frame_nb, chunk);
+}
+
+//-----------------------------------------------------
+//		compression ratio and throughput
+//-----------------------------------------------------
+void Camera::getCompressionReport(FrameCompressor::Report& report)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_frame_compressor.getReport(report);
+}
+
+//-----------------------------------------------------
+//		enable/disable the sparse frames
+//-----------------------------------------------------
+void Camera::setSparseFrames(bool sparse_frames)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_sparse_frames.setActive(sparse_frames);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setSparseOccupancyThreshold(double occupancy)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_sparse_frames.setOccupancyThreshold(occupancy);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setSparseBufferSize(int nb_frames)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_sparse_frames.setBufferSize(nb_frames);
+}
+
+//-----------------------------------------------------
+//		copy a sparse frame
+//-----------------------------------------------------
+int Camera::readSparseFrame(int frame_nb, std::vector<unsigned int>& indexes, std::vector<unsigned int>& values, int& lima_frame_nb)
+{
+    DEB_MEMBER_FUNCT();
+
+    return m_sparse_frames.readFrame(frame_nb, indexes, values, lima_frame_nb);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getNbSparseFrames(int& nb_frames, int& nb_dense_frames)
+{
+    DEB_MEMBER_FUNCT();
+
+    nb_frames = m_sparse_frames.getNbFrames();
+    nb_dense_frames = m_sparse_frames.getNbDenseFrames();
+    DEB_RETURN() << DEB_VAR2(nb_frames, nb_dense_frames);
+}
+
+//-----------------------------------------------------
+//		enable/disable the frame veto
+//-----------------------------------------------------
+void Camera::setFrameVeto(bool frame_veto)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_frame_veto.setActive(frame_veto);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setVetoMinSum(unsigned long long min_sum)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_frame_veto.setMinSum(min_sum);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setVetoMinNbPixels(unsigned int min_nb_pixels)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_frame_veto.setMinNbPixels(min_nb_pixels);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getNbVetoFrames(int& nb_kept_frames, int& nb_vetoed_frames)
+{
+    DEB_MEMBER_FUNCT();
+
+    nb_kept_frames = m_frame_veto.getNbKeptFrames();
+    nb_vetoed_frames = m_frame_veto.getNbVetoedFrames();
+    DEB_RETURN() << DEB_VAR2(nb_kept_frames, nb_vetoed_frames);
+}
+
+//-----------------------------------------------------
+//		acquired frame number of each kept frame
+//-----------------------------------------------------
+void Camera::getVetoFrameMapping(int& first_kept_frame_nb, std::vector<int>& acq_frame_nbs)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_frame_veto.getFrameMapping(first_kept_frame_nb, acq_frame_nbs);
+}
+
+//-----------------------------------------------------
+//		enable/disable the peak finder
+//-----------------------------------------------------
+void Camera::setPeakFinder(bool peak_finder)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_peak_finder.setActive(peak_finder);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setPeakFinderNbThreads(int nb_threads)
+{
+    DEB_MEMBER_FUNCT();
+
+    if(m_status != Camera::Ready)
+        throw LIMA_HW_EXC(Error, "Peak finder threads can only be changed when the camera is Ready");
+    m_peak_finder.setNbThreads(nb_threads);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setPeakFinderThreshold(double threshold)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_peak_finder.setThreshold(threshold);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setPeakFinderSnr(double snr)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_peak_finder.setSnr(snr);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setPeakFinderBackgroundRadius(int radius)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_peak_finder.setBackgroundRadius(radius);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setPeakFinderPixelRange(int min_nb_pixels, int max_nb_pixels)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_peak_finder.setPixelRange(min_nb_pixels, max_nb_pixels);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setPeakFinderMinNbPeaks(int min_nb_peaks)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_peak_finder.setMinNbPeaks(min_nb_peaks);
+}
+
+//-----------------------------------------------------
+//		peaks of a frame
+//-----------------------------------------------------
+bool Camera::getPeaks(int frame_nb, std::vector<PeakFinder::Peak>& peaks)
+{
+    DEB_MEMBER_FUNCT();
+
+    return m_peak_finder.getPeaks(frame_nb, peaks);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getNbPeakFinderFrames(int& nb_frames, int& nb_hits)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_peak_finder.getNbFrames(nb_frames, nb_hits);
+    DEB_RETURN() << DEB_VAR2(nb_frames, nb_hits);
+}
+
+//-----------------------------------------------------
+//		enable/disable the azimuthal integration
+//-----------------------------------------------------
+void Camera::setAzimuthalIntegration(bool azimuthal_integration)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_azimuthal_integrator.setActive(azimuthal_integration);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setAzimuthalIntegrationOnly(bool azimuthal_only)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(azimuthal_only);
+
+    m_azimuthal_only = azimuthal_only;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setAzimuthalNbThreads(int nb_threads)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_threads);
+
+    if(m_status != Camera::Ready)
+        throw LIMA_HW_EXC(Error, "Azimuthal integration threads can only be changed when the camera is Ready");
+    m_azimuthal_integrator.setNbThreads(nb_threads);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setAzimuthalGeometry(double distance, double center_x, double center_y, double tilt, double tilt_rotation)
+{
+    DEB_MEMBER_FUNCT();
+
+    AzimuthalIntegrator::Geometry geometry;
+    m_azimuthal_integrator.getGeometry(geometry);
+    geometry.distance = distance;
+    geometry.center_x = center_x;
+    geometry.center_y = center_y;
+    geometry.tilt = tilt;
+    geometry.tilt_rotation = tilt_rotation;
+    m_azimuthal_integrator.setGeometry(geometry);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setAzimuthalWavelength(double wavelength)
+{
+    DEB_MEMBER_FUNCT();
+
+    AzimuthalIntegrator::Geometry geometry;
+    m_azimuthal_integrator.getGeometry(geometry);
+    geometry.wavelength = wavelength;
+    m_azimuthal_integrator.setGeometry(geometry);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setAzimuthalBins(int nb_bins, double q_min, double q_max)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_azimuthal_integrator.setBins(nb_bins, q_min, q_max);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getAzimuthalQ(std::vector<float>& q)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_azimuthal_integrator.getQ(q);
+}
+
+//-----------------------------------------------------
+//		copy the 1D pattern of a frame
+//-----------------------------------------------------
+bool Camera::getAzimuthalPattern(int frame_nb, std::vector<float>& pattern)
+{
+    DEB_MEMBER_FUNCT();
+
+    return m_azimuthal_integrator.getPattern(frame_nb, pattern);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+int Camera::getNbAzimuthalPatterns()
+{
+    DEB_MEMBER_FUNCT();
+
+    int nb_frames = m_azimuthal_integrator.getNbFrames();
+    DEB_RETURN() << DEB_VAR1(nb_frames);
+    return nb_frames;
+}
+
+//-----------------------------------------------------
+//		enable/disable the pump-probe mode
+//-----------------------------------------------------
+void Camera::setPumpProbe(bool pump_probe)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_pump_probe.setActive(pump_probe);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setPumpProbeNbDelays(int nb_delays)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_pump_probe.setNbDelays(nb_delays);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setPumpProbePublishPeriod(int nb_cycles)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_pump_probe.setPublishPeriod(nb_cycles);
+}
+
+//-----------------------------------------------------
+//		copy the published sum of a delay
+//-----------------------------------------------------
+bool Camera::getPumpProbeSum(int delay, std::vector<unsigned int>& sum, int& nb_frames)
+{
+    DEB_MEMBER_FUNCT();
+
+    return m_pump_probe.getSum(delay, sum, nb_frames);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+int Camera::getNbPumpProbePublications()
+{
+    DEB_MEMBER_FUNCT();
+
+    int nb_publications = m_pump_probe.getNbPublications();
+    DEB_RETURN() << DEB_VAR1(nb_publications);
+    return nb_publications;
+}
+
+//-----------------------------------------------------
+//		enable/disable the HDR mode
+//-----------------------------------------------------
+void Camera::setHdr(bool hdr)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(hdr);
+
+    //- the merger is only prepared (and the frames paired) by prepare()
+    if(m_status != Camera::Ready)
+        throw LIMA_HW_EXC(Error, "HDR can only be changed when the camera is Ready");
+    if(hdr && m_geom_corr)
+        throw LIMA_HW_EXC(Error, "HDR is not available with the geometrical correction");
+    if(hdr && m_frame_accumulator.isActive())
+        throw LIMA_HW_EXC(Error, "HDR is not available in accumulation mode");
+
+    m_hdr_merger.setActive(hdr);
+    if(hdr)
     {
-        throw LIMA_HW_EXC(Error, "Error in imxpad_decrITHL!");
+        //- the hardware frames are merged as 16 bits
+        m_pixel_depth = B2;
+        m_imxpad_format = 0;
     }
+
+    notifyMaxImageSizeChanged();
 }
 
 //-----------------------------------------------------
-//		set Calibration Adjusting Number
+//
 //-----------------------------------------------------
-void Camera::setCalibrationAdjustingNumber(unsigned calibration_adjusting_number)
+void Camera::setHdrExposureRatio(double ratio)
 {
     DEB_MEMBER_FUNCT();
 
-    m_calibration_adjusting_number = calibration_adjusting_number;
+    //- checked by the merger, the short exposure is programmed at prepare
+    m_hdr_merger.setExposureRatio(ratio);
+    m_hdr_exposure_ratio = ratio;
 }
 
 //-----------------------------------------------------
-//		set Min LatencyTime Ms
+//
 //-----------------------------------------------------
-void Camera::setMinLatencyTimeMs(double min_latency_time_ms)
+void Camera::setHdrSaturationThreshold(unsigned short threshold)
 {
     DEB_MEMBER_FUNCT();
 
-    m_min_latency_time_ms = min_latency_time_ms;
+    m_hdr_merger.setSaturationThreshold(threshold);
 }
 
 //-----------------------------------------------------
-//		Set the init time
+//		merge statistics of a frame
 //-----------------------------------------------------
-void Camera::setInitTime(unsigned int init_time_ms)
+bool Camera::getHdrStats(int frame_nb, HdrMerger::Stats& stats)
 {
     DEB_MEMBER_FUNCT();
 
-    m_time_before_start_usec  = init_time_ms * 1000; //- Temps initial
+    return m_hdr_merger.getStats(frame_nb, stats);
 }
 
 //-----------------------------------------------------
-//		Set the shutter time
+//
 //-----------------------------------------------------
-void Camera::setShutterTime(unsigned int shutter_time_ms)
+void Camera::getHdrMergeMap(std::vector<unsigned char>& merge_map)
 {
     DEB_MEMBER_FUNCT();
 
-    m_shutter_time_usec  = shutter_time_ms * 1000;
+    m_hdr_merger.getMergeMap(merge_map);
 }
 
 //-----------------------------------------------------
-//		Set the overflow time
+//		enable/disable the per pixel statistics
 //-----------------------------------------------------
-void Camera::setOverflowTime(unsigned int overflow_time)
+void Camera::setPixelStatistics(bool pixel_statistics)
 {
     DEB_MEMBER_FUNCT();
 
-    if (overflow_time < 4000)
-        throw LIMA_HW_EXC(Error, "overflow should be at least 4000 usec");
+    m_pixel_statistics.setActive(pixel_statistics);
+}
 
-    m_ovf_refresh_time_usec  = overflow_time;
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setPixelStatisticsNbThreads(int nb_threads)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_threads);
+
+    if(m_status != Camera::Ready)
+        throw LIMA_HW_EXC(Error, "Pixel statistics threads can only be changed when the camera is Ready");
+    m_pixel_statistics.setNbThreads(nb_threads);
 }
 
 //-----------------------------------------------------
-//		Set the n parameter
+//
 //-----------------------------------------------------
-void Camera::setNParameter(unsigned int n)
+void Camera::setPixelStatisticsHistogram(int nb_bins, double bin_min, double bin_width)
 {
     DEB_MEMBER_FUNCT();
 
-    m_specific_param_n  = n;
+    m_pixel_statistics.setHistogram(nb_bins, bin_min, bin_width);
 }
 
 //-----------------------------------------------------
-//		Set the p parameter
+//
 //-----------------------------------------------------
-void Camera::setPParameter(unsigned int p)
+int Camera::getPixelStatisticsNbFrames()
 {
     DEB_MEMBER_FUNCT();
 
-    m_specific_param_p  = p;
+    int nb_frames = m_pixel_statistics.getNbFrames();
+    DEB_RETURN() << DEB_VAR1(nb_frames);
+    return nb_frames;
 }
 
 //-----------------------------------------------------
-//		Set the busy out selection
+//
 //-----------------------------------------------------
-void Camera::setBusyOutSel(unsigned int busy_out_sel)
+void Camera::getPixelStatisticsMean(std::vector<float>& mean)
 {
     DEB_MEMBER_FUNCT();
 
-    m_busy_out_sel = busy_out_sel;
+    m_pixel_statistics.getMean(mean);
 }
 
 //-----------------------------------------------------
-//		enable/disable geom correction
+//
 //-----------------------------------------------------
-void Camera::setGeomCorrection(bool geom_corr)
+void Camera::getPixelStatisticsVariance(std::vector<float>& variance)
 {
     DEB_MEMBER_FUNCT();
 
-    if((m_xpad_model != IMXPAD_S540) || (m_acquisition_type != Camera::ASYNC))
-        throw LIMA_HW_EXC(Error, "Geometrical correction is only available for S540 Xpad in Asynchrone mode");
+    m_pixel_statistics.getVariance(variance);
+}
 
-    m_geom_corr  = (unsigned int)geom_corr;
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getPixelStatisticsHistograms(std::vector<unsigned int>& histograms)
+{
+    DEB_MEMBER_FUNCT();
 
-    if (m_maximage_size_cb_active)
-    {
-        // only if the callaback is active
-        // inform lima about the size change
-        ImageType pixel_depth;
-        Size image_size;
-        getPixelDepth(pixel_depth); //- ie Bpp16 ...
-        getImageSize(image_size); //- size of image
-        maxImageSizeChanged(image_size, pixel_depth);
-    }
+    m_pixel_statistics.getHistograms(histograms);
 }
 
 //-----------------------------------------------------
-//		enable/disable double pixel correction
+//		write the maps in binary files
 //-----------------------------------------------------
-void Camera::setDoublePixelCorrection(bool doublepixel_corr)
+void Camera::savePixelStatistics(const std::string& prefix)
 {
     DEB_MEMBER_FUNCT();
 
-    //TANGODEVIC-1280, add double pixel correction for S70
-    if(m_xpad_model != IMXPAD_S140 && m_xpad_model != IMXPAD_S70)
-        throw LIMA_HW_EXC(Error, "Double pixel correction is only available for S70/S140 Xpad");
+    m_pixel_statistics.save(prefix);
+}
 
-    m_doublepixel_corr  = doublepixel_corr;
+//-----------------------------------------------------
+//		enable/disable the hot pixel detection at the end of the acquisitions
+//-----------------------------------------------------
+void Camera::setHotPixelDetection(bool hot_pixel_detection)
+{
+    DEB_MEMBER_FUNCT();
 
-    if (m_maximage_size_cb_active)
+    m_hot_pixel_detector.setActive(hot_pixel_detection);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setHotPixelKSigma(double k_sigma)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_hot_pixel_detector.setKSigma(k_sigma);
+}
+
+//-----------------------------------------------------
+//		detection on the pixel statistics, chip by chip
+//-----------------------------------------------------
+void Camera::detectHotPixels()
+{
+    DEB_MEMBER_FUNCT();
+
+    std::vector<float> mean, variance;
+    int width, height;
+    m_pixel_statistics.getSize(width, height);
+    m_pixel_statistics.getMean(mean);
+    m_pixel_statistics.getVariance(variance);
+    m_hot_pixel_detector.detect(mean, variance, m_pixel_statistics.getNbFrames(), width, height,
+                                m_chip_number, m_module_number);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getHotPixelMask(std::vector<unsigned char>& mask)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_hot_pixel_detector.getMask(mask);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getNbHotPixels(int& nb_hot, int& nb_cold, int& nb_noisy)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_hot_pixel_detector.getNbPixels(nb_hot, nb_cold, nb_noisy);
+    DEB_RETURN() << DEB_VAR3(nb_hot, nb_cold, nb_noisy);
+}
+
+//-----------------------------------------------------
+//		add the detected pixels to the pixel mask
+//-----------------------------------------------------
+void Camera::applyHotPixelMask()
+{
+    DEB_MEMBER_FUNCT();
+
+    std::vector<unsigned char> detected, mask;
+    m_hot_pixel_detector.getMask(detected);
+    if(detected.empty())
+        throw LIMA_HW_EXC(Error, "No hot pixel detection to apply");
+
+    //- the mask of the statistics geometry, kept if loaded
+    int width, height;
+    m_pixel_statistics.getSize(width, height);
+    m_pixel_correction.getMask(mask);
+    if(mask.size() != detected.size())
+        mask.assign(detected.size(), 0);
+    for(size_t i = 0; i < mask.size(); i++)
+        mask[i] |= detected[i];
+    m_pixel_correction.setMask(mask, Size(width, height));
+    m_pixel_correction.setMaskActive(true);
+    DEB_TRACE() << "Hot pixels added to the pixel mask: will be used from the next acquisition";
+}
+
+//-----------------------------------------------------
+//		end of acquisition detection, never fails the acquisition
+//-----------------------------------------------------
+void Camera::autoDetectHotPixels()
+{
+    DEB_MEMBER_FUNCT();
+
+    if(!m_hot_pixel_detector.isActive() || !m_pixel_statistics.isActive())
+        return;
+    try
     {
-        // only if the callaback is active
-        // inform lima about the size change
-        ImageType pixel_depth;
-        Size image_size;
-        getPixelDepth(pixel_depth); //- ie Bpp16 ...
-        getImageSize(image_size); //- size of image
-        maxImageSizeChanged(image_size, pixel_depth);
+        detectHotPixels();
+        applyHotPixelMask();
+    }
+    catch(Exception& e)
+    {
+        DEB_ERROR() << "Hot pixel detection failed: " << e;
     }
 }
 
@@ -1704,6 +4240,267 @@ void Camera::setMaxImageSizeCallbackActive(bool cb_active)
     DEB_TRACE() << "m_maximage_size_cb_active = " << m_maximage_size_cb_active ;
 }
 
+//-----------------------------------------------------
+//		number of hardware frames of a lima frame
+//-----------------------------------------------------
+int Camera::getNbHwFramesPerFrame()
+{
+    return m_hdr_merger.isActive() ? 2 : m_frame_accumulator.getNbFrames();
+}
+
+//-----------------------------------------------------
+//		inform lima about an image size/type change
+//-----------------------------------------------------
+void Camera::notifyMaxImageSizeChanged()
+{
+    DEB_MEMBER_FUNCT();
+
+    if (m_maximage_size_cb_active)
+    {
+        // only if the callaback is active
+        // inform lima about the size change
+        ImageType pixel_depth;
+        Size image_size;
+        getPixelDepth(pixel_depth); //- ie Bpp16 ...
+        getImageSize(image_size); //- size of image
+        maxImageSizeChanged(image_size, pixel_depth);
+    }
+}
+
+//-----------------------------------------------------
+//		copy one image in the lima buffer and publish it
+//-----------------------------------------------------
+void Camera::publishImage(void* image, int hw_frame_nb)
+{
+    DEB_MEMBER_FUNCT();
+
+    //- accumulation (HDR): one lima frame (32 bits sum) every N (2) hardware frames
+    int frame_nb = hw_frame_nb;
+    bool accumulated = m_frame_accumulator.isActive() || m_hdr_merger.isActive();
+    if(m_hdr_merger.isActive())
+    {
+        if(!m_hdr_merger.add((uint16_t*)image, hw_frame_nb))
+            return;
+        image = m_hdr_merger.getMerged();
+        frame_nb = hw_frame_nb / 2;
+    }
+    else if(accumulated)
+    {
+        if(!m_frame_accumulator.add((uint16_t*)image))
+            return;
+        image = m_frame_accumulator.getSum();
+        frame_nb = hw_frame_nb / m_frame_accumulator.getNbFrames();
+    }
+
+    //- in roi counters only, compression only, sparse (but dense frames), azimuthal only and pump-probe modes, the image is not given to lima
+    bool compress = m_frame_compressor.isActive();
+    bool publish = !(m_roi_counters_only && m_roi_counters.isActive()) && !(m_compression_only && compress)
+                   && !m_sparse_frames.isActive() && !(m_azimuthal_only && m_azimuthal_integrator.isActive())
+                   && !m_pump_probe.isActive();
+
+    //- with the veto, the frame is written in the buffer of the next kept frame
+    bool veto = m_frame_veto.isActive();
+    int lima_frame_nb = veto ? m_frame_veto.getNextFrameNb() : frame_nb;
+
+    StdBufferCbMgr& buffer_mgr = m_buffer_cb_mgr;
+    void* lima_img_ptr = 0;
+    if(publish)
+    {
+        int buffer_nb, concat_frame_nb;
+        buffer_mgr.setStartTimestamp(Timestamp::now());
+        buffer_mgr.acqFrameNb2BufferNb(lima_frame_nb, buffer_nb, concat_frame_nb);
+        lima_img_ptr = buffer_mgr.getBufferPtr(buffer_nb, concat_frame_nb);
+    }
+
+    //- the compressor gets the lima frame, written directly in its buffer if not published
+    void* compress_ptr = 0;
+    if(compress)
+    {
+        compress_ptr = m_frame_compressor.getInputBuffer();
+        if(!publish)
+            lima_img_ptr = compress_ptr;
+    }
+
+    if(m_frame_statistics.isActive())
+        m_frame_statistics.startFrame(frame_nb);
+    if(m_roi_counters.isActive())
+        m_roi_counters.startFrame(frame_nb);
+    if(m_sparse_frames.isActive())
+        m_sparse_frames.startFrame(frame_nb);
+    if(m_peak_finder.isActive())
+        m_peak_finder.startFrame(frame_nb);
+    if(m_azimuthal_integrator.isActive())
+        m_azimuthal_integrator.startFrame(frame_nb);
+    if(m_pump_probe.isActive())
+        m_pump_probe.startFrame(frame_nb);
+
+    //- copy image in the lima buffer
+    if(m_geom_corr) //- For S540 only: image already corrected by xpix (float)
+        writeImage<float>((float*)image, (float*)lima_img_ptr);
+    else if(m_imxpad_format == 0 && !accumulated) //- aka 16 bits
+        correctImage<uint16_t>((uint16_t*)image, (uint16_t*)lima_img_ptr);
+    else //- aka 32 bits
+        correctImage<uint32_t>((uint32_t*)image, (uint32_t*)lima_img_ptr);
+
+    //- the sum has been corrected in place, restart it
+    if(m_frame_accumulator.isActive())
+        m_frame_accumulator.reset();
+
+    //- statistics are available before lima gets the frame
+    if(m_frame_statistics.isActive())
+        m_frame_statistics.endFrame();
+    if(m_roi_counters.isActive())
+        m_roi_counters.endFrame();
+    bool hit = true;
+    if(m_peak_finder.isActive())
+    {
+        hit = m_peak_finder.isHit();
+        m_peak_finder.endFrame();
+    }
+    if(m_azimuthal_integrator.isActive())
+        m_azimuthal_integrator.endFrame();
+
+    //- vetoed frame: neither published nor compressed, its buffer is reused by the next frame
+    bool vetoed = veto && (m_frame_veto.check(m_frame_statistics.currentRecord(), hit) < 0);
+    //- the vetoed frames are not summed
+    if(m_pump_probe.isActive() && !vetoed)
+        m_pump_probe.endFrame();
+    //- sparse: the dense frame has been written in the next lima frame, given to lima if not vetoed
+    int dense_lima_frame_nb = -1;
+    if(m_sparse_frames.isActive())
+    {
+        if(m_sparse_frames.isDenseFrame() && !vetoed)
+            dense_lima_frame_nb = m_sparse_frames.getDenseLimaFrameNb();
+        m_sparse_frames.endFrame(dense_lima_frame_nb >= 0);
+    }
+    if(compress)
+    {
+        if(vetoed)
+            m_frame_compressor.cancel();
+        else
+        {
+            if(publish)
+                memcpy(compress_ptr, lima_img_ptr, m_frame_compressor.getFrameMemSize());
+            m_frame_compressor.push(lima_frame_nb);
+        }
+    }
+
+    if(dense_lima_frame_nb >= 0)
+    {
+        HwFrameInfoType frame_info;
+        frame_info.acq_frame_nb = dense_lima_frame_nb;
+        buffer_mgr.newFrameReady(frame_info);
+        DEB_TRACE() << "dense frame " << frame_nb << " published as image " << dense_lima_frame_nb;
+    }
+
+    if(!publish || vetoed)
+        return;
+
+    HwFrameInfoType frame_info;
+    frame_info.acq_frame_nb = lima_frame_nb;
+    //- raise the image to Lima
+    buffer_mgr.newFrameReady(frame_info);
+    DEB_TRACE() << "image " << lima_frame_nb <<" published with newFrameReady()" ;
+}
+
+//-----------------------------------------------------
+//		correct one image and write it (flipped/rotated) in the lima buffer
+//-----------------------------------------------------
+template<typename T>
+void Camera::correctImage(T* image, T* lima_img_ptr)
+{
+    if(m_doublepixel_corr) //- Double pixel correction for S140 and S70 only
+    {
+        if(m_xpad_model == IMXPAD_S140)
+        {
+            T corrected_image[S140_CORRECTED_NB_ROW][S140_CORRECTED_NB_COLUMN];
+            doublePixelCorrectionForS140<T>(image, corrected_image);
+            writeImage<T>(&corrected_image[0][0], lima_img_ptr);
+            return;
+        }
+        else if(m_xpad_model == IMXPAD_S70)
+        {
+            T corrected_image[S70_CORRECTED_NB_ROW][S70_CORRECTED_NB_COLUMN];
+            doublePixelCorrectionForS70<T>(image, corrected_image);
+            writeImage<T>(&corrected_image[0][0], lima_img_ptr);
+            return;
+        }
+    }
+
+    //- no double pix correction
+    writeImage<T>(image, lima_img_ptr);
+}
+
+//-----------------------------------------------------
+//		pixel corrections + write in the lima buffer, band by band
+//-----------------------------------------------------
+template<typename T>
+void Camera::writeImage(T* image, T* lima_img_ptr)
+{
+    bool correction_on = m_pixel_correction.isActive();
+    bool statistics_on = m_frame_statistics.isActive();
+    bool roi_counters_on = m_roi_counters.isActive();
+    bool sparse_on = m_sparse_frames.isActive();
+    bool peak_finder_on = m_peak_finder.isActive();
+    bool azimuthal_on = m_azimuthal_integrator.isActive();
+    bool pump_probe_on = m_pump_probe.isActive();
+    bool pixel_statistics_on = m_pixel_statistics.isActive();
+    //- with the veto, the pump-probe sum waits for the decision (whole frame statistics and peaks)
+    bool pump_probe_bands = pump_probe_on && !m_frame_veto.isActive();
+
+    if(!correction_on && !statistics_on && !roi_counters_on && !sparse_on && !peak_finder_on && !azimuthal_on
+       && !pump_probe_on && !pixel_statistics_on)
+    {
+        m_image_transform.apply<T>(image, lima_img_ptr);
+        return;
+    }
+
+    //- the image is ours (xpix or double pixel output): correct it in place,
+    //- one band at a time so that it is still in cache when written to lima
+    int height = m_image_size.getHeight();
+    for(int row = 0; row < height; row += PROCESSING_BAND_NB_ROW)
+    {
+        int row_end = std::min(row + PROCESSING_BAND_NB_ROW, height);
+        if(correction_on)
+            m_pixel_correction.apply<T>(image, row, row_end);
+        if(statistics_on)
+            m_frame_statistics.accumulate<T>(image, row, row_end);
+        if(roi_counters_on)
+            m_roi_counters.accumulate<T>(image, row, row_end);
+        if(sparse_on)
+            m_sparse_frames.accumulate<T>(image, row, row_end);
+        if(pump_probe_bands)
+            m_pump_probe.accumulate<T>(image, row, row_end);
+        if(lima_img_ptr) //- null if the image is not published
+            m_image_transform.apply<T>(image, lima_img_ptr, row, row_end);
+    }
+
+    //- too many events: the corrected image is written in the next lima frame (given to lima if not vetoed)
+    if(sparse_on && m_sparse_frames.isDenseFrame())
+    {
+        int buffer_nb, concat_frame_nb;
+        m_buffer_cb_mgr.acqFrameNb2BufferNb(m_sparse_frames.getDenseLimaFrameNb(), buffer_nb, concat_frame_nb);
+        m_image_transform.apply<T>(image, (T*)m_buffer_cb_mgr.getBufferPtr(buffer_nb, concat_frame_nb));
+    }
+
+    //- the peaks need the neighbourhood of each pixel: whole frame, multi-threaded
+    if(peak_finder_on)
+        m_peak_finder.process<T>(image);
+
+    //- 1D pattern of the corrected frame (lookup matrix x image, multi-threaded)
+    if(azimuthal_on)
+        m_azimuthal_integrator.process<T>(image);
+
+    //- only the frames kept by the veto are summed
+    if(pump_probe_on && !pump_probe_bands
+       && !m_frame_veto.isVetoed(m_frame_statistics.currentRecord(), !peak_finder_on || m_peak_finder.isHit()))
+        m_pump_probe.accumulate<T>(image, 0, height);
+
+    //- per pixel mean/variance/histogram, by tiles of rows (multi-threaded)
+    if(pixel_statistics_on)
+        m_pixel_statistics.process<T>(image);
+}
+
 //---------------------------------------------------------------------------
 //		Double Pixel Correction for S140 Xpad (cf J Perez and C Mocuta)
 //---------------------------------------------------------------------------
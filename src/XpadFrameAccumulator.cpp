@@ -0,0 +1,165 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "XpadFrameAccumulator.h"
+#include "lima/Exceptions.h"
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace lima;
+using namespace lima::Xpad;
+
+//---------------------------
+//- Ctor
+//---------------------------
+FrameAccumulator::FrameAccumulator() :
+                    m_nb_frames(1),
+                    m_saturation_threshold(0xFFFF),
+                    m_nb_pixels(0),
+                    m_nb_added(0),
+                    m_last_nb_saturated(0)
+{
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void FrameAccumulator::setNbFrames(int nb_frames)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_frames);
+
+    if(nb_frames < 1)
+        throw LIMA_HW_EXC(InvalidValue, "Number of accumulated frames should be >= 1");
+    //- 65536 frames of 65535 counts still fit in 32 bits
+    if(nb_frames > 65536)
+        throw LIMA_HW_EXC(InvalidValue, "Number of accumulated frames should be <= 65536");
+
+    m_nb_frames = nb_frames;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void FrameAccumulator::setSaturationThreshold(uint16_t threshold)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(threshold);
+
+    m_saturation_threshold = threshold;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void FrameAccumulator::prepare(int nb_pixels)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_nb_pixels = nb_pixels;
+    m_sum.assign(nb_pixels, 0);
+    m_saturation.assign(nb_pixels, 0);
+    m_nb_added = 0;
+
+    AutoMutex lock(m_lock);
+    m_last_saturation.clear();
+    m_last_nb_saturated = 0;
+}
+
+//-----------------------------------------------------
+//		add one hardware frame
+//-----------------------------------------------------
+bool FrameAccumulator::add(const uint16_t* frame)
+{
+    uint32_t* sum = &m_sum[0];
+    uint8_t* saturation = &m_saturation[0];
+    int i = 0;
+
+#ifdef __SSE2__
+    //- 8 pixels at once: widening add and saturation flags
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i threshold = _mm_set1_epi16((short)m_saturation_threshold);
+    for(; i + 8 <= m_nb_pixels; i += 8)
+    {
+        __m128i pixels = _mm_loadu_si128((const __m128i*)(frame + i));
+        __m128i sum_lo = _mm_loadu_si128((const __m128i*)(sum + i));
+        __m128i sum_hi = _mm_loadu_si128((const __m128i*)(sum + i + 4));
+        sum_lo = _mm_add_epi32(sum_lo, _mm_unpacklo_epi16(pixels, zero));
+        sum_hi = _mm_add_epi32(sum_hi, _mm_unpackhi_epi16(pixels, zero));
+        _mm_storeu_si128((__m128i*)(sum + i), sum_lo);
+        _mm_storeu_si128((__m128i*)(sum + i + 4), sum_hi);
+
+        //- pixel >= threshold <=> (threshold -sat pixel) == 0
+        __m128i saturated = _mm_cmpeq_epi16(_mm_subs_epu16(threshold, pixels), zero);
+        __m128i flags = _mm_loadl_epi64((const __m128i*)(saturation + i));
+        flags = _mm_or_si128(flags, _mm_packs_epi16(saturated, saturated));
+        _mm_storel_epi64((__m128i*)(saturation + i), flags);
+    }
+#endif
+    for(; i < m_nb_pixels; i++)
+    {
+        sum[i] += frame[i];
+        saturation[i] |= (frame[i] >= m_saturation_threshold) ? 0xFF : 0;
+    }
+
+    if(++m_nb_added < m_nb_frames)
+        return false;
+
+    //- frame complete: keep its saturation map for the readers
+    int nb_saturated = 0;
+    for(int j = 0; j < m_nb_pixels; j++)
+        nb_saturated += (saturation[j] != 0);
+
+    AutoMutex lock(m_lock);
+    m_last_saturation.swap(m_saturation);
+    m_last_nb_saturated = nb_saturated;
+    return true;
+}
+
+//-----------------------------------------------------
+//		restart the sum
+//-----------------------------------------------------
+void FrameAccumulator::reset()
+{
+    memset(&m_sum[0], 0, m_nb_pixels * sizeof(uint32_t));
+    m_saturation.assign(m_nb_pixels, 0);
+    m_nb_added = 0;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+int FrameAccumulator::getNbSaturated()
+{
+    AutoMutex lock(m_lock);
+    return m_last_nb_saturated;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void FrameAccumulator::getSaturationMap(std::vector<uint8_t>& saturation_map)
+{
+    AutoMutex lock(m_lock);
+    saturation_map = m_last_saturation;
+}
@@ -0,0 +1,508 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "XpadFrameCompressor.h"
+#include "lima/Exceptions.h"
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace lima;
+using namespace lima::Xpad;
+
+//- bitshuffle: blocks of ~8 KB, a multiple of 8 elements
+static const int BSHUF_TARGET_BLOCK_SIZE = 8192;
+static const int BSHUF_BLOCKED_MULT = 8;
+static const int BSHUF_MIN_BLOCK_NB_ELEMENTS = 128;
+//- header of the HDF5 filter: uncompressed size (8 bytes) + block size (4 bytes), big endian
+static const int BSHUF_HEADER_SIZE = 12;
+
+//- lz4 block format constraints
+static const int LZ4_MIN_MATCH = 4;
+static const int LZ4_HASH_LOG = 12;
+static const int LZ4_LAST_LITERALS = 5;	//- the last bytes are always literals
+static const int LZ4_MF_LIMIT = 12;		//- the last match starts before end - 12
+static const int LZ4_SKIP_TRIGGER = 6;	//- search step grows after 2^6 misses
+
+//-----------------------------------------------------
+//		big endian writers of the filter header
+//-----------------------------------------------------
+static inline void _writeUint32BE(char* p, uint32_t value)
+{
+    p[0] = char(value >> 24);
+    p[1] = char(value >> 16);
+    p[2] = char(value >> 8);
+    p[3] = char(value);
+}
+
+static inline void _writeUint64BE(char* p, uint64_t value)
+{
+    _writeUint32BE(p, uint32_t(value >> 32));
+    _writeUint32BE(p + 4, uint32_t(value));
+}
+
+//-----------------------------------------------------
+//		lz4 block compression (greedy, single hash probe)
+//-----------------------------------------------------
+static inline int _lz4Bound(int size)
+{
+    return size + size / 255 + 16;
+}
+
+static inline uint32_t _read32(const uint8_t* p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint8_t* _writeLength(uint8_t* op, int length)
+{
+    for(; length >= 255; length -= 255)
+        *op++ = 255;
+    *op++ = uint8_t(length);
+    return op;
+}
+
+static inline uint8_t* _writeSequence(uint8_t* op, const uint8_t* literals, int nb_literals)
+{
+    uint8_t* token = op++;
+    *token = uint8_t((nb_literals < 15 ? nb_literals : 15) << 4);
+    if(nb_literals >= 15)
+        op = _writeLength(op, nb_literals - 15);
+    memcpy(op, literals, nb_literals);
+    return op + nb_literals;
+}
+
+//- src size <= 64 KB (offsets and positions fit in 16 bits)
+static int _lz4Compress(const uint8_t* src, int size, uint8_t* dst)
+{
+    const uint8_t* ip = src;
+    const uint8_t* anchor = src;
+    const uint8_t* end = src + size;
+    uint8_t* op = dst;
+
+    if(size > LZ4_MF_LIMIT)
+    {
+        uint16_t table[1 << LZ4_HASH_LOG];
+        memset(table, 0, sizeof(table));
+
+        const uint8_t* match_limit = end - LZ4_MF_LIMIT;
+        const uint8_t* match_end_limit = end - LZ4_LAST_LITERALS;
+        int nb_misses = 0;
+        ip++;
+        while(ip < match_limit)
+        {
+            uint32_t sequence = _read32(ip);
+            uint32_t h = (sequence * 2654435761U) >> (32 - LZ4_HASH_LOG);
+            const uint8_t* ref = src + table[h];
+            table[h] = uint16_t(ip - src);
+            if(_read32(ref) != sequence || ref == ip)
+            {
+                ip += 1 + (nb_misses++ >> LZ4_SKIP_TRIGGER);
+                continue;
+            }
+            nb_misses = 0;
+
+            //- extend the match backward then forward
+            while(ip > anchor && ref > src && ip[-1] == ref[-1])
+            {
+                ip--;
+                ref--;
+            }
+            const uint8_t* match_end = ip + LZ4_MIN_MATCH;
+            const uint8_t* ref_end = ref + LZ4_MIN_MATCH;
+            while(match_end < match_end_limit && *match_end == *ref_end)
+            {
+                match_end++;
+                ref_end++;
+            }
+
+            uint8_t* token = op;
+            op = _writeSequence(op, anchor, int(ip - anchor));
+            int offset = int(ip - ref);
+            *op++ = uint8_t(offset);
+            *op++ = uint8_t(offset >> 8);
+            int match_length = int(match_end - ip) - LZ4_MIN_MATCH;
+            *token |= uint8_t(match_length < 15 ? match_length : 15);
+            if(match_length >= 15)
+                op = _writeLength(op, match_length - 15);
+
+            ip = anchor = match_end;
+        }
+    }
+
+    //- last literals
+    op = _writeSequence(op, anchor, int(end - anchor));
+    return int(op - dst);
+}
+
+//-----------------------------------------------------
+//		bitshuffle of one block (nb_elements multiple of 8)
+//		bit b of byte j of element i goes to bit (i % 8)
+//		of byte (j * 8 + b) * nb_elements / 8 + i / 8
+//-----------------------------------------------------
+static void _bitshuffle(const uint8_t* src, uint8_t* tmp, uint8_t* dst, int nb_elements, int elem_size)
+{
+    //- 1: byte planes
+    for(int i = 0; i < nb_elements; i++)
+        for(int j = 0; j < elem_size; j++)
+            tmp[j * nb_elements + i] = src[i * elem_size + j];
+
+    //- 2: bit planes of each byte plane
+    int nb_bitrow = nb_elements / 8;
+    for(int j = 0; j < elem_size; j++)
+    {
+        const uint8_t* plane = tmp + j * nb_elements;
+        uint8_t* out = dst + j * 8 * nb_bitrow;
+        int k = 0;
+#ifdef __SSE2__
+        //- 16 elements at once: movemask takes the msb of each byte
+        for(; k + 2 <= nb_bitrow; k += 2)
+        {
+            __m128i x = _mm_loadu_si128((const __m128i*)(plane + 8 * k));
+            for(int b = 7; b >= 0; b--)
+            {
+                uint16_t bits = uint16_t(_mm_movemask_epi8(x));
+                memcpy(out + b * nb_bitrow + k, &bits, sizeof(bits));
+                x = _mm_slli_epi16(x, 1);
+            }
+        }
+#endif
+        for(; k < nb_bitrow; k++)
+        {
+            //- 8x8 bit matrix transpose
+            uint64_t x, t;
+            memcpy(&x, plane + 8 * k, sizeof(x));
+            t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+            x = x ^ t ^ (t << 7);
+            t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+            x = x ^ t ^ (t << 14);
+            t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+            x = x ^ t ^ (t << 28);
+            for(int b = 0; b < 8; b++)
+                out[b * nb_bitrow + k] = uint8_t(x >> (8 * b));
+        }
+    }
+}
+
+//-----------------------------------------------------
+//		compress one frame in the bitshuffle filter format
+//-----------------------------------------------------
+int FrameCompressor::compress(const void* src, int nb_elements, int elem_size, std::vector<char>& dst)
+{
+    int block_nb_elements = BSHUF_TARGET_BLOCK_SIZE / elem_size;
+    block_nb_elements -= block_nb_elements % BSHUF_BLOCKED_MULT;
+    if(block_nb_elements < BSHUF_MIN_BLOCK_NB_ELEMENTS)
+        block_nb_elements = BSHUF_MIN_BLOCK_NB_ELEMENTS;
+    int block_size = block_nb_elements * elem_size;
+    int nb_blocks = (nb_elements + block_nb_elements - 1) / block_nb_elements;
+
+    dst.resize(BSHUF_HEADER_SIZE + nb_blocks * (4 + _lz4Bound(block_size)) + BSHUF_BLOCKED_MULT * elem_size);
+    _writeUint64BE(&dst[0], uint64_t(nb_elements) * elem_size);
+    _writeUint32BE(&dst[8], uint32_t(block_size));
+
+    std::vector<uint8_t> tmp(block_size);
+    std::vector<uint8_t> shuffled(block_size);
+    const uint8_t* in = (const uint8_t*)src;
+    char* out = &dst[BSHUF_HEADER_SIZE];
+    int done = 0;
+    while(done < nb_elements)
+    {
+        //- full blocks, then the last one rounded down to a multiple of 8
+        int nb = nb_elements - done;
+        if(nb > block_nb_elements)
+            nb = block_nb_elements;
+        nb -= nb % BSHUF_BLOCKED_MULT;
+        if(!nb)
+            break;
+
+        _bitshuffle(in + done * elem_size, &tmp[0], &shuffled[0], nb, elem_size);
+        int compressed_size = _lz4Compress(&shuffled[0], nb * elem_size, (uint8_t*)out + 4);
+        _writeUint32BE(out, uint32_t(compressed_size));
+        out += 4 + compressed_size;
+        done += nb;
+    }
+
+    //- the last (< 8) elements are copied as is
+    int leftover = (nb_elements - done) * elem_size;
+    memcpy(out, in + done * elem_size, leftover);
+    out += leftover;
+
+    int size = int(out - &dst[0]);
+    dst.resize(size);
+    return size;
+}
+
+//---------------------------
+//- Ctor
+//---------------------------
+FrameCompressor::FrameCompressor() :
+                    m_staged_active(false),
+                    m_buffer_size(1024),
+                    m_active(false),
+                    m_nb_elements(0),
+                    m_elem_size(0),
+                    m_frame_mem_size(0),
+                    m_current_slot(-1),
+                    m_nb_frames(0),
+                    m_raw_size(0),
+                    m_compressed_size(0)
+{
+}
+
+//---------------------------
+//- Dtor
+//---------------------------
+FrameCompressor::~FrameCompressor()
+{
+    m_pool.wait();
+    _releaseJobs();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void FrameCompressor::setActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+
+    AutoMutex lock(m_cond.mutex());
+    m_staged_active = active;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+bool FrameCompressor::getActive()
+{
+    AutoMutex lock(m_cond.mutex());
+    return m_staged_active;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void FrameCompressor::setNbThreads(int nb_threads)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_pool.setNbThreads(nb_threads);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void FrameCompressor::setBufferSize(int nb_frames)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_frames);
+
+    if(nb_frames <= 0)
+        throw LIMA_HW_EXC(InvalidValue, "Compressed frames buffer size should be > 0");
+
+    AutoMutex lock(m_cond.mutex());
+    m_buffer_size = nb_frames;
+}
+
+//-----------------------------------------------------
+//		allocate the input slots (2 per thread) and clear the ring
+//-----------------------------------------------------
+void FrameCompressor::prepare(const Size& frame_size, int frame_depth)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_pool.wait();
+
+    AutoMutex lock(m_cond.mutex());
+    m_active = m_staged_active;
+    if(!m_active)
+    {
+        lock.unlock();
+        _releaseJobs();
+        return;
+    }
+
+    int nb_slots = 2 * m_pool.getNbThreads();
+    int frame_mem_size = frame_size.getWidth() * frame_size.getHeight() * frame_depth;
+    m_nb_elements = frame_size.getWidth() * frame_size.getHeight();
+    m_elem_size = frame_depth;
+    if(frame_mem_size != m_frame_mem_size || nb_slots != int(m_slots.size()))
+    {
+        lock.unlock();
+        _releaseJobs();
+        lock.lock();
+        m_frame_mem_size = frame_mem_size;
+        for(int i = 0; i < nb_slots; i++)
+        {
+            m_slots.push_back(new char[frame_mem_size]);
+            m_jobs.push_back(new CompressJob(*this, i));
+        }
+    }
+    m_free_slots.clear();
+    for(int i = 0; i < int(m_slots.size()); i++)
+        m_free_slots.push_back(i);
+    m_current_slot = -1;
+
+    m_chunks.resize(m_buffer_size);
+    for(int i = 0; i < m_buffer_size; i++)
+        m_chunks[i].frame_nb = -1;
+    m_nb_frames = 0;
+    m_raw_size = 0;
+    m_compressed_size = 0;
+    m_start = Timestamp();
+    m_end = Timestamp();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void FrameCompressor::_releaseJobs()
+{
+    for(size_t i = 0; i < m_slots.size(); i++)
+    {
+        delete[] m_slots[i];
+        delete m_jobs[i];
+    }
+    m_slots.clear();
+    m_jobs.clear();
+    m_frame_mem_size = 0;
+}
+
+//-----------------------------------------------------
+//		a free input buffer
+//-----------------------------------------------------
+void* FrameCompressor::getInputBuffer()
+{
+    AutoMutex lock(m_cond.mutex());
+    while(m_free_slots.empty())
+        m_cond.wait();
+    m_current_slot = m_free_slots.back();
+    m_free_slots.pop_back();
+    return m_slots[m_current_slot];
+}
+
+//-----------------------------------------------------
+//		compress the current input buffer
+//-----------------------------------------------------
+void FrameCompressor::push(int frame_nb)
+{
+    {
+        AutoMutex lock(m_cond.mutex());
+        if(!m_start.isSet())
+            m_start = Timestamp::now();
+    }
+
+    CompressJob* job = m_jobs[m_current_slot];
+    job->setFrameNb(frame_nb);
+    m_current_slot = -1;
+    m_pool.post(job);
+}
+
+//-----------------------------------------------------
+//		give back the current input buffer
+//-----------------------------------------------------
+void FrameCompressor::cancel()
+{
+    AutoMutex lock(m_cond.mutex());
+    m_free_slots.push_back(m_current_slot);
+    m_current_slot = -1;
+    m_cond.broadcast();
+}
+
+//-----------------------------------------------------
+//		wait for the pending frames
+//-----------------------------------------------------
+void FrameCompressor::flush()
+{
+    DEB_MEMBER_FUNCT();
+
+    m_pool.wait();
+    if(!m_active)
+        return;
+
+    Report report;
+    getReport(report);
+    DEB_TRACE() << "Compression: " << report.nb_frames << " frames"
+                << ", ratio = " << report.ratio
+                << ", throughput = " << report.throughput_mbs << " MB/s";
+}
+
+//-----------------------------------------------------
+//		compression job
+//-----------------------------------------------------
+void FrameCompressor::CompressJob::run()
+{
+    FrameCompressor& c = m_compressor;
+    int size = compress(c.m_slots[m_slot], c.m_nb_elements, c.m_elem_size, m_chunk);
+
+    AutoMutex lock(c.m_cond.mutex());
+    Chunk& chunk = c.m_chunks[m_frame_nb % c.m_chunks.size()];
+    chunk.frame_nb = m_frame_nb;
+    chunk.data.swap(m_chunk); //- the previous chunk buffer is reused by the next frame
+    c.m_nb_frames++;
+    c.m_raw_size += c.m_frame_mem_size;
+    c.m_compressed_size += size;
+    c.m_end = Timestamp::now();
+
+    c.m_free_slots.push_back(m_slot);
+    c.m_cond.broadcast();
+}
+
+//-----------------------------------------------------
+//		copy the chunk of a frame
+//-----------------------------------------------------
+bool FrameCompressor::readChunk(int frame_nb, std::vector<char>& chunk)
+{
+    AutoMutex lock(m_cond.mutex());
+    if(frame_nb < 0 || m_chunks.empty())
+        return false;
+    const Chunk& c = m_chunks[frame_nb % m_chunks.size()];
+    if(c.frame_nb != frame_nb)
+        return false;
+    chunk = c.data;
+    return true;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+int FrameCompressor::getNbFrames()
+{
+    AutoMutex lock(m_cond.mutex());
+    return m_nb_frames;
+}
+
+//-----------------------------------------------------
+//		compression ratio and throughput of the acquisition
+//-----------------------------------------------------
+void FrameCompressor::getReport(Report& report)
+{
+    AutoMutex lock(m_cond.mutex());
+    report.nb_frames = m_nb_frames;
+    report.raw_size = m_raw_size;
+    report.compressed_size = m_compressed_size;
+    report.ratio = (m_compressed_size > 0) ? m_raw_size / m_compressed_size : 0;
+    report.elapsed_sec = (m_start.isSet() && m_end.isSet()) ? double(m_end - m_start) : 0;
+    report.throughput_mbs = (report.elapsed_sec > 0) ? m_raw_size / report.elapsed_sec / 1e6 : 0;
+}
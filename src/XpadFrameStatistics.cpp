@@ -0,0 +1,253 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "XpadFrameStatistics.h"
+#include "lima/Exceptions.h"
+#include <string.h>
+#include <limits>
+
+using namespace lima;
+using namespace lima::Xpad;
+
+//---------------------------
+//- Ctor
+//---------------------------
+FrameStatistics::FrameStatistics() :
+                    m_active(false),
+                    m_on(false),
+                    m_saturation_threshold(0),
+                    m_count_threshold(1),
+                    m_histogram_shift(0),
+                    m_width(0),
+                    m_slots(FRAME_STATISTICS_HISTORY),
+                    m_last_frame_nb(-1)
+{
+    memset(&m_current, 0, sizeof(m_current));
+    for(size_t i = 0; i < m_slots.size(); i++)
+    {
+        m_slots[i].seq = 0;
+        m_slots[i].record.frame_nb = -1;
+    }
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void FrameStatistics::setActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+
+    m_active = active;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void FrameStatistics::setSaturationThreshold(uint32_t threshold)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(threshold);
+
+    m_saturation_threshold = threshold;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void FrameStatistics::setCountThreshold(uint32_t threshold)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(threshold);
+
+    m_count_threshold = threshold;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void FrameStatistics::setHistogramShift(unsigned int shift)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(shift);
+
+    if(shift > 31)
+        throw LIMA_HW_EXC(InvalidValue, "Histogram shift should be in [0, 31]");
+
+    m_histogram_shift = shift;
+}
+
+//-----------------------------------------------------
+//		clear the records
+//-----------------------------------------------------
+void FrameStatistics::prepare(int width, bool forced)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_on = m_active || forced;
+    m_width = width;
+    for(size_t i = 0; i < m_slots.size(); i++)
+    {
+        __sync_fetch_and_add(&m_slots[i].seq, 1);
+        __sync_synchronize();
+        m_slots[i].record.frame_nb = -1;
+        __sync_synchronize();
+        __sync_fetch_and_add(&m_slots[i].seq, 1);
+    }
+    m_last_frame_nb = -1;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void FrameStatistics::startFrame(int frame_nb)
+{
+    memset(&m_current, 0, sizeof(m_current));
+    m_current.frame_nb = frame_nb;
+}
+
+//-----------------------------------------------------
+//		accumulate the rows [row_begin, row_end[
+//-----------------------------------------------------
+template<typename T>
+void FrameStatistics::accumulate(const T* image, int row_begin, int row_end)
+{
+    const T threshold = (m_saturation_threshold == 0 || m_saturation_threshold > std::numeric_limits<T>::max()) ?
+                            std::numeric_limits<T>::max() : (T)m_saturation_threshold;
+    //- above the type max: no pixel is counted
+    const uint64_t count_threshold = m_count_threshold;
+    const unsigned int shift = m_histogram_shift;
+    const uint32_t last_bin = FRAME_STATISTICS_NB_BINS - 1;
+
+    //- local accumulators: kept in registers
+    uint64_t sum = 0;
+    T max_value = 0;
+    uint32_t nb_saturated = 0;
+    uint32_t nb_above_threshold = 0;
+    uint32_t* histogram = m_current.histogram;
+
+    const T* p = image + (size_t)row_begin * m_width;
+    const T* end = image + (size_t)row_end * m_width;
+    for(; p < end; p++)
+    {
+        T value = *p;
+        sum += value;
+        max_value = (value > max_value) ? value : max_value;
+        nb_saturated += (value >= threshold);
+        nb_above_threshold += ((uint64_t)value >= count_threshold);
+        uint32_t bin = (uint32_t)value >> shift;
+        histogram[(bin < last_bin) ? bin : last_bin]++;
+    }
+
+    m_current.sum += sum;
+    if(max_value > m_current.max_value)
+        m_current.max_value = max_value;
+    m_current.nb_saturated += nb_saturated;
+    m_current.nb_above_threshold += nb_above_threshold;
+}
+
+//-----------------------------------------------------
+//		float images (S540 geometrical correction)
+//-----------------------------------------------------
+template<>
+void FrameStatistics::accumulate<float>(const float* image, int row_begin, int row_end)
+{
+    const float threshold = (m_saturation_threshold == 0) ? std::numeric_limits<float>::max() : (float)m_saturation_threshold;
+    const float count_threshold = (float)m_count_threshold;
+    const unsigned int shift = m_histogram_shift;
+    const uint32_t last_bin = FRAME_STATISTICS_NB_BINS - 1;
+
+    double sum = 0.;
+    float max_value = 0.f;
+    uint32_t nb_saturated = 0;
+    uint32_t nb_above_threshold = 0;
+    uint32_t* histogram = m_current.histogram;
+
+    const float* p = image + (size_t)row_begin * m_width;
+    const float* end = image + (size_t)row_end * m_width;
+    for(; p < end; p++)
+    {
+        float value = (*p > 0.f) ? *p : 0.f;
+        sum += value;
+        max_value = (value > max_value) ? value : max_value;
+        nb_saturated += (value >= threshold);
+        nb_above_threshold += (value >= count_threshold);
+        uint32_t bin = (value < 4294967040.f) ? ((uint32_t)value >> shift) : last_bin;
+        histogram[(bin < last_bin) ? bin : last_bin]++;
+    }
+
+    m_current.sum += (uint64_t)(sum + 0.5);
+    if(max_value > m_current.max_value)
+        m_current.max_value = (max_value < 4294967040.f) ? (uint32_t)max_value : std::numeric_limits<uint32_t>::max();
+    m_current.nb_saturated += nb_saturated;
+    m_current.nb_above_threshold += nb_above_threshold;
+}
+
+//-----------------------------------------------------
+//		publish the record of the current frame
+//-----------------------------------------------------
+void FrameStatistics::endFrame()
+{
+    Slot& slot = m_slots[m_current.frame_nb % FRAME_STATISTICS_HISTORY];
+
+    __sync_fetch_and_add(&slot.seq, 1); //- odd: being written
+    __sync_synchronize();
+    slot.record = m_current;
+    __sync_synchronize();
+    __sync_fetch_and_add(&slot.seq, 1); //- even: consistent
+
+    m_last_frame_nb = m_current.frame_nb;
+}
+
+//-----------------------------------------------------
+//		read the record of frame_nb
+//-----------------------------------------------------
+bool FrameStatistics::getRecord(int frame_nb, Record& record) const
+{
+    if(frame_nb < 0)
+        return false;
+
+    const Slot& slot = m_slots[frame_nb % FRAME_STATISTICS_HISTORY];
+    uint32_t seq_begin, seq_end;
+    do
+    {
+        seq_begin = slot.seq;
+        __sync_synchronize();
+        record = slot.record;
+        __sync_synchronize();
+        seq_end = slot.seq;
+    }
+    while((seq_begin != seq_end) || (seq_begin & 1));
+
+    return record.frame_nb == frame_nb;
+}
+
+//-----------------------------------------------------
+//		read the record of the last processed frame
+//-----------------------------------------------------
+bool FrameStatistics::getLastRecord(Record& record) const
+{
+    return getRecord(m_last_frame_nb, record);
+}
+
+//- instantiations used by the Camera
+template void FrameStatistics::accumulate<uint16_t>(const uint16_t*, int, int);
+template void FrameStatistics::accumulate<uint32_t>(const uint32_t*, int, int);
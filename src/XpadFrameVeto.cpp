@@ -0,0 +1,163 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "XpadFrameVeto.h"
+#include "lima/Exceptions.h"
+#include <algorithm>
+
+using namespace lima;
+using namespace lima::Xpad;
+
+//---------------------------
+//- Ctor
+//---------------------------
+FrameVeto::FrameVeto() :
+                    m_staged_active(false),
+                    m_staged_min_sum(1),
+                    m_staged_min_nb_pixels(0),
+                    m_active(false),
+                    m_min_sum(1),
+                    m_min_nb_pixels(0),
+                    m_nb_kept(0),
+                    m_nb_vetoed(0)
+{
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void FrameVeto::setActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+
+    AutoMutex lock(m_lock);
+    m_staged_active = active;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+bool FrameVeto::getActive()
+{
+    AutoMutex lock(m_lock);
+    return m_staged_active;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void FrameVeto::setMinSum(uint64_t min_sum)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(min_sum);
+
+    AutoMutex lock(m_lock);
+    m_staged_min_sum = min_sum;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void FrameVeto::setMinNbPixels(uint32_t min_nb_pixels)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(min_nb_pixels);
+
+    AutoMutex lock(m_lock);
+    m_staged_min_nb_pixels = min_nb_pixels;
+}
+
+//-----------------------------------------------------
+//		clear the mapping table
+//-----------------------------------------------------
+void FrameVeto::prepare()
+{
+    DEB_MEMBER_FUNCT();
+
+    AutoMutex lock(m_lock);
+    m_active = m_staged_active;
+    m_min_sum = m_staged_min_sum;
+    m_min_nb_pixels = m_staged_min_nb_pixels;
+    m_nb_kept = 0;
+    m_nb_vetoed = 0;
+    if(m_active)
+        m_acq_frame_nbs.resize(FRAME_VETO_MAPPING_HISTORY);
+    else
+        std::vector<int>().swap(m_acq_frame_nbs);
+}
+
+//-----------------------------------------------------
+//		keep or veto the current frame
+//-----------------------------------------------------
+int FrameVeto::check(const FrameStatistics::Record& record, bool hit)
+{
+    AutoMutex lock(m_lock);
+    if(isVetoed(record, hit))
+    {
+        m_nb_vetoed++;
+        return -1;
+    }
+
+    m_acq_frame_nbs[m_nb_kept % FRAME_VETO_MAPPING_HISTORY] = record.frame_nb;
+    return m_nb_kept++;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+int FrameVeto::getNbKeptFrames()
+{
+    AutoMutex lock(m_lock);
+    return m_nb_kept;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+int FrameVeto::getNbVetoedFrames()
+{
+    AutoMutex lock(m_lock);
+    return m_nb_vetoed;
+}
+
+//-----------------------------------------------------
+//		acquired frame number of a kept frame
+//-----------------------------------------------------
+int FrameVeto::getAcqFrameNb(int kept_frame_nb)
+{
+    AutoMutex lock(m_lock);
+    if(kept_frame_nb < 0 || kept_frame_nb >= m_nb_kept || kept_frame_nb < m_nb_kept - FRAME_VETO_MAPPING_HISTORY)
+        return -1;
+    return m_acq_frame_nbs[kept_frame_nb % FRAME_VETO_MAPPING_HISTORY];
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void FrameVeto::getFrameMapping(int& first_kept_frame_nb, std::vector<int>& acq_frame_nbs)
+{
+    AutoMutex lock(m_lock);
+    first_kept_frame_nb = std::max(m_nb_kept - FRAME_VETO_MAPPING_HISTORY, 0);
+    acq_frame_nbs.resize(m_nb_kept - first_kept_frame_nb);
+    for(int kept = first_kept_frame_nb; kept < m_nb_kept; kept++)
+        acq_frame_nbs[kept - first_kept_frame_nb] = m_acq_frame_nbs[kept % FRAME_VETO_MAPPING_HISTORY];
+}
@@ -0,0 +1,213 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "XpadHdrMerger.h"
+#include "lima/Exceptions.h"
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace lima;
+using namespace lima::Xpad;
+
+//---------------------------
+//- Ctor
+//---------------------------
+HdrMerger::HdrMerger() :
+                    m_active(false),
+                    m_ratio(1),
+                    m_saturation_threshold(0xFFFF),
+                    m_nb_pixels(0)
+{
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void HdrMerger::setActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+
+    m_active = active;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void HdrMerger::setExposureRatio(double ratio)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(ratio);
+
+    if(ratio < 1)
+        throw LIMA_HW_EXC(InvalidValue, "HDR exposure ratio (long / short) should be >= 1");
+    //- 65535 counts times the ratio should still fit in 32 bits
+    if(ratio > 65536)
+        throw LIMA_HW_EXC(InvalidValue, "HDR exposure ratio (long / short) should be <= 65536");
+
+    m_ratio = ratio;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void HdrMerger::setSaturationThreshold(uint16_t threshold)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(threshold);
+
+    m_saturation_threshold = threshold;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void HdrMerger::prepare(int nb_pixels)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_nb_pixels = nb_pixels;
+    m_short.assign(nb_pixels, 0);
+    m_merged.assign(nb_pixels, 0);
+    m_map.assign(nb_pixels, 0);
+
+    AutoMutex lock(m_lock);
+    m_stats.assign(HDR_HISTORY, Stats());
+    for(int i = 0; i < HDR_HISTORY; i++)
+        m_stats[i].frame_nb = -1;
+    m_last_map.clear();
+}
+
+//-----------------------------------------------------
+//		keep the short exposure, merge with the long one
+//-----------------------------------------------------
+bool HdrMerger::add(const uint16_t* frame, int hw_frame_nb)
+{
+    if(!(hw_frame_nb & 1))
+    {
+        memcpy(&m_short[0], frame, m_nb_pixels * sizeof(uint16_t));
+        return false;
+    }
+
+    const uint16_t* short_frame = &m_short[0];
+    uint32_t* merged = &m_merged[0];
+    uint8_t* map = &m_map[0];
+    float ratio = float(m_ratio);
+    int nb_short = 0, nb_saturated = 0;
+    int i = 0;
+
+#ifdef __SSE2__
+    //- 8 pixels at once: saturation masks, widened long and scaled short, blend
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i threshold = _mm_set1_epi16((short)m_saturation_threshold);
+    const __m128 scale = _mm_set1_ps(ratio);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 two_31 = _mm_set1_ps(2147483648.f);
+    const __m128i sign = _mm_set1_epi32(0x80000000);
+    for(; i + 8 <= m_nb_pixels; i += 8)
+    {
+        __m128i long_pixels = _mm_loadu_si128((const __m128i*)(frame + i));
+        __m128i short_pixels = _mm_loadu_si128((const __m128i*)(short_frame + i));
+        //- pixel >= threshold <=> (threshold -sat pixel) == 0
+        __m128i long_saturated = _mm_cmpeq_epi16(_mm_subs_epu16(threshold, long_pixels), zero);
+        __m128i short_saturated = _mm_and_si128(long_saturated,
+                                                _mm_cmpeq_epi16(_mm_subs_epu16(threshold, short_pixels), zero));
+
+        __m128 short_lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(short_pixels, zero));
+        __m128 short_hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(short_pixels, zero));
+        //- unsigned conversion (scaled values up to 65535 x 65536): 2^31 is removed before the signed one
+        //- and put back in the sign bit
+        __m128 value_lo = _mm_add_ps(_mm_mul_ps(short_lo, scale), half);
+        __m128 value_hi = _mm_add_ps(_mm_mul_ps(short_hi, scale), half);
+        __m128 high_lo = _mm_cmpge_ps(value_lo, two_31);
+        __m128 high_hi = _mm_cmpge_ps(value_hi, two_31);
+        __m128i scaled_lo = _mm_xor_si128(_mm_cvttps_epi32(_mm_sub_ps(value_lo, _mm_and_ps(high_lo, two_31))),
+                                          _mm_and_si128(_mm_castps_si128(high_lo), sign));
+        __m128i scaled_hi = _mm_xor_si128(_mm_cvttps_epi32(_mm_sub_ps(value_hi, _mm_and_ps(high_hi, two_31))),
+                                          _mm_and_si128(_mm_castps_si128(high_hi), sign));
+        __m128i mask_lo = _mm_unpacklo_epi16(long_saturated, long_saturated);
+        __m128i mask_hi = _mm_unpackhi_epi16(long_saturated, long_saturated);
+        __m128i long_lo = _mm_unpacklo_epi16(long_pixels, zero);
+        __m128i long_hi = _mm_unpackhi_epi16(long_pixels, zero);
+        _mm_storeu_si128((__m128i*)(merged + i),
+                         _mm_or_si128(_mm_and_si128(mask_lo, scaled_lo), _mm_andnot_si128(mask_lo, long_lo)));
+        _mm_storeu_si128((__m128i*)(merged + i + 4),
+                         _mm_or_si128(_mm_and_si128(mask_hi, scaled_hi), _mm_andnot_si128(mask_hi, long_hi)));
+
+        //- map byte = (long saturated) + (short saturated)
+        __m128i long_flags = _mm_packs_epi16(long_saturated, long_saturated);
+        __m128i short_flags = _mm_packs_epi16(short_saturated, short_saturated);
+        __m128i flags = _mm_add_epi8(_mm_and_si128(long_flags, one), _mm_and_si128(short_flags, one));
+        _mm_storel_epi64((__m128i*)(map + i), flags);
+        nb_short += __builtin_popcount(_mm_movemask_epi8(long_flags) & 0xFF);
+        nb_saturated += __builtin_popcount(_mm_movemask_epi8(short_flags) & 0xFF);
+    }
+#endif
+    for(; i < m_nb_pixels; i++)
+    {
+        bool long_saturated = frame[i] >= m_saturation_threshold;
+        bool short_saturated = long_saturated && short_frame[i] >= m_saturation_threshold;
+        merged[i] = long_saturated ? uint32_t(short_frame[i] * ratio + 0.5f) : frame[i];
+        map[i] = uint8_t(long_saturated) + uint8_t(short_saturated);
+        nb_short += long_saturated;
+        nb_saturated += short_saturated;
+    }
+
+    //- frame complete: keep its statistics and map for the readers
+    int frame_nb = hw_frame_nb / 2;
+    AutoMutex lock(m_lock);
+    Stats& stats = m_stats[frame_nb % HDR_HISTORY];
+    stats.frame_nb = frame_nb;
+    stats.nb_long_pixels = m_nb_pixels - nb_short;
+    stats.nb_short_pixels = nb_short;
+    stats.nb_saturated_pixels = nb_saturated;
+    m_last_map.swap(m_map);
+    if(m_map.size() != size_t(m_nb_pixels))
+        m_map.resize(m_nb_pixels);
+    return true;
+}
+
+//-----------------------------------------------------
+//		merge statistics of a frame
+//-----------------------------------------------------
+bool HdrMerger::getStats(int frame_nb, Stats& stats)
+{
+    AutoMutex lock(m_lock);
+    if(frame_nb < 0 || m_stats.empty())
+        return false;
+    const Stats& frame_stats = m_stats[frame_nb % HDR_HISTORY];
+    if(frame_stats.frame_nb != frame_nb)
+        return false;
+    stats = frame_stats;
+    return true;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void HdrMerger::getMergeMap(std::vector<uint8_t>& merge_map)
+{
+    AutoMutex lock(m_lock);
+    merge_map = m_last_map;
+}
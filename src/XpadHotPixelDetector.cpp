@@ -0,0 +1,176 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "XpadHotPixelDetector.h"
+#include "lima/Exceptions.h"
+#include <algorithm>
+#include <math.h>
+
+using namespace lima;
+using namespace lima::Xpad;
+
+//---------------------------
+//- Ctor
+//---------------------------
+HotPixelDetector::HotPixelDetector() :
+                    m_active(false),
+                    m_k_sigma(5),
+                    m_nb_hot(0),
+                    m_nb_cold(0),
+                    m_nb_noisy(0)
+{
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void HotPixelDetector::setActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+
+    m_active = active;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void HotPixelDetector::setKSigma(double k_sigma)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(k_sigma);
+
+    if(k_sigma <= 0)
+        throw LIMA_HW_EXC(InvalidValue, "Hot pixel k sigma should be > 0");
+
+    m_k_sigma = k_sigma;
+}
+
+//-----------------------------------------------------
+//		median and robust sigma (values are reordered)
+//-----------------------------------------------------
+void HotPixelDetector::robustStats(std::vector<float>& values, double& median, double& sigma)
+{
+    size_t middle = values.size() / 2;
+    std::nth_element(values.begin(), values.begin() + middle, values.end());
+    median = values[middle];
+    for(size_t i = 0; i < values.size(); i++)
+        values[i] = float(fabs(values[i] - median));
+    std::nth_element(values.begin(), values.begin() + middle, values.end());
+    sigma = 1.4826 * values[middle];
+}
+
+//-----------------------------------------------------
+//		flag the pixels of each chip
+//-----------------------------------------------------
+void HotPixelDetector::detect(const std::vector<float>& mean, const std::vector<float>& variance, int nb_frames,
+                              int width, int height, int nb_chip_columns, int nb_chip_rows)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR4(nb_frames, width, height, m_k_sigma);
+
+    if(nb_frames < 2)
+        throw LIMA_HW_EXC(Error, "Hot pixel detection needs pixel statistics of at least 2 frames");
+    if(mean.size() != (size_t)width * height || variance.size() != mean.size())
+        throw LIMA_HW_EXC(Error, "Pixel statistics maps do not correspond to the image size");
+    if(nb_chip_columns < 1 || nb_chip_rows < 1)
+        throw LIMA_HW_EXC(InvalidValue, "Invalid chip grid");
+
+    std::vector<uint8_t> mask(mean.size(), 0);
+    std::vector<float> values;
+    int nb_hot = 0, nb_cold = 0, nb_noisy = 0;
+
+    for(int chip_row = 0; chip_row < nb_chip_rows; chip_row++)
+    {
+        int y_begin = chip_row * height / nb_chip_rows;
+        int y_end = (chip_row + 1) * height / nb_chip_rows;
+        for(int chip_column = 0; chip_column < nb_chip_columns; chip_column++)
+        {
+            int x_begin = chip_column * width / nb_chip_columns;
+            int x_end = (chip_column + 1) * width / nb_chip_columns;
+            if(x_end <= x_begin || y_end <= y_begin)
+                continue;
+
+            double mean_median, mean_sigma, variance_median, variance_sigma;
+            values.clear();
+            for(int y = y_begin; y < y_end; y++)
+                values.insert(values.end(), mean.begin() + y * width + x_begin, mean.begin() + y * width + x_end);
+            robustStats(values, mean_median, mean_sigma);
+            values.clear();
+            for(int y = y_begin; y < y_end; y++)
+                values.insert(values.end(), variance.begin() + y * width + x_begin, variance.begin() + y * width + x_end);
+            robustStats(values, variance_median, variance_sigma);
+
+            //- a flat chip (e.g. dark) still has the counting noise: error of a mean over n frames, of a variance
+            mean_sigma = std::max(mean_sigma, sqrt(std::max(mean_median, 1.) / nb_frames));
+            variance_sigma = std::max(variance_sigma, std::max(variance_median, 1.) * sqrt(2. / (nb_frames - 1)));
+
+            double hot_level = mean_median + m_k_sigma * mean_sigma;
+            double cold_level = mean_median - m_k_sigma * mean_sigma;
+            double noisy_level = variance_median + m_k_sigma * variance_sigma;
+            for(int y = y_begin; y < y_end; y++)
+            {
+                for(int x = x_begin; x < x_end; x++)
+                {
+                    int i = y * width + x;
+                    uint8_t flags = 0;
+                    if(mean[i] > hot_level)
+                        flags |= HOT_PIXEL;
+                    else if(mean[i] < cold_level)
+                        flags |= COLD_PIXEL;
+                    if(variance[i] > noisy_level)
+                        flags |= NOISY_PIXEL;
+                    mask[i] = flags;
+                    nb_hot += (flags & HOT_PIXEL) != 0;
+                    nb_cold += (flags & COLD_PIXEL) != 0;
+                    nb_noisy += (flags & NOISY_PIXEL) != 0;
+                }
+            }
+        }
+    }
+
+    DEB_TRACE() << "Hot pixel detection: " << DEB_VAR3(nb_hot, nb_cold, nb_noisy);
+    AutoMutex lock(m_lock);
+    m_mask.swap(mask);
+    m_nb_hot = nb_hot;
+    m_nb_cold = nb_cold;
+    m_nb_noisy = nb_noisy;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void HotPixelDetector::getMask(std::vector<uint8_t>& mask)
+{
+    AutoMutex lock(m_lock);
+    mask = m_mask;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void HotPixelDetector::getNbPixels(int& nb_hot, int& nb_cold, int& nb_noisy)
+{
+    AutoMutex lock(m_lock);
+    nb_hot = m_nb_hot;
+    nb_cold = m_nb_cold;
+    nb_noisy = m_nb_noisy;
+}
@@ -0,0 +1,157 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "XpadImageTransform.h"
+#include <string.h>
+#include <stdint.h>
+
+using namespace lima;
+using namespace lima::Xpad;
+
+//- edge of the square tiles used for the transposed writes (90 and 270 deg)
+//- 32x32 pixels of 32 bits = 4 KB: src and dst tiles both stay in L1
+static const int TRANSFORM_TILE = 32;
+
+//---------------------------
+//- Ctor
+//---------------------------
+ImageTransform::ImageTransform() :
+                    m_width(0),
+                    m_height(0),
+                    m_swap_axes(false),
+                    m_identity(true),
+                    m_base(0),
+                    m_dx(1),
+                    m_dy(0)
+{
+}
+
+//-----------------------------------------------------
+//		index in dst of the src pixel (x,y)
+//-----------------------------------------------------
+long ImageTransform::_dstIndex(long x, long y, const Flip& flip, RotationMode rotation) const
+{
+    long xf = flip.x ? (m_width - 1 - x) : x;
+    long yf = flip.y ? (m_height - 1 - y) : y;
+
+    switch(rotation)
+    {
+        case Rotation_90: //- clockwise: dst width is the src height
+            return xf * m_height + (m_height - 1 - yf);
+        case Rotation_180:
+            return (m_height - 1 - yf) * m_width + (m_width - 1 - xf);
+        case Rotation_270:
+            return (m_width - 1 - xf) * m_height + yf;
+        case Rotation_0:
+        default:
+            return yf * m_width + xf;
+    }
+}
+
+//-----------------------------------------------------
+//		compute the index mapping
+//-----------------------------------------------------
+void ImageTransform::setup(const Size& src_size, const Flip& flip, RotationMode rotation)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR3(src_size, flip, rotation);
+
+    m_width     = src_size.getWidth();
+    m_height    = src_size.getHeight();
+    m_swap_axes = (rotation == Rotation_90) || (rotation == Rotation_270);
+
+    //- the mapping is affine: deduce it from 3 points
+    m_base  = _dstIndex(0, 0, flip, rotation);
+    m_dx    = _dstIndex(1, 0, flip, rotation) - m_base;
+    m_dy    = _dstIndex(0, 1, flip, rotation) - m_base;
+
+    m_identity = (m_base == 0) && (m_dx == 1) && (m_dy == m_width);
+
+    DEB_TRACE() << "ImageTransform: base = " << m_base << " | dx = " << m_dx << " | dy = " << m_dy;
+}
+
+//-----------------------------------------------------
+//		size of the image written in the lima buffer
+//-----------------------------------------------------
+void ImageTransform::getDstSize(Size& dst_size) const
+{
+    if(m_swap_axes)
+        dst_size = Size(m_height, m_width);
+    else
+        dst_size = Size(m_width, m_height);
+}
+
+//-----------------------------------------------------
+//		write the rows [row_begin, row_end[ of src into dst
+//-----------------------------------------------------
+template<typename T>
+void ImageTransform::apply(const T* src, T* dst, int row_begin, int row_end) const
+{
+    if(m_identity)
+    {
+        //- plain copy
+        memcpy(dst + (long)row_begin * m_width, src + (long)row_begin * m_width, (long)(row_end - row_begin) * m_width * sizeof(T));
+        return;
+    }
+
+    if(m_dx == 1 || m_dx == -1)
+    {
+        //- no rotation or 180 deg: rows stay rows, possibly reversed
+        for(int y = row_begin; y < row_end; y++)
+        {
+            const T* s = src + (long)y * m_width;
+            T* d = dst + m_base + (long)y * m_dy;
+            if(m_dx == 1)
+            {
+                memcpy(d, s, m_width * sizeof(T));
+            }
+            else
+            {
+                for(int x = 0; x < m_width; x++)
+                    d[-x] = s[x];
+            }
+        }
+        return;
+    }
+
+    //- 90 or 270 deg: src rows become dst columns
+    //- work on square tiles so that the strided reads hit L1 and the writes are contiguous
+    for(int y0 = row_begin; y0 < row_end; y0 += TRANSFORM_TILE)
+    {
+        int y1 = (y0 + TRANSFORM_TILE < row_end) ? y0 + TRANSFORM_TILE : row_end;
+        for(int x0 = 0; x0 < m_width; x0 += TRANSFORM_TILE)
+        {
+            int x1 = (x0 + TRANSFORM_TILE < m_width) ? x0 + TRANSFORM_TILE : m_width;
+            for(int x = x0; x < x1; x++)
+            {
+                const T* s = src + x;
+                T* d = dst + m_base + (long)x * m_dx;
+                for(int y = y0; y < y1; y++)
+                    d[(long)y * m_dy] = s[(long)y * m_width];
+            }
+        }
+    }
+}
+
+//- instantiations used by the Camera
+template void ImageTransform::apply<uint16_t>(const uint16_t*, uint16_t*, int, int) const;
+template void ImageTransform::apply<uint32_t>(const uint32_t*, uint32_t*, int, int) const;
+template void ImageTransform::apply<float>(const float*, float*, int, int) const;
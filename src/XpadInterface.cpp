@@ -29,7 +29,7 @@ using namespace lima::Xpad;
  * \brief Hw Interface constructor
  *******************************************************************/
 Interface::Interface(Camera& cam)
-	: m_cam(cam),m_det_info(cam), m_buffer(cam),m_sync(cam)
+	: m_cam(cam),m_det_info(cam), m_buffer(cam),m_sync(cam),m_flip(cam)
 {
 	DEB_CONSTRUCTOR();
 
@@ -44,6 +44,9 @@ Interface::Interface(Camera& cam)
 
     HwEventCtrlObj *my_event = &m_event;
 	m_cap_list.push_back(HwCap(my_event));
+
+	HwFlipCtrlObj *flip = &m_flip;
+	m_cap_list.push_back(HwCap(flip));
 }
 
 //-----------------------------------------------------
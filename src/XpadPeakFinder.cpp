@@ -0,0 +1,450 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "XpadPeakFinder.h"
+#include "lima/Exceptions.h"
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
+
+using namespace lima;
+using namespace lima::Xpad;
+
+//- rows of a band (unit of work of the threads)
+static const int PEAK_FINDER_BAND_NB_ROW = 32;
+
+//- peaks of a frame are given in row major order of their centroid
+static bool _peakBefore(const PeakFinder::Peak& a, const PeakFinder::Peak& b)
+{
+    return (a.y < b.y) || (a.y == b.y && a.x < b.x);
+}
+
+//- the jobs get the image untyped
+static inline int _pixelType(const uint16_t*) {return 0;}
+static inline int _pixelType(const uint32_t*) {return 1;}
+static inline int _pixelType(const float*) {return 2;}
+
+//---------------------------
+//- Ctor
+//---------------------------
+PeakFinder::PeakFinder() :
+                    m_staged_active(false),
+                    m_active(false),
+                    m_width(0),
+                    m_height(0),
+                    m_image(0),
+                    m_pixel_type(UINT16),
+                    m_next_band(0),
+                    m_nb_bands(0),
+                    m_frame_nb(-1),
+                    m_nb_frames(0),
+                    m_nb_hits(0)
+{
+    m_staged_params.threshold = 2;
+    m_staged_params.snr = 6;
+    m_staged_params.background_radius = 4;
+    m_staged_params.min_nb_pixels = 1;
+    m_staged_params.max_nb_pixels = 50;
+    m_staged_params.min_nb_peaks = 10;
+    m_params = m_staged_params;
+}
+
+//---------------------------
+//- Dtor
+//---------------------------
+PeakFinder::~PeakFinder()
+{
+    m_pool.wait();
+    for(size_t i = 0; i < m_jobs.size(); i++)
+        delete m_jobs[i];
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void PeakFinder::setActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+
+    AutoMutex lock(m_lock);
+    m_staged_active = active;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+bool PeakFinder::getActive()
+{
+    AutoMutex lock(m_lock);
+    return m_staged_active;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void PeakFinder::setNbThreads(int nb_threads)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_pool.setNbThreads(nb_threads);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void PeakFinder::setThreshold(double threshold)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(threshold);
+
+    AutoMutex lock(m_lock);
+    m_staged_params.threshold = threshold;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void PeakFinder::setSnr(double snr)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(snr);
+
+    if(snr < 0)
+        throw LIMA_HW_EXC(InvalidValue, "Peak signal to noise should be >= 0");
+
+    AutoMutex lock(m_lock);
+    m_staged_params.snr = snr;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void PeakFinder::setBackgroundRadius(int radius)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(radius);
+
+    if(radius < 2)
+        throw LIMA_HW_EXC(InvalidValue, "Background radius should be >= 2");
+
+    AutoMutex lock(m_lock);
+    m_staged_params.background_radius = radius;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void PeakFinder::setPixelRange(int min_nb_pixels, int max_nb_pixels)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(min_nb_pixels, max_nb_pixels);
+
+    if(min_nb_pixels < 1 || max_nb_pixels < min_nb_pixels)
+        throw LIMA_HW_EXC(InvalidValue, "Invalid peak number of pixels range");
+
+    AutoMutex lock(m_lock);
+    m_staged_params.min_nb_pixels = min_nb_pixels;
+    m_staged_params.max_nb_pixels = max_nb_pixels;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void PeakFinder::setMinNbPeaks(int min_nb_peaks)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(min_nb_peaks);
+
+    if(min_nb_peaks < 0)
+        throw LIMA_HW_EXC(InvalidValue, "Minimum number of peaks should be >= 0");
+
+    AutoMutex lock(m_lock);
+    m_staged_params.min_nb_peaks = min_nb_peaks;
+}
+
+//-----------------------------------------------------
+//		clear the peak lists
+//-----------------------------------------------------
+void PeakFinder::prepare(const Size& image_size)
+{
+    DEB_MEMBER_FUNCT();
+
+    AutoMutex lock(m_lock);
+    m_active = m_staged_active;
+    m_params = m_staged_params;
+    m_frames.clear();
+    m_nb_frames = 0;
+    m_nb_hits = 0;
+    if(!m_active)
+        return;
+
+    m_width = image_size.getWidth();
+    m_height = image_size.getHeight();
+    m_nb_bands = (m_height + PEAK_FINDER_BAND_NB_ROW - 1) / PEAK_FINDER_BAND_NB_ROW;
+
+    //- one job per thread, each with its own flood fill map
+    int nb_threads = m_pool.getNbThreads();
+    while(int(m_jobs.size()) > nb_threads)
+    {
+        delete m_jobs.back();
+        m_jobs.pop_back();
+    }
+    while(int(m_jobs.size()) < nb_threads)
+        m_jobs.push_back(new BandJob(*this));
+    for(size_t i = 0; i < m_jobs.size(); i++)
+    {
+        m_jobs[i]->m_visited.assign(m_width * m_height, 0);
+        m_jobs[i]->m_pixels.reserve(m_params.max_nb_pixels + 1);
+    }
+
+    m_frames.resize(PEAK_FINDER_HISTORY);
+    for(int i = 0; i < PEAK_FINDER_HISTORY; i++)
+        m_frames[i].frame_nb = -1;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void PeakFinder::startFrame(int frame_nb)
+{
+    m_frame_nb = frame_nb;
+    m_peaks.clear();
+}
+
+//-----------------------------------------------------
+//		find the peaks, one band at a time in each thread
+//-----------------------------------------------------
+template<typename T>
+void PeakFinder::process(const T* image)
+{
+    m_image = image;
+    m_pixel_type = PixelType(_pixelType(image));
+    m_next_band = 0;
+    for(size_t i = 0; i < m_jobs.size(); i++)
+    {
+        m_jobs[i]->m_peaks.clear();
+        m_pool.post(m_jobs[i]);
+    }
+    m_pool.wait();
+
+    for(size_t i = 0; i < m_jobs.size(); i++)
+        m_peaks.insert(m_peaks.end(), m_jobs[i]->m_peaks.begin(), m_jobs[i]->m_peaks.end());
+    std::sort(m_peaks.begin(), m_peaks.end(), _peakBefore);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void PeakFinder::BandJob::run()
+{
+    PeakFinder& finder = m_finder;
+    int band;
+    while((band = __sync_fetch_and_add(&finder.m_next_band, 1)) < finder.m_nb_bands)
+    {
+        int row_begin = band * PEAK_FINDER_BAND_NB_ROW;
+        int row_end = std::min(row_begin + PEAK_FINDER_BAND_NB_ROW, finder.m_height);
+        switch(finder.m_pixel_type)
+        {
+            case UINT16:
+                finder._findPeaks((const uint16_t*)finder.m_image, row_begin, row_end, *this);
+                break;
+            case UINT32:
+                finder._findPeaks((const uint32_t*)finder.m_image, row_begin, row_end, *this);
+                break;
+            case FLOAT:
+                finder._findPeaks((const float*)finder.m_image, row_begin, row_end, *this);
+                break;
+        }
+    }
+}
+
+//-----------------------------------------------------
+//		peaks whose seed is in the rows [row_begin, row_end[
+//-----------------------------------------------------
+template<typename T>
+void PeakFinder::_findPeaks(const T* image, int row_begin, int row_end, BandJob& job) const
+{
+    const int width = m_width;
+    const int height = m_height;
+    const double threshold = m_params.threshold;
+    const int r_out = m_params.background_radius;
+    const int r_in = r_out / 2;
+    std::vector<uint8_t>& visited = job.m_visited;
+    std::vector<int>& pixels = job.m_pixels;
+
+    for(int y = row_begin; y < row_end; y++)
+    {
+        const T* row = image + (long)y * width;
+        for(int x = 0; x < width; x++)
+        {
+            double value = row[x];
+            if(value < threshold)
+                continue;
+
+            //- local maximum (an equal neighbour before in scan order wins)
+            bool is_max = true;
+            for(int dy = -1; dy <= 1 && is_max; dy++)
+            {
+                int ny = y + dy;
+                if(ny < 0 || ny >= height)
+                    continue;
+                for(int dx = -1; dx <= 1; dx++)
+                {
+                    int nx = x + dx;
+                    if((!dx && !dy) || nx < 0 || nx >= width)
+                        continue;
+                    double neighbour = image[(long)ny * width + nx];
+                    bool before = (dy < 0) || (dy == 0 && dx < 0);
+                    if(neighbour > value || (before && neighbour == value))
+                    {
+                        is_max = false;
+                        break;
+                    }
+                }
+            }
+            if(!is_max)
+                continue;
+
+            //- local background: annulus r_in < max(|dx|, |dy|) <= r_out
+            double sum = 0, sum2 = 0;
+            int nb = 0;
+            for(int ny = std::max(y - r_out, 0); ny <= std::min(y + r_out, height - 1); ny++)
+            {
+                const T* background_row = image + (long)ny * width;
+                bool inner_row = std::abs(ny - y) <= r_in;
+                for(int nx = std::max(x - r_out, 0); nx <= std::min(x + r_out, width - 1); nx++)
+                {
+                    if(inner_row && std::abs(nx - x) <= r_in)
+                        continue;
+                    double v = background_row[nx];
+                    sum += v;
+                    sum2 += v * v;
+                    nb++;
+                }
+            }
+            double background = nb ? sum / nb : 0;
+            double sigma = nb ? sqrt(std::max(sum2 / nb - background * background, 0.)) : 0;
+            //- photon counting: the background noise is at least one count
+            double level = std::max(background + m_params.snr * std::max(sigma, 1.), threshold);
+            if(value < level)
+                continue;
+
+            //- 8-connected component of the pixels above the level
+            int seed = y * width + x;
+            bool is_peak = true;
+            pixels.clear();
+            pixels.push_back(seed);
+            visited[seed] = 1;
+            for(size_t head = 0; head < pixels.size() && is_peak; head++)
+            {
+                int px = pixels[head] % width;
+                int py = pixels[head] / width;
+                for(int ny = std::max(py - 1, 0); ny <= std::min(py + 1, height - 1) && is_peak; ny++)
+                {
+                    for(int nx = std::max(px - 1, 0); nx <= std::min(px + 1, width - 1); nx++)
+                    {
+                        int index = ny * width + nx;
+                        if(visited[index])
+                            continue;
+                        double v = image[index];
+                        if(v < level)
+                            continue;
+                        //- another seed holds the maximum of this component, or too large
+                        if(v > value || (v == value && index < seed) ||
+                           int(pixels.size()) == m_params.max_nb_pixels)
+                        {
+                            is_peak = false;
+                            break;
+                        }
+                        visited[index] = 1;
+                        pixels.push_back(index);
+                    }
+                }
+            }
+            for(size_t i = 0; i < pixels.size(); i++)
+                visited[pixels[i]] = 0;
+            if(!is_peak || int(pixels.size()) < m_params.min_nb_pixels)
+                continue;
+
+            Peak peak;
+            double intensity = 0, cx = 0, cy = 0;
+            for(size_t i = 0; i < pixels.size(); i++)
+            {
+                double w = double(image[pixels[i]]) - background;
+                intensity += w;
+                cx += w * (pixels[i] % width);
+                cy += w * (pixels[i] / width);
+            }
+            peak.x = float(intensity > 0 ? cx / intensity : x);
+            peak.y = float(intensity > 0 ? cy / intensity : y);
+            peak.intensity = float(intensity);
+            peak.max_value = float(value - background);
+            peak.background = float(background);
+            peak.nb_pixels = int(pixels.size());
+            job.m_peaks.push_back(peak);
+        }
+    }
+}
+
+//-----------------------------------------------------
+//		keep the peak list of the frame
+//-----------------------------------------------------
+void PeakFinder::endFrame()
+{
+    AutoMutex lock(m_lock);
+    FramePeaks& frame = m_frames[m_frame_nb % PEAK_FINDER_HISTORY];
+    frame.frame_nb = m_frame_nb;
+    frame.peaks = m_peaks;
+    m_nb_frames++;
+    if(isHit())
+        m_nb_hits++;
+}
+
+//-----------------------------------------------------
+//		copy the peaks of a frame
+//-----------------------------------------------------
+bool PeakFinder::getPeaks(int frame_nb, std::vector<Peak>& peaks)
+{
+    AutoMutex lock(m_lock);
+    if(frame_nb < 0 || m_frames.empty())
+        return false;
+    const FramePeaks& frame = m_frames[frame_nb % PEAK_FINDER_HISTORY];
+    if(frame.frame_nb != frame_nb)
+        return false;
+    peaks = frame.peaks;
+    return true;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void PeakFinder::getNbFrames(int& nb_frames, int& nb_hits)
+{
+    AutoMutex lock(m_lock);
+    nb_frames = m_nb_frames;
+    nb_hits = m_nb_hits;
+}
+
+//- pixel types of the frame pass
+template void PeakFinder::process<uint16_t>(const uint16_t*);
+template void PeakFinder::process<uint32_t>(const uint32_t*);
+template void PeakFinder::process<float>(const float*);
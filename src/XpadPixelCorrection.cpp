@@ -0,0 +1,507 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "XpadPixelCorrection.h"
+#include "lima/Exceptions.h"
+#include <fstream>
+#include <limits>
+#include <math.h>
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+//- below this value of (1 - count * tau / Texp) the counter is considered as paralyzed
+static const double RATE_MIN_DENOMINATOR = 1e-3;
+//- number of rows of a module in the raw image
+static const int MODULE_NB_ROW = 120;
+//- largest float below 2^32
+static const float RATE_MAX_COUNT_32 = 4294967040.f;
+
+using namespace lima;
+using namespace lima::Xpad;
+
+//---------------------------
+//- Ctor
+//---------------------------
+PixelCorrection::PixelCorrection() :
+                    m_flat_staged(false),
+                    m_mask_staged(false),
+                    m_rate_staged(false),
+                    m_flat_active(false),
+                    m_mask_active(false),
+                    m_rate_active(false),
+                    m_fill_value(0),
+                    m_rate_per_pixel(false),
+                    m_flat_on(false),
+                    m_mask_on(false),
+                    m_rate_on(false),
+                    m_width(0)
+{
+}
+
+//-----------------------------------------------------
+//		read a raw binary file of exactly nb_bytes
+//-----------------------------------------------------
+void PixelCorrection::_readFile(const std::string& path, size_t nb_bytes, char* buffer)
+{
+    DEB_STATIC_FUNCT();
+
+    std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+    if(!file)
+        THROW_HW_ERROR(Error) << "Unable to open the file: " << path;
+
+    file.seekg(0, std::ios::end);
+    size_t file_size = file.tellg();
+    if(file_size != nb_bytes)
+    {
+        DEB_ERROR() << path << ": " << file_size << " bytes, expected " << nb_bytes;
+        THROW_HW_ERROR(Error) << "File size does not correspond to the image size: " << path;
+    }
+
+    file.seekg(0, std::ios::beg);
+    file.read(buffer, nb_bytes);
+    if(!file)
+        THROW_HW_ERROR(Error) << "Error while reading the file: " << path;
+}
+
+//-----------------------------------------------------
+//		load a flat field map (float32)
+//-----------------------------------------------------
+void PixelCorrection::loadFlatField(const std::string& path, const Size& image_size)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(path, image_size);
+
+    size_t nb_pixels = (size_t)image_size.getWidth() * image_size.getHeight();
+    std::vector<float> flat(nb_pixels);
+    _readFile(path, nb_pixels * sizeof(float), (char*)&flat[0]);
+
+    //- convert once into fixed point factors
+    std::vector<uint32_t> factors(nb_pixels);
+    double one = (double)(1 << FLAT_FIELD_FRACTION_BITS);
+    double max_factor = (double)std::numeric_limits<uint32_t>::max();
+    for(size_t i = 0; i < nb_pixels; i++)
+    {
+        double factor = floor(flat[i] * one + 0.5);
+        if(!(factor > 0.)) //- negative or NaN
+            factor = 0.;
+        else if(factor > max_factor)
+            factor = max_factor;
+        factors[i] = (uint32_t)factor;
+    }
+
+    AutoMutex lock(m_lock);
+    m_staged_flat.swap(factors);
+    m_flat_staged = true;
+    DEB_TRACE() << "flat field loaded from " << path << ": will be used from the next prepare";
+}
+
+//-----------------------------------------------------
+//		load a pixel mask (uint8)
+//-----------------------------------------------------
+void PixelCorrection::loadMask(const std::string& path, const Size& image_size)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(path, image_size);
+
+    size_t nb_pixels = (size_t)image_size.getWidth() * image_size.getHeight();
+    std::vector<uint8_t> mask(nb_pixels);
+    _readFile(path, nb_pixels, (char*)&mask[0]);
+
+    AutoMutex lock(m_lock);
+    m_staged_mask.swap(mask);
+    m_mask_staged = true;
+    DEB_TRACE() << "mask loaded from " << path << ": will be used from the next prepare";
+}
+
+//-----------------------------------------------------
+//		set a pixel mask from memory
+//-----------------------------------------------------
+void PixelCorrection::setMask(const std::vector<uint8_t>& mask, const Size& image_size)
+{
+    DEB_MEMBER_FUNCT();
+
+    if(mask.size() != (size_t)image_size.getWidth() * image_size.getHeight())
+        throw LIMA_HW_EXC(Error, "Mask size does not correspond to the image size");
+
+    AutoMutex lock(m_lock);
+    m_staged_mask = mask;
+    m_mask_staged = true;
+}
+
+//-----------------------------------------------------
+//		staged mask, or the committed one
+//-----------------------------------------------------
+void PixelCorrection::getMask(std::vector<uint8_t>& mask)
+{
+    AutoMutex lock(m_lock);
+    mask = m_mask_staged ? m_staged_mask : m_mask;
+}
+
+//-----------------------------------------------------
+//		set the dead time of each module
+//-----------------------------------------------------
+void PixelCorrection::setModuleDeadTimes(const std::vector<double>& dead_times_ns)
+{
+    DEB_MEMBER_FUNCT();
+
+    for(size_t i = 0; i < dead_times_ns.size(); i++)
+    {
+        if(dead_times_ns[i] < 0.)
+            throw LIMA_HW_EXC(InvalidValue, "Dead time should be positive");
+    }
+
+    AutoMutex lock(m_lock);
+    m_staged_module_dead_times = dead_times_ns;
+    m_staged_pixel_dead_times.clear();
+    m_rate_staged = true;
+}
+
+//-----------------------------------------------------
+//		load a per pixel dead time map (float32, ns)
+//-----------------------------------------------------
+void PixelCorrection::loadDeadTimeMap(const std::string& path, const Size& image_size)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(path, image_size);
+
+    size_t nb_pixels = (size_t)image_size.getWidth() * image_size.getHeight();
+    std::vector<float> dead_times(nb_pixels);
+    _readFile(path, nb_pixels * sizeof(float), (char*)&dead_times[0]);
+
+    AutoMutex lock(m_lock);
+    m_staged_pixel_dead_times.swap(dead_times);
+    m_staged_module_dead_times.clear();
+    m_rate_staged = true;
+    DEB_TRACE() << "dead time map loaded from " << path << ": will be used from the next prepare";
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void PixelCorrection::setRateCorrectionActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+
+    m_rate_active = active;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void PixelCorrection::setFlatFieldActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+
+    m_flat_active = active;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void PixelCorrection::setMaskActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+
+    m_mask_active = active;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void PixelCorrection::setMaskFillValue(unsigned int fill_value)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(fill_value);
+
+    m_fill_value = fill_value;
+}
+
+//-----------------------------------------------------
+//		commit the staged maps
+//-----------------------------------------------------
+void PixelCorrection::prepare(const Size& image_size, unsigned int exp_time_usec, int nb_modules, int module_gap_rows)
+{
+    DEB_MEMBER_FUNCT();
+
+    {
+        AutoMutex lock(m_lock);
+        if(m_flat_staged)
+        {
+            m_flat.swap(m_staged_flat);
+            m_staged_flat.clear();
+            m_flat_staged = false;
+        }
+        if(m_mask_staged)
+        {
+            m_mask.swap(m_staged_mask);
+            m_staged_mask.clear();
+            m_mask_staged = false;
+        }
+        if(m_rate_staged)
+        {
+            m_module_dead_times.swap(m_staged_module_dead_times);
+            m_pixel_dead_times.swap(m_staged_pixel_dead_times);
+            m_staged_module_dead_times.clear();
+            m_staged_pixel_dead_times.clear();
+            m_rate_staged = false;
+        }
+    }
+
+    size_t nb_pixels = (size_t)image_size.getWidth() * image_size.getHeight();
+    m_width = image_size.getWidth();
+
+    m_flat_on = m_flat_active;
+    if(m_flat_on && m_flat.size() != nb_pixels)
+        throw LIMA_HW_EXC(Error, "Flat field correction is enabled but no flat field of the image size is loaded");
+
+    m_mask_on = m_mask_active;
+    if(m_mask_on && m_mask.size() != nb_pixels)
+        throw LIMA_HW_EXC(Error, "Mask correction is enabled but no mask of the image size is loaded");
+
+    m_rate_on = m_rate_active;
+    if(m_rate_on)
+    {
+        if(exp_time_usec == 0)
+            throw LIMA_HW_EXC(Error, "Count rate correction needs a non null exposure time");
+
+        //- k = tau / Texp (tau in ns, Texp in us)
+        double ns_to_exp = 1e-3 / exp_time_usec;
+        m_rate_per_pixel = !m_pixel_dead_times.empty();
+        if(m_rate_per_pixel)
+        {
+            if(m_pixel_dead_times.size() != nb_pixels)
+                throw LIMA_HW_EXC(Error, "Count rate correction is enabled but the dead time map does not correspond to the image size");
+
+            m_rate_k.resize(nb_pixels);
+            for(size_t i = 0; i < nb_pixels; i++)
+                m_rate_k[i] = m_pixel_dead_times[i] * ns_to_exp;
+            m_rate_lut.clear();
+        }
+        else
+        {
+            if(m_module_dead_times.size() != (size_t)nb_modules)
+                throw LIMA_HW_EXC(Error, "Count rate correction is enabled but the number of module dead times does not correspond to the number of modules");
+            if(module_gap_rows < 0)
+                throw LIMA_HW_EXC(Error, "Count rate correction: the module geometry of the corrected image is unknown, load a dead time map");
+
+            m_rate_k.clear();
+            m_module_k.resize(nb_modules);
+            m_rate_lut.resize(nb_modules);
+            for(int module = 0; module < nb_modules; module++)
+            {
+                double k = m_module_dead_times[module] * ns_to_exp;
+                m_module_k[module] = k;
+
+                //- 16 bits: the whole correction is a table lookup
+                std::vector<uint16_t>& lut = m_rate_lut[module];
+                lut.resize(65536);
+                for(int count = 0; count < 65536; count++)
+                {
+                    double den = 1. - count * k;
+                    double corrected = (den > RATE_MIN_DENOMINATOR) ? floor(count / den + 0.5) : 65535.;
+                    lut[count] = (corrected > 65535.) ? 65535 : (uint16_t)corrected;
+                }
+            }
+
+            //- modules are stacked along the rows, the double pixel correction inserts module_gap_rows rows
+            //- between two modules: the first half (with the merged row) comes from the upper module
+            int period = MODULE_NB_ROW + module_gap_rows;
+            m_row_module.resize(image_size.getHeight());
+            for(int row = 0; row < image_size.getHeight(); row++)
+            {
+                int module = row / period;
+                if(row % period >= MODULE_NB_ROW + (module_gap_rows + 1) / 2)
+                    module++;
+                m_row_module[row] = std::min(module, nb_modules - 1);
+            }
+        }
+    }
+
+    DEB_TRACE() << "PixelCorrection: rate = " << m_rate_on << " | flat = " << m_flat_on << " | mask = " << m_mask_on;
+}
+
+//-----------------------------------------------------
+//		count rate correction, 16 bits
+//-----------------------------------------------------
+void PixelCorrection::_correctRate(uint16_t* image, int row_begin, int row_end) const
+{
+    for(int row = row_begin; row < row_end; row++)
+    {
+        uint16_t* line = image + (size_t)row * m_width;
+        if(m_rate_per_pixel)
+        {
+            const float* k = &m_rate_k[(size_t)row * m_width];
+            for(int x = 0; x < m_width; x++)
+            {
+                float den = 1.f - line[x] * k[x];
+                float corrected = (den > RATE_MIN_DENOMINATOR) ? line[x] / den + 0.5f : 65535.f;
+                line[x] = (corrected > 65535.f) ? 65535 : (uint16_t)corrected;
+            }
+        }
+        else
+        {
+            const uint16_t* lut = &m_rate_lut[m_row_module[row]][0];
+            for(int x = 0; x < m_width; x++)
+                line[x] = lut[line[x]];
+        }
+    }
+}
+
+//-----------------------------------------------------
+//		count rate correction, 32 bits
+//-----------------------------------------------------
+void PixelCorrection::_correctRate(uint32_t* image, int row_begin, int row_end) const
+{
+    const float max_count = RATE_MAX_COUNT_32;
+
+    for(int row = row_begin; row < row_end; row++)
+    {
+        uint32_t* line = image + (size_t)row * m_width;
+        const float* k = m_rate_per_pixel ? &m_rate_k[(size_t)row * m_width] : 0;
+        const float k_row = m_rate_per_pixel ? 0.f : m_module_k[m_row_module[row]];
+        int x = 0;
+#ifdef __SSE2__
+        const __m128 one = _mm_set1_ps(1.f);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 min_den = _mm_set1_ps((float)RATE_MIN_DENOMINATOR);
+        const __m128 max_value = _mm_set1_ps(max_count);
+        const __m128 two_16 = _mm_set1_ps(65536.f);
+        const __m128 two_31 = _mm_set1_ps(2147483648.f);
+        const __m128i low_16 = _mm_set1_epi32(0xFFFF);
+        const __m128i sign = _mm_set1_epi32(0x80000000);
+        __m128 vk = _mm_set1_ps(k_row);
+        for(; x + 4 <= m_width; x += 4)
+        {
+            //- the counts are unsigned: converted by 16 bits halves
+            __m128i raw = _mm_loadu_si128((const __m128i*)(line + x));
+            __m128 count = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(raw, 16)), two_16),
+                                      _mm_cvtepi32_ps(_mm_and_si128(raw, low_16)));
+            if(k)
+                vk = _mm_loadu_ps(k + x);
+            __m128 den = _mm_sub_ps(one, _mm_mul_ps(count, vk));
+            //- paralyzed pixels: den is clamped, the result saturates
+            __m128 corrected = _mm_div_ps(count, _mm_max_ps(den, min_den));
+            corrected = _mm_min_ps(_mm_max_ps(corrected, zero), max_value);
+            //- unsigned conversion: 2^31 is removed before the signed one and put back in the sign bit
+            __m128 high = _mm_cmpge_ps(corrected, two_31);
+            __m128i result = _mm_cvtps_epi32(_mm_sub_ps(corrected, _mm_and_ps(high, two_31)));
+            result = _mm_xor_si128(result, _mm_and_si128(_mm_castps_si128(high), sign));
+            _mm_storeu_si128((__m128i*)(line + x), result);
+        }
+#endif
+        for(; x < m_width; x++)
+        {
+            double den = 1. - (double)line[x] * (k ? k[x] : k_row);
+            double corrected = (den > RATE_MIN_DENOMINATOR) ? line[x] / den + 0.5 : max_count;
+            line[x] = (corrected > max_count) ? (uint32_t)max_count : (uint32_t)corrected;
+        }
+    }
+}
+
+//-----------------------------------------------------
+//		count rate correction, float (S540 geometrical correction)
+//-----------------------------------------------------
+void PixelCorrection::_correctRate(float* image, int row_begin, int row_end) const
+{
+    for(int row = row_begin; row < row_end; row++)
+    {
+        float* line = image + (size_t)row * m_width;
+        const float* k = m_rate_per_pixel ? &m_rate_k[(size_t)row * m_width] : 0;
+        const float k_row = m_rate_per_pixel ? 0.f : m_module_k[m_row_module[row]];
+        for(int x = 0; x < m_width; x++)
+        {
+            float den = 1.f - line[x] * (k ? k[x] : k_row);
+            line[x] = (den > RATE_MIN_DENOMINATOR) ? line[x] / den : std::numeric_limits<float>::max();
+        }
+    }
+}
+
+//-----------------------------------------------------
+//		correct in place the rows [row_begin, row_end[
+//-----------------------------------------------------
+template<typename T>
+void PixelCorrection::apply(T* image, int row_begin, int row_end) const
+{
+    size_t begin = (size_t)row_begin * m_width;
+    size_t end   = (size_t)row_end * m_width;
+
+    //- dead time first: it applies to the counts really measured
+    if(m_rate_on)
+        _correctRate(image, row_begin, row_end);
+
+    if(m_flat_on)
+    {
+        const uint64_t max_value = std::numeric_limits<T>::max();
+        const uint64_t round = 1ULL << (FLAT_FIELD_FRACTION_BITS - 1);
+        const uint32_t* flat = &m_flat[0];
+        for(size_t i = begin; i < end; i++)
+        {
+            uint64_t value = ((uint64_t)image[i] * flat[i] + round) >> FLAT_FIELD_FRACTION_BITS;
+            image[i] = (T)((value > max_value) ? max_value : value);
+        }
+    }
+
+    if(m_mask_on)
+    {
+        const T fill = (m_fill_value > std::numeric_limits<T>::max()) ? std::numeric_limits<T>::max() : (T)m_fill_value;
+        const uint8_t* mask = &m_mask[0];
+        for(size_t i = begin; i < end; i++)
+            image[i] = mask[i] ? fill : image[i];
+    }
+}
+
+//-----------------------------------------------------
+//		float images (geometrical correction of the S540)
+//-----------------------------------------------------
+template<>
+void PixelCorrection::apply<float>(float* image, int row_begin, int row_end) const
+{
+    size_t begin = (size_t)row_begin * m_width;
+    size_t end   = (size_t)row_end * m_width;
+
+    if(m_rate_on)
+        _correctRate(image, row_begin, row_end);
+
+    if(m_flat_on)
+    {
+        const float scale = 1.f / (1 << FLAT_FIELD_FRACTION_BITS);
+        const uint32_t* flat = &m_flat[0];
+        for(size_t i = begin; i < end; i++)
+            image[i] *= flat[i] * scale;
+    }
+
+    if(m_mask_on)
+    {
+        const float fill = (float)m_fill_value;
+        const uint8_t* mask = &m_mask[0];
+        for(size_t i = begin; i < end; i++)
+            image[i] = mask[i] ? fill : image[i];
+    }
+}
+
+//- instantiations used by the Camera
+template void PixelCorrection::apply<uint16_t>(uint16_t*, int, int) const;
+template void PixelCorrection::apply<uint32_t>(uint32_t*, int, int) const;
@@ -0,0 +1,359 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "XpadPixelStatistics.h"
+#include "lima/Exceptions.h"
+#include <fstream>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace lima;
+using namespace lima::Xpad;
+
+//- rows of a tile
+static const int PIXEL_STATISTICS_TILE_NB_ROW = 16;
+
+//- the jobs get the image untyped
+static inline int _pixelType(const uint16_t*) {return 0;}
+static inline int _pixelType(const uint32_t*) {return 1;}
+static inline int _pixelType(const float*) {return 2;}
+
+//---------------------------
+//- Ctor
+//---------------------------
+PixelStatistics::PixelStatistics() :
+                    m_staged_active(false),
+                    m_staged_nb_bins(16),
+                    m_staged_bin_min(0),
+                    m_staged_bin_width(1),
+                    m_active(false),
+                    m_nb_bins(16),
+                    m_bin_min(0),
+                    m_bin_width(1),
+                    m_width(0),
+                    m_height(0),
+                    m_nb_tiles(0),
+                    m_image(0),
+                    m_pixel_type(UINT16),
+                    m_next_tile(0),
+                    m_nb_frames(0)
+{
+}
+
+//---------------------------
+//- Dtor
+//---------------------------
+PixelStatistics::~PixelStatistics()
+{
+    m_pool.wait();
+    for(size_t i = 0; i < m_jobs.size(); i++)
+        delete m_jobs[i];
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void PixelStatistics::setActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+
+    AutoMutex lock(m_lock);
+    m_staged_active = active;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+bool PixelStatistics::getActive()
+{
+    AutoMutex lock(m_lock);
+    return m_staged_active;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void PixelStatistics::setNbThreads(int nb_threads)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_pool.setNbThreads(nb_threads);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void PixelStatistics::setHistogram(int nb_bins, double bin_min, double bin_width)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR3(nb_bins, bin_min, bin_width);
+
+    if(nb_bins < 1 || nb_bins > 256)
+        throw LIMA_HW_EXC(InvalidValue, "Histogram number of bins should be in [1, 256]");
+    if(bin_width <= 0)
+        throw LIMA_HW_EXC(InvalidValue, "Histogram bin width should be > 0");
+
+    AutoMutex lock(m_lock);
+    m_staged_nb_bins = nb_bins;
+    m_staged_bin_min = bin_min;
+    m_staged_bin_width = bin_width;
+}
+
+//-----------------------------------------------------
+//		clear the statistics
+//-----------------------------------------------------
+void PixelStatistics::prepare(const Size& image_size)
+{
+    DEB_MEMBER_FUNCT();
+
+    AutoMutex lock(m_lock);
+    AutoMutex data_lock(m_data_lock);
+    m_active = m_staged_active;
+    m_nb_frames = 0;
+    if(!m_active)
+    {
+        m_moments.clear();
+        m_histograms.clear();
+        return;
+    }
+
+    m_nb_bins = m_staged_nb_bins;
+    m_bin_min = m_staged_bin_min;
+    m_bin_width = m_staged_bin_width;
+    m_width = image_size.getWidth();
+    m_height = image_size.getHeight();
+    m_nb_tiles = (m_height + PIXEL_STATISTICS_TILE_NB_ROW - 1) / PIXEL_STATISTICS_TILE_NB_ROW;
+    long nb_pixels = (long)m_width * m_height;
+    m_moments.assign(2 * nb_pixels, 0);
+    m_histograms.assign(nb_pixels * m_nb_bins, 0);
+
+    int nb_threads = m_pool.getNbThreads();
+    while(int(m_jobs.size()) > nb_threads)
+    {
+        delete m_jobs.back();
+        m_jobs.pop_back();
+    }
+    while(int(m_jobs.size()) < nb_threads)
+        m_jobs.push_back(new TileJob(*this));
+
+    DEB_TRACE() << "Pixel statistics: " << m_nb_tiles << " tiles, " << m_nb_bins << " histogram bins";
+}
+
+//-----------------------------------------------------
+//		add the frame, one tile at a time in each thread
+//-----------------------------------------------------
+template<typename T>
+void PixelStatistics::process(const T* image)
+{
+    AutoMutex data_lock(m_data_lock);
+    m_image = image;
+    m_pixel_type = PixelType(_pixelType(image));
+    m_nb_frames++;
+    m_next_tile = 0;
+    for(size_t i = 0; i < m_jobs.size(); i++)
+        m_pool.post(m_jobs[i]);
+    m_pool.wait();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void PixelStatistics::TileJob::run()
+{
+    PixelStatistics& statistics = m_statistics;
+    int tile;
+    while((tile = __sync_fetch_and_add(&statistics.m_next_tile, 1)) < statistics.m_nb_tiles)
+    {
+        switch(statistics.m_pixel_type)
+        {
+            case UINT16:
+                statistics._addTile((const uint16_t*)statistics.m_image, tile);
+                break;
+            case UINT32:
+                statistics._addTile((const uint32_t*)statistics.m_image, tile);
+                break;
+            case FLOAT:
+                statistics._addTile((const float*)statistics.m_image, tile);
+                break;
+        }
+    }
+}
+
+//-----------------------------------------------------
+//		Welford update and histogram of one tile
+//-----------------------------------------------------
+template<typename T>
+void PixelStatistics::_addTile(const T* image, int tile)
+{
+    long first = (long)tile * PIXEL_STATISTICS_TILE_NB_ROW * m_width;
+    int row_end = std::min((tile + 1) * PIXEL_STATISTICS_TILE_NB_ROW, m_height);
+    long nb = (long)row_end * m_width - first;
+    const T* src = image + first;
+    double* mean = &m_moments[2 * first];
+    double* m2 = mean + nb;
+    double inv_n = 1. / m_nb_frames;
+
+    long i = 0;
+#ifdef __SSE2__
+    //- 2 pixels at once
+    const __m128d scale = _mm_set1_pd(inv_n);
+    for(; i + 2 <= nb; i += 2)
+    {
+        __m128d x = _mm_set_pd(double(src[i + 1]), double(src[i]));
+        __m128d old_mean = _mm_loadu_pd(mean + i);
+        __m128d delta = _mm_sub_pd(x, old_mean);
+        __m128d new_mean = _mm_add_pd(old_mean, _mm_mul_pd(delta, scale));
+        _mm_storeu_pd(mean + i, new_mean);
+        _mm_storeu_pd(m2 + i, _mm_add_pd(_mm_loadu_pd(m2 + i), _mm_mul_pd(delta, _mm_sub_pd(x, new_mean))));
+    }
+#endif
+    for(; i < nb; i++)
+    {
+        double x = double(src[i]);
+        double delta = x - mean[i];
+        mean[i] += delta * inv_n;
+        m2[i] += delta * (x - mean[i]);
+    }
+
+    uint32_t* histogram = &m_histograms[first * m_nb_bins];
+    double inv_width = 1. / m_bin_width;
+    int last_bin = m_nb_bins - 1;
+    for(i = 0; i < nb; i++, histogram += m_nb_bins)
+    {
+        double position = (double(src[i]) - m_bin_min) * inv_width;
+        int bin = (position <= 0) ? 0 : (position >= last_bin) ? last_bin : int(position);
+        histogram[bin]++;
+    }
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+int PixelStatistics::getNbFrames()
+{
+    AutoMutex data_lock(m_data_lock);
+    return m_nb_frames;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void PixelStatistics::getSize(int& width, int& height)
+{
+    AutoMutex data_lock(m_data_lock);
+    width = m_width;
+    height = m_height;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+int PixelStatistics::getNbBins()
+{
+    AutoMutex data_lock(m_data_lock);
+    return m_nb_bins;
+}
+
+//-----------------------------------------------------
+//		untile the mean (0) or the m2 (1)
+//-----------------------------------------------------
+void PixelStatistics::_getMoment(int moment, std::vector<float>& map)
+{
+    map.resize(m_moments.size() / 2);
+    for(int tile = 0; tile < m_nb_tiles; tile++)
+    {
+        long first = (long)tile * PIXEL_STATISTICS_TILE_NB_ROW * m_width;
+        int row_end = std::min((tile + 1) * PIXEL_STATISTICS_TILE_NB_ROW, m_height);
+        long nb = (long)row_end * m_width - first;
+        const double* src = &m_moments[2 * first + moment * nb];
+        for(long i = 0; i < nb; i++)
+            map[first + i] = float(src[i]);
+    }
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void PixelStatistics::getMean(std::vector<float>& mean)
+{
+    AutoMutex data_lock(m_data_lock);
+    _getMoment(0, mean);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void PixelStatistics::getVariance(std::vector<float>& variance)
+{
+    AutoMutex data_lock(m_data_lock);
+    _getMoment(1, variance);
+    float scale = (m_nb_frames > 1) ? 1.f / (m_nb_frames - 1) : 0.f;
+    for(size_t i = 0; i < variance.size(); i++)
+        variance[i] *= scale;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void PixelStatistics::getHistograms(std::vector<uint32_t>& histograms)
+{
+    AutoMutex data_lock(m_data_lock);
+    histograms = m_histograms;
+}
+
+//-----------------------------------------------------
+//		write the maps in binary files
+//-----------------------------------------------------
+void PixelStatistics::save(const std::string& prefix)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(prefix);
+
+    std::vector<float> mean, variance;
+    std::vector<uint32_t> histograms;
+    getMean(mean);
+    getVariance(variance);
+    getHistograms(histograms);
+
+    if(mean.empty() || variance.empty())
+        throw LIMA_HW_EXC(Error, "No pixel statistics to save");
+
+    std::string paths[3] = {prefix + "_mean.f32", prefix + "_variance.f32", prefix + "_histogram.u32"};
+    const char* data[3] = {(const char*)&mean[0], (const char*)&variance[0],
+                           histograms.empty() ? 0 : (const char*)&histograms[0]};
+    size_t sizes[3] = {mean.size() * sizeof(float), variance.size() * sizeof(float),
+                       histograms.size() * sizeof(uint32_t)};
+    for(int i = 0; i < 3; i++)
+    {
+        std::ofstream file(paths[i].c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        file.write(data[i], sizes[i]);
+        if(!file)
+            THROW_HW_ERROR(Error) << "Unable to write the file: " << paths[i];
+    }
+    DEB_TRACE() << "Pixel statistics saved in " << prefix << "_*";
+}
+
+//- pixel types of the frame pass
+template void PixelStatistics::process<uint16_t>(const uint16_t*);
+template void PixelStatistics::process<uint32_t>(const uint32_t*);
+template void PixelStatistics::process<float>(const float*);
@@ -0,0 +1,263 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "XpadPumpProbe.h"
+#include "lima/Exceptions.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace lima;
+using namespace lima::Xpad;
+
+//- sum[i] += src[i], i in [0, nb[
+static inline void _add(uint32_t* sum, const uint16_t* src, long nb)
+{
+    long i = 0;
+#ifdef __SSE2__
+    //- 8 pixels widened to 2 x 4 x 32 bits
+    const __m128i zero = _mm_setzero_si128();
+    for(; i + 8 <= nb; i += 8)
+    {
+        __m128i pixels = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i* s = (__m128i*)(sum + i);
+        _mm_storeu_si128(s, _mm_add_epi32(_mm_loadu_si128(s), _mm_unpacklo_epi16(pixels, zero)));
+        _mm_storeu_si128(s + 1, _mm_add_epi32(_mm_loadu_si128(s + 1), _mm_unpackhi_epi16(pixels, zero)));
+    }
+#endif
+    for(; i < nb; i++)
+        sum[i] += src[i];
+}
+
+static inline void _add(uint32_t* sum, const uint32_t* src, long nb)
+{
+    long i = 0;
+#ifdef __SSE2__
+    for(; i + 4 <= nb; i += 4)
+    {
+        __m128i* s = (__m128i*)(sum + i);
+        _mm_storeu_si128(s, _mm_add_epi32(_mm_loadu_si128(s), _mm_loadu_si128((const __m128i*)(src + i))));
+    }
+#endif
+    for(; i < nb; i++)
+        sum[i] += src[i];
+}
+
+static inline void _add(uint32_t* sum, const float* src, long nb)
+{
+    for(long i = 0; i < nb; i++)
+        if(src[i] > 0)
+            sum[i] += uint32_t(src[i] + 0.5f);
+}
+
+//---------------------------
+//- Ctor
+//---------------------------
+PumpProbe::PumpProbe() :
+                    m_staged_active(false),
+                    m_staged_nb_delays(1),
+                    m_staged_publish_period(0),
+                    m_active(false),
+                    m_nb_delays(1),
+                    m_publish_period(0),
+                    m_transform(0),
+                    m_width(0),
+                    m_nb_pixels(0),
+                    m_frame_nb(-1),
+                    m_sum(0),
+                    m_nb_pending(0),
+                    m_nb_publications(0)
+{
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void PumpProbe::setActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+
+    AutoMutex lock(m_lock);
+    m_staged_active = active;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+bool PumpProbe::getActive()
+{
+    AutoMutex lock(m_lock);
+    return m_staged_active;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void PumpProbe::setNbDelays(int nb_delays)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_delays);
+
+    if(nb_delays <= 0)
+        throw LIMA_HW_EXC(InvalidValue, "Number of delays should be > 0");
+
+    AutoMutex lock(m_lock);
+    m_staged_nb_delays = nb_delays;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void PumpProbe::setPublishPeriod(int nb_cycles)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_cycles);
+
+    if(nb_cycles < 0)
+        throw LIMA_HW_EXC(InvalidValue, "Publish period should be >= 0");
+
+    AutoMutex lock(m_lock);
+    m_staged_publish_period = nb_cycles;
+}
+
+//-----------------------------------------------------
+//		clear the sums
+//-----------------------------------------------------
+void PumpProbe::prepare(const Size& image_size, const ImageTransform& transform)
+{
+    DEB_MEMBER_FUNCT();
+
+    AutoMutex lock(m_lock);
+    m_active = m_staged_active;
+    m_nb_delays = m_staged_nb_delays;
+    m_publish_period = m_staged_publish_period;
+    m_nb_pending = 0;
+    m_nb_publications = 0;
+    m_published_sums.clear();
+    m_published_counts.clear();
+    if(!m_active)
+    {
+        m_sums.clear();
+        return;
+    }
+
+    m_transform = &transform;
+    m_width = image_size.getWidth();
+    m_nb_pixels = (long)image_size.getWidth() * image_size.getHeight();
+    m_sums.assign(m_nb_delays * m_nb_pixels, 0);
+    m_counts.assign(m_nb_delays, 0);
+
+    DEB_TRACE() << "Pump-probe: " << m_nb_delays << " delays, publish period " << m_publish_period << " cycles";
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void PumpProbe::startFrame(int frame_nb)
+{
+    m_frame_nb = frame_nb;
+    m_sum = &m_sums[(frame_nb % m_nb_delays) * m_nb_pixels];
+}
+
+//-----------------------------------------------------
+//		add the rows [row_begin, row_end[ to the sum of the frame delay
+//-----------------------------------------------------
+template<typename T>
+void PumpProbe::accumulate(const T* image, int row_begin, int row_end)
+{
+    long begin = (long)row_begin * m_width;
+    _add(m_sum + begin, image + begin, (long)(row_end - row_begin) * m_width);
+}
+
+//-----------------------------------------------------
+//		publish at the end of each period
+//-----------------------------------------------------
+void PumpProbe::endFrame()
+{
+    m_counts[m_frame_nb % m_nb_delays]++;
+    m_nb_pending++;
+
+    if(m_publish_period > 0 && (m_frame_nb + 1) % ((long)m_nb_delays * m_publish_period) == 0)
+        _publish();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void PumpProbe::flush()
+{
+    if(m_active && m_nb_pending)
+        _publish();
+}
+
+//-----------------------------------------------------
+//		copy the sums (lima frame geometry) for the readers
+//-----------------------------------------------------
+void PumpProbe::_publish()
+{
+    DEB_MEMBER_FUNCT();
+
+    AutoMutex lock(m_lock);
+    m_published_sums.resize(m_sums.size());
+    for(int d = 0; d < m_nb_delays; d++)
+        m_transform->apply<uint32_t>(&m_sums[d * m_nb_pixels], &m_published_sums[d * m_nb_pixels]);
+    m_published_counts = m_counts;
+    m_nb_publications++;
+    m_nb_pending = 0;
+    DEB_TRACE() << "Pump-probe sums published after frame " << m_frame_nb;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+int PumpProbe::getNbDelays()
+{
+    AutoMutex lock(m_lock);
+    return m_staged_nb_delays;
+}
+
+//-----------------------------------------------------
+//		copy the published sum of a delay
+//-----------------------------------------------------
+bool PumpProbe::getSum(int delay, std::vector<uint32_t>& sum, int& nb_frames)
+{
+    AutoMutex lock(m_lock);
+    if(delay < 0 || delay >= int(m_published_counts.size()))
+        return false;
+    sum.assign(m_published_sums.begin() + delay * m_nb_pixels, m_published_sums.begin() + (delay + 1) * m_nb_pixels);
+    nb_frames = m_published_counts[delay];
+    return true;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+int PumpProbe::getNbPublications()
+{
+    AutoMutex lock(m_lock);
+    return m_nb_publications;
+}
+
+//- pixel types of the frame pass
+template void PumpProbe::accumulate<uint16_t>(const uint16_t*, int, int);
+template void PumpProbe::accumulate<uint32_t>(const uint32_t*, int, int);
+template void PumpProbe::accumulate<float>(const float*, int, int);
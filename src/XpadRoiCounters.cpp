@@ -0,0 +1,264 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "XpadRoiCounters.h"
+#include "lima/Exceptions.h"
+#include <fstream>
+#include <algorithm>
+#include <string.h>
+
+using namespace lima;
+using namespace lima::Xpad;
+
+//- integer pixels are summed exactly, float pixels in double
+template<typename T> struct RoiSumType { typedef uint64_t type; };
+template<> struct RoiSumType<float> { typedef double type; };
+
+//---------------------------
+//- Ctor
+//---------------------------
+RoiCounters::RoiCounters() :
+                    m_staged_nb_labels(0),
+                    m_buffer_size(65536),
+                    m_nb_labels(0),
+                    m_nb_rois(0),
+                    m_width(0),
+                    m_frame_nb(-1),
+                    m_nb_frames(0)
+{
+    memset(m_rect_sums, 0, sizeof(m_rect_sums));
+    memset(m_label_sums, 0, sizeof(m_label_sums));
+}
+
+//-----------------------------------------------------
+//		set the rectangles
+//-----------------------------------------------------
+void RoiCounters::setRois(const std::vector<int>& rois)
+{
+    DEB_MEMBER_FUNCT();
+
+    if(rois.size() % 4)
+        throw LIMA_HW_EXC(InvalidValue, "Rois should be given as a list of x, y, width, height");
+
+    std::vector<Rect> rects(rois.size() / 4);
+    for(size_t i = 0; i < rects.size(); i++)
+    {
+        rects[i].x      = rois[4 * i];
+        rects[i].y      = rois[4 * i + 1];
+        rects[i].width  = rois[4 * i + 2];
+        rects[i].height = rois[4 * i + 3];
+        if(rects[i].x < 0 || rects[i].y < 0 || rects[i].width <= 0 || rects[i].height <= 0)
+            throw LIMA_HW_EXC(InvalidValue, "Invalid roi");
+    }
+
+    AutoMutex lock(m_lock);
+    if((int)rects.size() + m_staged_nb_labels > MAX_NB_ROI_COUNTERS)
+        throw LIMA_HW_EXC(InvalidValue, "Too many rois");
+    m_staged_rects.swap(rects);
+}
+
+//-----------------------------------------------------
+//		load the label mask
+//-----------------------------------------------------
+void RoiCounters::loadMask(const std::string& path, const Size& image_size)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(path, image_size);
+
+    size_t nb_pixels = (size_t)image_size.getWidth() * image_size.getHeight();
+    std::vector<uint8_t> mask(nb_pixels);
+
+    std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+    if(!file)
+        THROW_HW_ERROR(Error) << "Unable to open the file: " << path;
+    file.seekg(0, std::ios::end);
+    if((size_t)file.tellg() != nb_pixels)
+        THROW_HW_ERROR(Error) << "File size does not correspond to the image size: " << path;
+    file.seekg(0, std::ios::beg);
+    file.read((char*)&mask[0], nb_pixels);
+    if(!file)
+        THROW_HW_ERROR(Error) << "Error while reading the file: " << path;
+
+    int nb_labels = *std::max_element(mask.begin(), mask.end());
+
+    AutoMutex lock(m_lock);
+    if((int)m_staged_rects.size() + nb_labels > MAX_NB_ROI_COUNTERS)
+        throw LIMA_HW_EXC(InvalidValue, "Too many rois");
+    m_staged_mask.swap(mask);
+    m_staged_nb_labels = nb_labels;
+}
+
+//-----------------------------------------------------
+//		remove all the rois
+//-----------------------------------------------------
+void RoiCounters::clear()
+{
+    DEB_MEMBER_FUNCT();
+
+    AutoMutex lock(m_lock);
+    m_staged_rects.clear();
+    m_staged_mask.clear();
+    m_staged_nb_labels = 0;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void RoiCounters::setBufferSize(int nb_frames)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_frames);
+
+    if(nb_frames <= 0)
+        throw LIMA_HW_EXC(InvalidValue, "Roi counters buffer size should be > 0");
+
+    AutoMutex lock(m_lock);
+    m_buffer_size = nb_frames;
+}
+
+//-----------------------------------------------------
+//		check the rois, clear the time series
+//-----------------------------------------------------
+void RoiCounters::prepare(const Size& image_size)
+{
+    DEB_MEMBER_FUNCT();
+
+    AutoMutex lock(m_lock);
+
+    for(size_t i = 0; i < m_staged_rects.size(); i++)
+    {
+        const Rect& rect = m_staged_rects[i];
+        if(rect.x + rect.width > image_size.getWidth() || rect.y + rect.height > image_size.getHeight())
+            THROW_HW_ERROR(Error) << "Roi " << i << " is out of the image " << image_size;
+    }
+    if(!m_staged_mask.empty() && m_staged_mask.size() != (size_t)image_size.getWidth() * image_size.getHeight())
+        throw LIMA_HW_EXC(Error, "Roi mask does not correspond to the image size");
+
+    m_rects     = m_staged_rects;
+    m_mask      = m_staged_mask;
+    m_nb_labels = m_staged_nb_labels;
+    m_nb_rois   = m_rects.size() + m_nb_labels;
+    m_width     = image_size.getWidth();
+
+    m_series.assign((size_t)m_buffer_size * m_nb_rois, 0.);
+    m_nb_frames = 0;
+    m_frame_nb  = -1;
+
+    DEB_TRACE() << "RoiCounters: " << m_rects.size() << " rectangles, " << m_nb_labels << " mask labels";
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void RoiCounters::startFrame(int frame_nb)
+{
+    m_frame_nb = frame_nb;
+    memset(m_rect_sums, 0, sizeof(m_rect_sums));
+    if(m_nb_labels)
+        memset(m_label_sums, 0, sizeof(m_label_sums));
+}
+
+//-----------------------------------------------------
+//		accumulate the rows [row_begin, row_end[
+//-----------------------------------------------------
+template<typename T>
+void RoiCounters::accumulate(const T* image, int row_begin, int row_end)
+{
+    for(size_t i = 0; i < m_rects.size(); i++)
+    {
+        const Rect& rect = m_rects[i];
+        int y_begin = std::max(row_begin, rect.y);
+        int y_end   = std::min(row_end, rect.y + rect.height);
+        typename RoiSumType<T>::type sum = 0;
+        for(int y = y_begin; y < y_end; y++)
+        {
+            const T* p = image + (size_t)y * m_width + rect.x;
+            for(int x = 0; x < rect.width; x++)
+                sum += p[x];
+        }
+        m_rect_sums[i] += sum;
+    }
+
+    if(m_nb_labels)
+    {
+        size_t begin = (size_t)row_begin * m_width;
+        size_t end   = (size_t)row_end * m_width;
+        const uint8_t* label = &m_mask[0];
+        for(size_t i = begin; i < end; i++)
+            m_label_sums[label[i]] += image[i]; //- label 0 (no roi) is ignored
+    }
+}
+
+//-----------------------------------------------------
+//		push the sums of the current frame
+//-----------------------------------------------------
+void RoiCounters::endFrame()
+{
+    AutoMutex lock(m_lock);
+
+    double* counters = &m_series[(size_t)(m_frame_nb % m_buffer_size) * m_nb_rois];
+    int nb_rects = m_rects.size();
+    for(int i = 0; i < nb_rects; i++)
+        counters[i] = m_rect_sums[i];
+    for(int label = 1; label <= m_nb_labels; label++)
+        counters[nb_rects + label - 1] = m_label_sums[label];
+
+    m_nb_frames = m_frame_nb + 1;
+}
+
+//-----------------------------------------------------
+//		copy the counters of [first_frame, first_frame + nb_frames[
+//-----------------------------------------------------
+int RoiCounters::read(int first_frame, int nb_frames, std::vector<double>& counters)
+{
+    DEB_MEMBER_FUNCT();
+
+    AutoMutex lock(m_lock);
+
+    if(first_frame < 0 || first_frame < m_nb_frames - m_buffer_size)
+        throw LIMA_HW_EXC(InvalidValue, "Roi counters of the first frame are no more available");
+
+    int last_frame = std::min(first_frame + nb_frames, m_nb_frames);
+    int nb_read = std::max(last_frame - first_frame, 0);
+
+    counters.resize((size_t)nb_read * m_nb_rois);
+    for(int i = 0; i < nb_read; i++)
+    {
+        const double* src = &m_series[(size_t)((first_frame + i) % m_buffer_size) * m_nb_rois];
+        for(int roi = 0; roi < m_nb_rois; roi++)
+            counters[(size_t)i * m_nb_rois + roi] = src[roi];
+    }
+    return nb_read;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+int RoiCounters::getNbFrames()
+{
+    AutoMutex lock(m_lock);
+    return m_nb_frames;
+}
+
+//- instantiations used by the Camera
+template void RoiCounters::accumulate<uint16_t>(const uint16_t*, int, int);
+template void RoiCounters::accumulate<uint32_t>(const uint32_t*, int, int);
+template void RoiCounters::accumulate<float>(const float*, int, int);
@@ -0,0 +1,458 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "XpadSCurveFitter.h"
+#include "XpadCalibrationCache.h"
+#include "lima/Exceptions.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace lima;
+using namespace lima::Xpad;
+
+//- pixels of a block
+static const long SCURVE_BLOCK_NB_PIXELS = 8192;
+
+//---------------------------
+//- Ctor
+//---------------------------
+SCurveFitter::SCurveFitter() :
+                    m_staged_active(false),
+                    m_dacl_per_ithl(1),
+                    m_dacl_max(63),
+                    m_active(false),
+                    m_width(0),
+                    m_height(0),
+                    m_nb_blocks(0),
+                    m_operation(FIRST_STEP),
+                    m_frame(0),
+                    m_x(0),
+                    m_next_block(0),
+                    m_nb_steps(0),
+                    m_first_ithl(0),
+                    m_previous_ithl(0)
+{
+}
+
+//---------------------------
+//- Dtor
+//---------------------------
+SCurveFitter::~SCurveFitter()
+{
+    m_pool.wait();
+    for(size_t i = 0; i < m_jobs.size(); i++)
+        delete m_jobs[i];
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void SCurveFitter::setActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+
+    AutoMutex lock(m_lock);
+    m_staged_active = active;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+bool SCurveFitter::getActive()
+{
+    AutoMutex lock(m_lock);
+    return m_staged_active;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void SCurveFitter::setNbThreads(int nb_threads)
+{
+    DEB_MEMBER_FUNCT();
+
+    m_pool.setNbThreads(nb_threads);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void SCurveFitter::setDaclCorrection(double dacl_per_ithl, int dacl_max)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(dacl_per_ithl, dacl_max);
+
+    if(dacl_per_ithl == 0)
+        throw LIMA_HW_EXC(InvalidValue, "DACL per ITHL should not be 0");
+    if(dacl_max < 1 || dacl_max > 0xFFFF)
+        throw LIMA_HW_EXC(InvalidValue, "DACL max should be in [1, 65535]");
+
+    AutoMutex lock(m_lock);
+    m_dacl_per_ithl = dacl_per_ithl;
+    m_dacl_max = dacl_max;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void SCurveFitter::getDaclCorrection(double& dacl_per_ithl, int& dacl_max)
+{
+    AutoMutex lock(m_lock);
+    dacl_per_ithl = m_dacl_per_ithl;
+    dacl_max = m_dacl_max;
+}
+
+//-----------------------------------------------------
+//		clear the fit
+//-----------------------------------------------------
+void SCurveFitter::prepare(int width, int height)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(width, height);
+
+    AutoMutex lock(m_lock);
+    m_active = m_staged_active;
+    if(!m_active)
+        return;
+
+    AutoMutex data_lock(m_data_lock);
+    m_width = width;
+    m_height = height;
+    long nb_pixels = (long)width * height;
+    m_nb_blocks = (nb_pixels + SCURVE_BLOCK_NB_PIXELS - 1) / SCURVE_BLOCK_NB_PIXELS;
+    m_counts.assign(nb_pixels, 0);
+    m_previous_counts.assign(nb_pixels, 0);
+    m_sum.assign(nb_pixels, 0);
+    m_sum_x.assign(nb_pixels, 0);
+    m_sum_x2.assign(nb_pixels, 0);
+    m_nb_steps = 0;
+
+    int nb_threads = m_pool.getNbThreads();
+    while(int(m_jobs.size()) > nb_threads)
+    {
+        delete m_jobs.back();
+        m_jobs.pop_back();
+    }
+    while(int(m_jobs.size()) < nb_threads)
+        m_jobs.push_back(new BlockJob(*this));
+
+    DEB_TRACE() << "S-curve fit: " << m_nb_blocks << " blocks";
+}
+
+//-----------------------------------------------------
+//		one block at a time in each thread
+//-----------------------------------------------------
+void SCurveFitter::_run(Operation operation, const void* frame)
+{
+    m_operation = operation;
+    m_frame = frame;
+    m_next_block = 0;
+    for(size_t i = 0; i < m_jobs.size(); i++)
+        m_pool.post(m_jobs[i]);
+    m_pool.wait();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+template<typename T>
+void SCurveFitter::add(const T* frame)
+{
+    AutoMutex data_lock(m_data_lock);
+    _run(sizeof(T) == sizeof(uint16_t) ? ADD_UINT16 : ADD_UINT32, frame);
+}
+
+//-----------------------------------------------------
+//		derivative of the step (from the second one)
+//-----------------------------------------------------
+void SCurveFitter::endStep(int ithl)
+{
+    AutoMutex data_lock(m_data_lock);
+    if(m_nb_steps == 0)
+    {
+        m_first_ithl = ithl;
+        _run(FIRST_STEP, 0);
+    }
+    else
+    {
+        //- the count change is between the two ITHL
+        m_x = 0.5f * float(ithl + m_previous_ithl - 2 * m_first_ithl);
+        _run(NEXT_STEP, 0);
+    }
+    m_previous_ithl = ithl;
+    m_nb_steps++;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void SCurveFitter::BlockJob::run()
+{
+    SCurveFitter& fitter = m_fitter;
+    long nb_pixels = (long)fitter.m_width * fitter.m_height;
+    int block;
+    while((block = __sync_fetch_and_add(&fitter.m_next_block, 1)) < fitter.m_nb_blocks)
+    {
+        long first = block * SCURVE_BLOCK_NB_PIXELS;
+        long last = std::min(first + SCURVE_BLOCK_NB_PIXELS, nb_pixels);
+        switch(fitter.m_operation)
+        {
+            case ADD_UINT16:
+                fitter._addBlock((const uint16_t*)fitter.m_frame, first, last);
+                break;
+            case ADD_UINT32:
+                fitter._addBlock((const uint32_t*)fitter.m_frame, first, last);
+                break;
+            case FIRST_STEP:
+                std::copy(&fitter.m_counts[first], &fitter.m_counts[0] + last, &fitter.m_previous_counts[first]);
+                std::fill(&fitter.m_counts[first], &fitter.m_counts[0] + last, 0);
+                break;
+            case NEXT_STEP:
+                fitter._stepBlock(first, last);
+                break;
+        }
+    }
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+template<typename T>
+void SCurveFitter::_addBlock(const T* frame, long first, long last)
+{
+    uint32_t* counts = &m_counts[0];
+    long i = first;
+#ifdef __SSE2__
+    if(sizeof(T) == sizeof(uint16_t))
+    {
+        //- 8 pixels at once
+        const __m128i zero = _mm_setzero_si128();
+        for(; i + 8 <= last; i += 8)
+        {
+            __m128i x = _mm_loadu_si128((const __m128i*)(frame + i));
+            __m128i* dst = (__m128i*)(counts + i);
+            _mm_storeu_si128(dst, _mm_add_epi32(_mm_loadu_si128(dst), _mm_unpacklo_epi16(x, zero)));
+            _mm_storeu_si128(dst + 1, _mm_add_epi32(_mm_loadu_si128(dst + 1), _mm_unpackhi_epi16(x, zero)));
+        }
+    }
+    else
+    {
+        //- 4 pixels at once
+        for(; i + 4 <= last; i += 4)
+        {
+            __m128i* dst = (__m128i*)(counts + i);
+            _mm_storeu_si128(dst, _mm_add_epi32(_mm_loadu_si128(dst), _mm_loadu_si128((const __m128i*)(frame + i))));
+        }
+    }
+#endif
+    for(; i < last; i++)
+        counts[i] += frame[i];
+}
+
+//-----------------------------------------------------
+//		accumulate the moments of |counts - previous counts|
+//-----------------------------------------------------
+void SCurveFitter::_stepBlock(long first, long last)
+{
+    uint32_t* counts = &m_counts[0];
+    uint32_t* previous = &m_previous_counts[0];
+    float* sum = &m_sum[0];
+    float* sum_x = &m_sum_x[0];
+    float* sum_x2 = &m_sum_x2[0];
+    float x = m_x;
+    float x2 = x * x;
+
+    long i = first;
+#ifdef __SSE2__
+    //- 4 pixels at once
+    const __m128 xs = _mm_set1_ps(x);
+    const __m128 x2s = _mm_set1_ps(x2);
+    const __m128i zero = _mm_setzero_si128();
+    for(; i + 4 <= last; i += 4)
+    {
+        __m128i current = _mm_loadu_si128((const __m128i*)(counts + i));
+        __m128i delta = _mm_sub_epi32(current, _mm_loadu_si128((const __m128i*)(previous + i)));
+        __m128i sign = _mm_srai_epi32(delta, 31);
+        __m128 d = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_xor_si128(delta, sign), sign));
+        _mm_storeu_ps(sum + i, _mm_add_ps(_mm_loadu_ps(sum + i), d));
+        _mm_storeu_ps(sum_x + i, _mm_add_ps(_mm_loadu_ps(sum_x + i), _mm_mul_ps(d, xs)));
+        _mm_storeu_ps(sum_x2 + i, _mm_add_ps(_mm_loadu_ps(sum_x2 + i), _mm_mul_ps(d, x2s)));
+        _mm_storeu_si128((__m128i*)(previous + i), current);
+        _mm_storeu_si128((__m128i*)(counts + i), zero);
+    }
+#endif
+    for(; i < last; i++)
+    {
+        int32_t delta = int32_t(counts[i] - previous[i]);
+        float d = float(delta < 0 ? -delta : delta);
+        sum[i] += d;
+        sum_x[i] += d * x;
+        sum_x2[i] += d * x2;
+        previous[i] = counts[i];
+        counts[i] = 0;
+    }
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+int SCurveFitter::getNbSteps()
+{
+    AutoMutex data_lock(m_data_lock);
+    return m_nb_steps;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void SCurveFitter::getSize(int& width, int& height)
+{
+    AutoMutex data_lock(m_data_lock);
+    width = m_width;
+    height = m_height;
+}
+
+//-----------------------------------------------------
+//		mean and rms of the derivative
+//-----------------------------------------------------
+void SCurveFitter::_fit(std::vector<float>& thresholds, std::vector<float>& noise)
+{
+    long nb_pixels = m_sum.size();
+    thresholds.resize(nb_pixels);
+    noise.resize(nb_pixels);
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    //- Sheppard correction of the variance for the ITHL step
+    float step = m_nb_steps > 1 ? float(m_previous_ithl - m_first_ithl) / (m_nb_steps - 1) : 0;
+    float step_variance = step * step / 12;
+    for(long i = 0; i < nb_pixels; i++)
+    {
+        if(m_sum[i] <= 0)
+        {
+            thresholds[i] = nan;
+            noise[i] = nan;
+            continue;
+        }
+        float mean = m_sum_x[i] / m_sum[i];
+        float variance = m_sum_x2[i] / m_sum[i] - mean * mean - step_variance;
+        thresholds[i] = mean + m_first_ithl;
+        noise[i] = variance > 0 ? std::sqrt(variance) : 0;
+    }
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void SCurveFitter::getThresholds(std::vector<float>& thresholds)
+{
+    AutoMutex data_lock(m_data_lock);
+    std::vector<float> noise;
+    _fit(thresholds, noise);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void SCurveFitter::getNoise(std::vector<float>& noise)
+{
+    AutoMutex data_lock(m_data_lock);
+    std::vector<float> thresholds;
+    _fit(thresholds, noise);
+}
+
+//-----------------------------------------------------
+//		move the pixel thresholds towards the median threshold of their chip
+//-----------------------------------------------------
+void SCurveFitter::correctDacl(const uint16_t* dacl, unsigned int module_index_mask,
+                               uint16_t* corrected_dacl, std::vector<double>& dispersion)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(module_index_mask);
+
+    double dacl_per_ithl;
+    int dacl_max;
+    getDaclCorrection(dacl_per_ithl, dacl_max);
+
+    AutoMutex data_lock(m_data_lock);
+    if(m_nb_steps < 2)
+        throw LIMA_HW_EXC(Error, "No S-curve fit: a threshold scan of at least 2 steps is needed");
+    std::vector<float> thresholds, noise;
+    _fit(thresholds, noise);
+
+    int nb_module_indexes = m_height / CHIP_NB_ROW;
+    int nb_chips = m_width / CHIP_NB_COLUMN;
+    std::copy(dacl, dacl + (long)m_width * m_height, corrected_dacl);
+    dispersion.assign(nb_module_indexes, 0);
+
+    std::vector<float> chip_thresholds;
+    chip_thresholds.reserve(CHIP_NB_ROW * CHIP_NB_COLUMN);
+    for(int module_index = 0; module_index < nb_module_indexes; module_index++)
+    {
+        double sum2 = 0;
+        long nb_fitted = 0;
+        for(int chip = 0; chip < nb_chips; chip++)
+        {
+            long chip_first = (long)module_index * CHIP_NB_ROW * m_width + chip * CHIP_NB_COLUMN;
+            chip_thresholds.clear();
+            for(int row = 0; row < CHIP_NB_ROW; row++)
+            {
+                const float* src = &thresholds[chip_first + (long)row * m_width];
+                for(int column = 0; column < CHIP_NB_COLUMN; column++)
+                    if(src[column] == src[column])
+                        chip_thresholds.push_back(src[column]);
+            }
+            if(chip_thresholds.empty())
+                continue;
+            std::vector<float>::iterator median = chip_thresholds.begin() + chip_thresholds.size() / 2;
+            std::nth_element(chip_thresholds.begin(), median, chip_thresholds.end());
+            float target = *median;
+
+            bool correct = (module_index_mask & (1U << module_index)) != 0;
+            for(int row = 0; row < CHIP_NB_ROW; row++)
+            {
+                long offset = chip_first + (long)row * m_width;
+                for(int column = 0; column < CHIP_NB_COLUMN; column++)
+                {
+                    float threshold = thresholds[offset + column];
+                    if(threshold != threshold)
+                        continue;
+                    double offset_ithl = threshold - target;
+                    sum2 += offset_ithl * offset_ithl;
+                    nb_fitted++;
+                    if(!correct)
+                        continue;
+                    long value = dacl[offset + column] + long(std::floor(offset_ithl * dacl_per_ithl + 0.5));
+                    corrected_dacl[offset + column] = uint16_t(std::max(0L, std::min(value, long(dacl_max))));
+                }
+            }
+        }
+        dispersion[module_index] = nb_fitted ? std::sqrt(sum2 / nb_fitted) : 0;
+        DEB_TRACE() << "S-curve threshold dispersion of module index " << module_index << ": " << dispersion[module_index];
+    }
+}
+
+//- frame types of the scan
+template void SCurveFitter::add<uint16_t>(const uint16_t*);
+template void SCurveFitter::add<uint32_t>(const uint32_t*);
@@ -0,0 +1,297 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "XpadSparseFrames.h"
+#include "lima/Exceptions.h"
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace lima;
+using namespace lima::Xpad;
+
+//-----------------------------------------------------
+//		index of the next non null pixel in [x, end[ (end if none)
+//-----------------------------------------------------
+template<typename T>
+static inline int _nextNonZero(const T* p, int x, int end)
+{
+    for(; x < end && !p[x]; x++);
+    return x;
+}
+
+#ifdef __SSE2__
+//- skip 16 null pixels at once, the scalar loop finds the pixel in the block
+template<>
+inline int _nextNonZero<uint16_t>(const uint16_t* p, int x, int end)
+{
+    const __m128i zero = _mm_setzero_si128();
+    for(; x + 16 <= end; x += 16)
+    {
+        __m128i v = _mm_or_si128(_mm_loadu_si128((const __m128i*)(p + x)),
+                                 _mm_loadu_si128((const __m128i*)(p + x + 8)));
+        if(_mm_movemask_epi8(_mm_cmpeq_epi16(v, zero)) != 0xFFFF)
+            break;
+    }
+    for(; x < end && !p[x]; x++);
+    return x;
+}
+
+template<>
+inline int _nextNonZero<uint32_t>(const uint32_t* p, int x, int end)
+{
+    const __m128i zero = _mm_setzero_si128();
+    for(; x + 16 <= end; x += 16)
+    {
+        __m128i v = _mm_or_si128(_mm_or_si128(_mm_loadu_si128((const __m128i*)(p + x)),
+                                              _mm_loadu_si128((const __m128i*)(p + x + 4))),
+                                 _mm_or_si128(_mm_loadu_si128((const __m128i*)(p + x + 8)),
+                                              _mm_loadu_si128((const __m128i*)(p + x + 12))));
+        if(_mm_movemask_epi8(_mm_cmpeq_epi32(v, zero)) != 0xFFFF)
+            break;
+    }
+    for(; x < end && !p[x]; x++);
+    return x;
+}
+#endif
+
+//---------------------------
+//- Ctor
+//---------------------------
+SparseFrames::SparseFrames() :
+                    m_staged_active(false),
+                    m_occupancy(0.1),
+                    m_buffer_size(16384),
+                    m_active(false),
+                    m_transform(0),
+                    m_width(0),
+                    m_nb_pixels(0),
+                    m_max_nb_events(0),
+                    m_frame_nb(-1),
+                    m_dense(false),
+                    m_nb_published(0),
+                    m_nb_frames(0),
+                    m_nb_dense_frames(0)
+{
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void SparseFrames::setActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+
+    AutoMutex lock(m_lock);
+    m_staged_active = active;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+bool SparseFrames::getActive()
+{
+    AutoMutex lock(m_lock);
+    return m_staged_active;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void SparseFrames::setOccupancyThreshold(double occupancy)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(occupancy);
+
+    if(occupancy <= 0 || occupancy > 1)
+        throw LIMA_HW_EXC(InvalidValue, "Occupancy threshold should be in ]0, 1]");
+
+    AutoMutex lock(m_lock);
+    m_occupancy = occupancy;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void SparseFrames::setBufferSize(int nb_frames)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_frames);
+
+    if(nb_frames <= 0)
+        throw LIMA_HW_EXC(InvalidValue, "Sparse frames buffer size should be > 0");
+
+    AutoMutex lock(m_lock);
+    m_buffer_size = nb_frames;
+}
+
+//-----------------------------------------------------
+//		clear the ring
+//-----------------------------------------------------
+void SparseFrames::prepare(const Size& image_size, const ImageTransform& transform)
+{
+    DEB_MEMBER_FUNCT();
+
+    AutoMutex lock(m_lock);
+    m_active = m_staged_active;
+    m_frames.clear();
+    m_nb_frames = 0;
+    m_nb_dense_frames = 0;
+    m_nb_published = 0;
+    if(!m_active)
+        return;
+
+    m_transform = &transform;
+    m_width = image_size.getWidth();
+    m_nb_pixels = image_size.getWidth() * image_size.getHeight();
+    m_max_nb_events = int(m_occupancy * m_nb_pixels);
+    //- no allocation during the frame pass while the frame stays sparse
+    m_frame.events.reserve(m_max_nb_events);
+    m_frames.resize(m_buffer_size);
+    for(int i = 0; i < m_buffer_size; i++)
+        m_frames[i].frame_nb = -1;
+
+    DEB_TRACE() << "Sparse frames: up to " << m_max_nb_events << " events per frame";
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void SparseFrames::startFrame(int frame_nb)
+{
+    m_frame_nb = frame_nb;
+    m_dense = false;
+    m_frame.events.clear();
+}
+
+//-----------------------------------------------------
+//		zero skipping scan of the rows [row_begin, row_end[
+//-----------------------------------------------------
+template<typename T>
+void SparseFrames::accumulate(const T* image, int row_begin, int row_end)
+{
+    if(m_dense) //- too many events already
+        return;
+
+    std::vector<Event>& events = m_frame.events;
+    for(int y = row_begin; y < row_end; y++)
+    {
+        const T* row = image + (long)y * m_width;
+        int x = 0;
+        while((x = _nextNonZero<T>(row, x, m_width)) < m_width)
+        {
+            if(int(events.size()) == m_max_nb_events)
+            {
+                m_dense = true;
+                return;
+            }
+            Event event;
+            event.index = uint32_t(m_transform->getDstIndex(x, y));
+            event.value = uint32_t(row[x]);
+            events.push_back(event);
+            x++;
+        }
+    }
+}
+
+//-----------------------------------------------------
+//		push the frame in the ring
+//-----------------------------------------------------
+void SparseFrames::endFrame(bool published)
+{
+    //- rotated/flipped geometry: the scan order is not the index order
+    if(!m_dense && !m_transform->isScanOrdered())
+        std::sort(m_frame.events.begin(), m_frame.events.end());
+
+    //- the ring only holds the events (memory scales with the photons), dense frames are in lima
+    AutoMutex lock(m_lock);
+    Frame& frame = m_frames[m_frame_nb % m_frames.size()];
+    frame.frame_nb = m_frame_nb;
+    frame.dense = m_dense;
+    frame.lima_frame_nb = -1;
+    if(m_dense)
+    {
+        std::vector<Event>().swap(frame.events);
+        if(published)
+            frame.lima_frame_nb = m_nb_published++;
+        m_nb_dense_frames++;
+    }
+    else
+        frame.events.assign(m_frame.events.begin(), m_frame.events.end());
+    m_nb_frames++;
+}
+
+//-----------------------------------------------------
+//		copy a frame
+//-----------------------------------------------------
+int SparseFrames::readFrame(int frame_nb, std::vector<uint32_t>& indexes, std::vector<uint32_t>& values, int& lima_frame_nb)
+{
+    AutoMutex lock(m_lock);
+    if(frame_nb < 0 || m_frames.empty())
+        return -1;
+    const Frame& frame = m_frames[frame_nb % m_frames.size()];
+    if(frame.frame_nb != frame_nb)
+        return -1;
+
+    lima_frame_nb = frame.lima_frame_nb;
+    if(frame.dense)
+    {
+        indexes.clear();
+        values.clear();
+        return 1;
+    }
+
+    size_t nb_events = frame.events.size();
+    indexes.resize(nb_events);
+    values.resize(nb_events);
+    for(size_t i = 0; i < nb_events; i++)
+    {
+        indexes[i] = frame.events[i].index;
+        values[i] = frame.events[i].value;
+    }
+    return 0;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+int SparseFrames::getNbFrames()
+{
+    AutoMutex lock(m_lock);
+    return m_nb_frames;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+int SparseFrames::getNbDenseFrames()
+{
+    AutoMutex lock(m_lock);
+    return m_nb_dense_frames;
+}
+
+//- pixel types of the frame pass
+template void SparseFrames::accumulate<uint16_t>(const uint16_t*, int, int);
+template void SparseFrames::accumulate<uint32_t>(const uint32_t*, int, int);
+template void SparseFrames::accumulate<float>(const float*, int, int);
+
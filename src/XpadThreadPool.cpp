@@ -0,0 +1,170 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "XpadThreadPool.h"
+#include "lima/Exceptions.h"
+#include <unistd.h>
+
+using namespace lima;
+using namespace lima::Xpad;
+
+//---------------------------
+//- Ctor
+//---------------------------
+ThreadPool::ThreadPool(int nb_threads) :
+                    m_nb_threads(0),
+                    m_nb_running(0),
+                    m_quit(false)
+{
+    setNbThreads(nb_threads);
+}
+
+//---------------------------
+//- Dtor
+//---------------------------
+ThreadPool::~ThreadPool()
+{
+    wait();
+    _stopThreads();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void ThreadPool::setNbThreads(int nb_threads)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_threads);
+
+    if(nb_threads < 0)
+        throw LIMA_HW_EXC(InvalidValue, "Number of threads should be >= 0");
+    if(nb_threads == 0)
+    {
+        long nb_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        nb_threads = (nb_cpus > 0) ? int(nb_cpus) : 1;
+    }
+
+    wait();
+    _stopThreads();
+    m_nb_threads = nb_threads;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void ThreadPool::post(Job* job)
+{
+    if(m_threads.empty())
+        _startThreads();
+
+    AutoMutex lock(m_cond.mutex());
+    m_jobs.push_back(job);
+    m_cond.broadcast();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void ThreadPool::wait()
+{
+    AutoMutex lock(m_cond.mutex());
+    while(!m_jobs.empty() || m_nb_running)
+        m_cond.wait();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void ThreadPool::_startThreads()
+{
+    m_quit = false;
+    for(int i = 0; i < m_nb_threads; i++)
+    {
+        WorkerThread* thread = new WorkerThread(*this);
+        m_threads.push_back(thread);
+        thread->start();
+    }
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void ThreadPool::_stopThreads()
+{
+    {
+        AutoMutex lock(m_cond.mutex());
+        m_quit = true;
+        m_cond.broadcast();
+    }
+    for(size_t i = 0; i < m_threads.size(); i++)
+    {
+        m_threads[i]->join();
+        delete m_threads[i];
+    }
+    m_threads.clear();
+}
+
+//-----------------------------------------------------
+//		worker loop
+//-----------------------------------------------------
+void ThreadPool::_runJobs()
+{
+    DEB_MEMBER_FUNCT();
+
+    AutoMutex lock(m_cond.mutex());
+    while(true)
+    {
+        while(m_jobs.empty() && !m_quit)
+            m_cond.wait();
+        if(m_quit)
+            break;
+
+        Job* job = m_jobs.front();
+        m_jobs.pop_front();
+        m_nb_running++;
+
+        lock.unlock();
+        try
+        {
+            job->run();
+        }
+        catch(Exception& e)
+        {
+            DEB_ERROR() << "Job failed: " << e;
+        }
+        catch(...)
+        {
+            DEB_ERROR() << "Job failed: unknown exception";
+        }
+        lock.lock();
+
+        m_nb_running--;
+        m_cond.broadcast();
+    }
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void ThreadPool::WorkerThread::threadFunction()
+{
+    m_pool._runJobs();
+}
@@ -0,0 +1,144 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "XpadThresholdScan.h"
+#include "lima/Exceptions.h"
+
+using namespace lima;
+using namespace lima::Xpad;
+
+//---------------------------
+//- Ctor
+//---------------------------
+ThresholdScan::ThresholdScan() :
+                    m_active(false),
+                    m_staged_start(0),
+                    m_staged_stop(0),
+                    m_staged_step(1),
+                    m_start(0),
+                    m_step(1),
+                    m_nb_steps(0),
+                    m_nb_published(0)
+{
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void ThresholdScan::setActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+
+    m_active = active;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+int ThresholdScan::_nbSteps(int ithl_start, int ithl_stop, int ithl_step)
+{
+    return (ithl_stop - ithl_start) / ithl_step + 1;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void ThresholdScan::setRange(int ithl_start, int ithl_stop, int ithl_step)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR3(ithl_start, ithl_stop, ithl_step);
+
+    if(ithl_start < 0 || ithl_stop < 0)
+        throw LIMA_HW_EXC(InvalidValue, "ITHL values should be >= 0");
+    if(ithl_step == 0 || (ithl_stop - ithl_start) * ithl_step < 0)
+        throw LIMA_HW_EXC(InvalidValue, "ITHL step should be non zero and go from start to stop");
+
+    AutoMutex lock(m_lock);
+    m_staged_start = ithl_start;
+    m_staged_stop = ithl_stop;
+    m_staged_step = ithl_step;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void ThresholdScan::getRange(int& ithl_start, int& ithl_stop, int& ithl_step)
+{
+    AutoMutex lock(m_lock);
+    ithl_start = m_staged_start;
+    ithl_stop = m_staged_stop;
+    ithl_step = m_staged_step;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+int ThresholdScan::getNbSteps()
+{
+    AutoMutex lock(m_lock);
+    return _nbSteps(m_staged_start, m_staged_stop, m_staged_step);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void ThresholdScan::prepare()
+{
+    DEB_MEMBER_FUNCT();
+
+    AutoMutex lock(m_lock);
+    m_start = m_staged_start;
+    m_step = m_staged_step;
+    m_nb_steps = _nbSteps(m_staged_start, m_staged_stop, m_staged_step);
+    m_nb_published = 0;
+    DEB_TRACE() << DEB_VAR3(m_start, m_step, m_nb_steps);
+}
+
+//-----------------------------------------------------
+//		frames are published in order
+//-----------------------------------------------------
+void ThresholdScan::setPublished(int step)
+{
+    AutoMutex lock(m_lock);
+    m_nb_published = step + 1;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+bool ThresholdScan::getFrameIthl(int frame_nb, int& ithl)
+{
+    AutoMutex lock(m_lock);
+    if(frame_nb < 0 || frame_nb >= m_nb_published)
+        return false;
+    ithl = getIthl(frame_nb);
+    return true;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+int ThresholdScan::getNbPublishedFrames()
+{
+    AutoMutex lock(m_lock);
+    return m_nb_published;
+}
@@ -0,0 +1,224 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "XpadUniformityCheck.h"
+#include "XpadHotPixelDetector.h"
+#include "XpadCalibrationCache.h"
+#include "lima/Exceptions.h"
+#include <algorithm>
+#include <sstream>
+#include <math.h>
+
+using namespace lima;
+using namespace lima::Xpad;
+
+//---------------------------
+//- Ctor
+//---------------------------
+UniformityCheck::UniformityCheck() :
+                    m_nb_frames(10),
+                    m_exp_time_sec(0.1),
+                    m_k_sigma(5),
+                    m_max_outlier_fraction(0.01),
+                    m_max_rms_ratio(0.05),
+                    m_max_mean_deviation(0.1),
+                    m_checked(false),
+                    m_passed(false)
+{
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void UniformityCheck::setAcquisition(int nb_frames, double exp_time_sec)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(nb_frames, exp_time_sec);
+
+    if(nb_frames < 2)
+        throw LIMA_HW_EXC(InvalidValue, "Uniformity check needs at least 2 frames");
+    if(exp_time_sec <= 0)
+        throw LIMA_HW_EXC(InvalidValue, "Uniformity check exposure time should be > 0");
+
+    AutoMutex lock(m_lock);
+    m_nb_frames = nb_frames;
+    m_exp_time_sec = exp_time_sec;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void UniformityCheck::getAcquisition(int& nb_frames, double& exp_time_sec)
+{
+    AutoMutex lock(m_lock);
+    nb_frames = m_nb_frames;
+    exp_time_sec = m_exp_time_sec;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void UniformityCheck::setLimits(double k_sigma, double max_outlier_fraction, double max_rms_ratio, double max_mean_deviation)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR4(k_sigma, max_outlier_fraction, max_rms_ratio, max_mean_deviation);
+
+    if(k_sigma <= 0)
+        throw LIMA_HW_EXC(InvalidValue, "Uniformity check k sigma should be > 0");
+    if(max_outlier_fraction < 0 || max_outlier_fraction > 1)
+        throw LIMA_HW_EXC(InvalidValue, "Uniformity check outlier fraction should be in [0, 1]");
+    if(max_rms_ratio < 0 || max_mean_deviation < 0)
+        throw LIMA_HW_EXC(InvalidValue, "Uniformity check rms ratio and mean deviation should be >= 0");
+
+    AutoMutex lock(m_lock);
+    m_k_sigma = k_sigma;
+    m_max_outlier_fraction = max_outlier_fraction;
+    m_max_rms_ratio = max_rms_ratio;
+    m_max_mean_deviation = max_mean_deviation;
+}
+
+//-----------------------------------------------------
+//		statistics and pass/fail of each chip
+//-----------------------------------------------------
+void UniformityCheck::check(const std::vector<float>& mean, int nb_frames, int width, int height, const std::vector<int>& module_ids)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR3(nb_frames, width, height);
+
+    int nb_chips = width / CHIP_NB_COLUMN;
+    int nb_module_rows = height / CHIP_NB_ROW;
+    if(mean.size() != (size_t)width * height || nb_module_rows != int(module_ids.size()))
+        throw LIMA_HW_EXC(Error, "Uniformity check: the mean map does not correspond to the raw image");
+
+    double k_sigma, max_outlier_fraction, max_rms_ratio, max_mean_deviation;
+    {
+        AutoMutex lock(m_lock);
+        k_sigma = m_k_sigma;
+        max_outlier_fraction = m_max_outlier_fraction;
+        max_rms_ratio = m_max_rms_ratio;
+        max_mean_deviation = m_max_mean_deviation;
+    }
+
+    std::vector<ChipResult> results;
+    std::vector<float> values;
+    std::vector<float> chip_means;
+    int nb_pixels = CHIP_NB_ROW * CHIP_NB_COLUMN;
+    for(int module_row = 0; module_row < nb_module_rows; module_row++)
+        for(int chip = 0; chip < nb_chips; chip++)
+        {
+            ChipResult result;
+            result.module = module_ids[module_row] + 1;
+            result.chip = chip + 1;
+
+            //- one pass for the moments, then the robust statistics for the outliers
+            double sum = 0, sum2 = 0;
+            values.clear();
+            for(int row = 0; row < CHIP_NB_ROW; row++)
+            {
+                const float* src = &mean[(long)(module_row * CHIP_NB_ROW + row) * width + chip * CHIP_NB_COLUMN];
+                for(int column = 0; column < CHIP_NB_COLUMN; column++)
+                {
+                    sum += src[column];
+                    sum2 += double(src[column]) * src[column];
+                }
+                values.insert(values.end(), src, src + CHIP_NB_COLUMN);
+            }
+            result.mean = sum / nb_pixels;
+            result.rms = sqrt(std::max(sum2 / nb_pixels - result.mean * result.mean, 0.));
+
+            std::vector<float> chip_values(values);
+            double median, sigma;
+            HotPixelDetector::robustStats(values, median, sigma);
+            double poisson_sigma = sqrt(std::max(median, 1.) / nb_frames);
+            sigma = std::max(sigma, poisson_sigma);
+            result.nb_outliers = 0;
+            for(int i = 0; i < nb_pixels; i++)
+                result.nb_outliers += fabs(chip_values[i] - median) > k_sigma * sigma;
+
+            //- the rms in excess of the counting noise, relative to the mean
+            double excess_rms = sqrt(std::max(result.rms * result.rms - poisson_sigma * poisson_sigma, 0.));
+            result.passed = result.nb_outliers <= max_outlier_fraction * nb_pixels &&
+                            excess_rms <= max_rms_ratio * std::max(result.mean, 1.);
+            results.push_back(result);
+            chip_means.push_back(float(result.mean));
+        }
+
+    //- the chips should have the same mean
+    double median_mean = 0;
+    if(!chip_means.empty())
+    {
+        std::nth_element(chip_means.begin(), chip_means.begin() + chip_means.size() / 2, chip_means.end());
+        median_mean = chip_means[chip_means.size() / 2];
+    }
+    std::ostringstream report;
+    int nb_failed = 0;
+    for(size_t i = 0; i < results.size(); i++)
+    {
+        ChipResult& result = results[i];
+        double deviation = fabs(result.mean - median_mean) / std::max(median_mean, 1.);
+        if(deviation > max_mean_deviation)
+            result.passed = false;
+        if(result.passed)
+            continue;
+        nb_failed++;
+        report << "module " << result.module << " chip " << result.chip << ": mean " << result.mean
+               << " (" << deviation * 100 << "% from the median), rms " << result.rms
+               << ", " << result.nb_outliers << " outliers\n";
+    }
+    bool passed = (nb_failed == 0) && !results.empty();
+    report << "Uniformity check " << (passed ? "passed" : "FAILED") << ": " << nb_failed << "/" << results.size()
+           << " chips failed, median chip mean " << median_mean << " counts per frame (" << nb_frames << " frames)";
+    DEB_TRACE() << report.str();
+
+    AutoMutex lock(m_lock);
+    m_checked = true;
+    m_passed = passed;
+    m_results.swap(results);
+    m_report = report.str();
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+bool UniformityCheck::getPassed(bool& passed)
+{
+    AutoMutex lock(m_lock);
+    passed = m_passed;
+    return m_checked;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void UniformityCheck::getChipResults(std::vector<ChipResult>& results)
+{
+    AutoMutex lock(m_lock);
+    results = m_results;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+std::string UniformityCheck::getReport()
+{
+    AutoMutex lock(m_lock);
+    return m_report;
+}